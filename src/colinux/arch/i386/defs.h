@@ -16,6 +16,7 @@
  * Some declarations copied from Linux.
  */
 
+#define CO_ARCH_X86_FEATURE_TSC       (4)
 #define CO_ARCH_X86_FEATURE_APIC      (9)
 #define CO_ARCH_X86_FEATURE_SEP       (11)
 #define CO_ARCH_X86_FEATURE_FXSR      (24)
@@ -20,6 +20,7 @@
 #include <colinux/arch/passage.h>
 #include <colinux/os/kernel/alloc.h>
 #include <colinux/os/kernel/misc.h>
+#include <colinux/os/timer.h>
 
 #include "cpuid.h"
 #include "manager.h"
@@ -672,6 +673,63 @@ static void pae_temp_address_space_init(co_arch_passage_page_pae_address_space_t
 }
 
 
+/*
+ * The guest clocksource scales TSC cycles to nanoseconds without a
+ * switch (see co_arch_time_info_t). It needs the rate of the TSC.
+ */
+static void time_info_init(co_monitor_t *cmon)
+{
+	co_arch_time_info_t *ti = &cmon->passage_page->time_info;
+	unsigned long khz = co_os_get_cpu_khz();
+	unsigned long long mul;
+
+	ti->tsc_mul = 0;
+
+	if (!(cmon->manager->archdep->caps[0] & (1 << CO_ARCH_X86_FEATURE_TSC)) || khz < 1000)
+		return;
+
+	/* ns per cycle is 10^6 / khz, times 2^32 */
+	mul = 1000000ULL << 32;
+	co_div64_32(&mul, khz);
+
+	/* Below 1 GHz it takes more than 32 bits, the guest asks the host then */
+	if (mul >> 32) {
+		co_debug("guest clock: %ld kHz TSC too slow, not used", khz);
+		return;
+	}
+
+	ti->tsc_mul = (unsigned long)mul;
+
+	co_debug("guest clock: %ld kHz TSC", khz);
+}
+
+/*
+ * New time base for the guest, just before switching to it. Interrupts
+ * must be off, so that the TSC we read is the one of the CPU running it.
+ */
+static void time_info_update(co_monitor_t *cmon)
+{
+	co_arch_time_info_t *ti = &cmon->passage_page->time_info;
+	co_timestamp_t timestamp, freq;
+	unsigned long long ns;
+	unsigned long rem;
+
+	if (!ti->tsc_mul)
+		return;
+
+	/* Monotonic, a host clock step must not move the guest clocksource */
+	co_os_get_monotonic_timestamp_freq(&timestamp, &freq);
+	ti->base_tsc = co_get_tsc();
+
+	/* Seconds and remainder apart, timestamp * 10^9 may overflow */
+	ns = timestamp.quad;
+	rem = co_div64_32(&ns, freq.low);
+	ti->base_ns = ns * 1000000000ULL;
+	ns = (unsigned long long)rem * 1000000000UL;
+	co_div64_32(&ns, freq.low);
+	ti->base_ns += ns;
+}
+
 co_rc_t co_monitor_arch_passage_page_init(co_monitor_t *cmon)
 {
 	co_arch_passage_page_t *pp = cmon->passage_page;
@@ -770,6 +828,8 @@ co_rc_t co_monitor_arch_passage_page_init(co_monitor_t *cmon)
 	pp->linuxvm_state.gs = \
 	pp->linuxvm_state.ss = cmon->arch_info.kernel_ds;
 
+	time_info_init(cmon);
+
 	co_passage_page_dump(pp);
 
 	return CO_RC_OK;
@@ -777,6 +837,8 @@ co_rc_t co_monitor_arch_passage_page_init(co_monitor_t *cmon)
 
 void co_host_switch_wrapper(co_monitor_t *cmon)
 {
+	unsigned long flags;
+
 	if (co_get_cr4() & CO_ARCH_X86_CR4_VMXE) {
 
 		/*
@@ -790,5 +852,8 @@ void co_host_switch_wrapper(co_monitor_t *cmon)
 		return;
 	}
 
+	flags = co_irq_save();
+	time_info_update(cmon);
 	co_switch();
+	co_irq_restore(flags);
 }
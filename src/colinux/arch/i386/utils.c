@@ -72,3 +72,22 @@ unsigned long co_get_dr7(void)
 	asm("mov %%dr7, %0" : "=r"(reg));
 	return reg;
 }
+
+unsigned long long co_get_tsc(void)
+{
+	unsigned long long tsc;
+	asm volatile("rdtsc" : "=A"(tsc));
+	return tsc;
+}
+
+unsigned long co_irq_save(void)
+{
+	unsigned long flags;
+	asm volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+	return flags;
+}
+
+void co_irq_restore(unsigned long flags)
+{
+	asm volatile("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
@@ -21,5 +21,8 @@ extern unsigned long co_get_dr2(void);
 extern unsigned long co_get_dr3(void);
 extern unsigned long co_get_dr6(void);
 extern unsigned long co_get_dr7(void);
+extern unsigned long long co_get_tsc(void);
+extern unsigned long co_irq_save(void);
+extern void co_irq_restore(unsigned long flags);
 
 #endif
@@ -299,6 +299,13 @@ typedef struct co_config {
 	 */
 	unsigned int ram_size;
 
+	/*
+	 * mem=lazy: charge the pseudo physical RAM against the host's
+	 * memory usage limit page by page, as the guest faults it in,
+	 * rather than all of ram_size when the machine is created.
+	 */
+	bool_t ram_lazy;
+
 	/*
 	 * The pathname of the initrd file.
 	 */
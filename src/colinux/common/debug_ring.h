@@ -0,0 +1,82 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ */
+
+#ifndef __CO_COMMON_DEBUG_RING_H__
+#define __CO_COMMON_DEBUG_RING_H__
+
+#include "common.h"
+
+/*
+ * Rings of debug log records, one per host CPU (up to CO_DEBUG_RINGS_MAX),
+ * written by the driver and read by colinux-debug-daemon through a
+ * mapping of the rings into its address space, see
+ * CO_MANAGER_IOCTL_DEBUG_RINGS. The mapping is writable, but private on
+ * Linux hosts, so the reader must never write to it.
+ *
+ * Positions are free running byte counts; the offset in the ring is the
+ * position modulo CO_DEBUG_RING_SIZE. Writers reserve room by moving the
+ * reserve position with a compare and exchange, fill in their record and
+ * then commit it by storing its position in the record header. Records
+ * may be committed out of order, so the reader stops at the first record
+ * whose header does not carry the position it expects. The reader gives
+ * room back with the ioctl, and writers drop records that don't fit.
+ *
+ * A record never wraps around the end of the ring. A writer that would
+ * cross it commits a CO_DEBUG_RING_PAD record for the rest of the ring
+ * along with its own, at offset zero.
+ */
+#define CO_DEBUG_RINGS_MAX		8
+#define CO_DEBUG_RING_SIZE		0x10000 /* power of two */
+#define CO_DEBUG_RING_PAD		0x80000000UL
+
+typedef struct co_debug_ring_record {
+	volatile unsigned long pos;  /* position of the record, stored last */
+	unsigned long size;	     /* header included; may have CO_DEBUG_RING_PAD */
+	char data[];		     /* co_debug_tlv_t records */
+} co_debug_ring_record_t;
+
+/* Records start aligned to their header, so padding always fits one */
+#define CO_DEBUG_RING_ALIGN(size) \
+	(((size) + sizeof(co_debug_ring_record_t) - 1) & ~(sizeof(co_debug_ring_record_t) - 1))
+
+#define co_debug_ring_barrier()		__sync_synchronize()
+
+/**
+ * Return the record at position 'pos' of a ring that was filled up to
+ * 'head', or NULL if there is none or it is not committed yet. Padding
+ * is returned too. '*size' receives the record size without flags, the
+ * next record is CO_DEBUG_RING_ALIGN() of it further.
+ */
+static inline co_debug_ring_record_t *co_debug_ring_peek(unsigned char *data,
+							 unsigned long pos,
+							 unsigned long head,
+							 unsigned long *size)
+{
+	unsigned long offset = pos & (CO_DEBUG_RING_SIZE - 1);
+	co_debug_ring_record_t *record;
+	unsigned long record_size;
+
+	if ((long)(head - pos) < (long)sizeof(co_debug_ring_record_t))
+		return NULL;
+
+	record = (co_debug_ring_record_t *)&data[offset];
+	if (record->pos != pos)
+		return NULL;
+
+	co_debug_ring_barrier();
+
+	record_size = record->size & ~CO_DEBUG_RING_PAD;
+	if (record_size < sizeof(*record)  ||
+	    CO_DEBUG_RING_ALIGN(record_size) > CO_DEBUG_RING_SIZE - offset)
+		return NULL;
+
+	*size = record_size;
+
+	return record;
+}
+
+#endif
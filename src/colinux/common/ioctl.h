@@ -14,6 +14,7 @@
 
 #include <colinux/common/import.h>
 #include <colinux/common/config.h>
+#include <colinux/common/debug_ring.h>
 
 
 typedef enum {
@@ -28,6 +29,8 @@ typedef enum {
 	CO_MANAGER_IOCTL_INFO,
 	CO_MANAGER_IOCTL_ATTACH,
 	CO_MANAGER_IOCTL_MONITOR_LIST,
+	CO_MANAGER_IOCTL_MESSAGE_RING,
+	CO_MANAGER_IOCTL_DEBUG_RINGS,
 } co_manager_ioctl_t;
 
 /*
@@ -65,7 +68,10 @@ typedef enum {
 	CO_MONITOR_IOCTL_VIDEO_ATTACH, /* incomplete */
 	CO_MONITOR_IOCTL_VIDEO_DETACH, /* incomplete */
 	CO_MONITOR_IOCTL_CONET_BIND_ADAPTER,
-	CO_MONITOR_IOCTL_CONET_UNBIND_ADAPTER
+	CO_MONITOR_IOCTL_CONET_UNBIND_ADAPTER,
+	CO_MONITOR_IOCTL_BALLOON,
+	CO_MONITOR_IOCTL_TRACE,
+	CO_MONITOR_IOCTL_COUNTERS
 } co_monitor_ioctl_op_t;
 
 /* interface for CO_MANAGER_IOCTL_MONITOR: */
@@ -89,6 +95,7 @@ typedef struct {
 typedef struct {
 	unsigned long hostmem_usage_limit;
 	unsigned long hostmem_used;
+	unsigned long reversed_pages_used; /* pages of the reversed PFN map in use */
 } co_manager_ioctl_info_t;
 
 #define CO_MANAGER_ATTACH_MAX_MODULES 0x10
@@ -124,6 +131,24 @@ typedef struct {
 	co_id_t       ids[CO_MAX_MONITORS];
 } co_manager_ioctl_monitor_list_t;
 
+/* interface for CO_MANAGER_IOCTL_MESSAGE_RING: */
+typedef struct {
+	co_rc_t       rc;
+	void*         rx_user_address; /* co_message_ring_t, kernel to daemon */
+	void*         tx_user_address; /* co_message_ring_t, daemon to kernel */
+} co_manager_ioctl_message_ring_t;
+
+/* interface for CO_MANAGER_IOCTL_DEBUG_RINGS: */
+typedef struct {
+	co_rc_t       rc;
+	bool_t        map;                              /* in: first call, map the rings */
+	unsigned long count;                            /* out: rings in use */
+	void*         user_address[CO_DEBUG_RINGS_MAX]; /* out: CO_DEBUG_RING_SIZE bytes each */
+	unsigned long tail[CO_DEBUG_RINGS_MAX];         /* in: read up to here, out: continue here */
+	unsigned long head[CO_DEBUG_RINGS_MAX];         /* out: reserved by writers so far */
+	unsigned long dropped;                          /* out: records that found no room */
+} co_manager_ioctl_debug_rings_t;
+
 /*
  * Monitor ioctl()s
  */
@@ -188,8 +213,70 @@ typedef struct {
 /* interface for CO_MONITOR_IOCTL_STATUS */
 typedef struct co_monitor_ioctl_status {
 	co_manager_ioctl_monitor_t pc;
+	unsigned long memory_size;         /* pseudo physical RAM, in bytes */
+	bool_t	      memory_lazy;         /* mem=lazy */
+	unsigned long resident_pages;      /* backed by host pages right now */
+	unsigned long resident_pages_peak;
+	unsigned long pages_allocated;
+	unsigned long pages_freed;
+	unsigned long pages_alloc_failed;
+	unsigned long balloon_target;      /* pages the guest was asked to give back */
+	unsigned long balloon_pages;       /* pages it has given back */
 } co_monitor_ioctl_status_t;
 
+/* interface for CO_MONITOR_IOCTL_BALLOON */
+typedef struct co_monitor_ioctl_balloon {
+	co_manager_ioctl_monitor_t pc;
+	unsigned long target_mb;           /* in: MB the guest should give back */
+	unsigned long size_mb;             /* out: MB it has given back so far */
+} co_monitor_ioctl_balloon_t;
+
+/* interface for CO_MONITOR_IOCTL_TRACE */
+#define CO_MONITOR_TRACE_CHUNK 64
+
+/* One switch to Linux and back, times in host timestamp units */
+typedef struct co_monitor_trace_record {
+	unsigned long	   operation;      /* co_operation_t Linux came back with */
+	unsigned long	   device;         /* co_device_t of CO_OPERATION_DEVICE, else 0 */
+	unsigned long long switch_start;   /* before co_host_switch_wrapper() */
+	unsigned long long switch_end;     /* after it returned */
+	unsigned long long service_time;   /* from switch_end to the next switch to Linux */
+} co_monitor_trace_record_t;
+
+typedef struct co_monitor_ioctl_trace {
+	co_manager_ioctl_monitor_t pc;
+	long		   enable;         /* in: 1 start tracing, 0 stop, -1 leave as is */
+	unsigned long	   start;          /* in: sequence number of the first record wanted */
+	unsigned long	   first;          /* out: sequence number of records[0] */
+	unsigned long	   count;          /* out: records returned */
+	unsigned long	   head;           /* out: records written so far */
+	unsigned long long freq;           /* out: timestamp units per second */
+	co_monitor_trace_record_t records[CO_MONITOR_TRACE_CHUNK];
+} co_monitor_ioctl_trace_t;
+
+/* interface for CO_MONITOR_IOCTL_COUNTERS */
+typedef struct co_monitor_counters {
+	unsigned long long switches[CO_OPERATION_MAX];        /* Linux came back with */
+	unsigned long long device_requests[CO_DEVICES_TOTAL]; /* of CO_OPERATION_DEVICE */
+	unsigned long long linux_interrupts;                  /* switches that gave Linux messages */
+	unsigned long long messages_to_linux[CO_MODULES_MAX];   /* by sender */
+	unsigned long long messages_from_linux[CO_MODULES_MAX]; /* by receiver */
+	unsigned long long block_read_bytes[CO_MODULE_MAX_COBD];
+	unsigned long long block_write_bytes[CO_MODULE_MAX_COBD];
+	unsigned long	   linux_queue_peak;     /* most messages waiting for Linux */
+	unsigned long	   io_buffer_peak;       /* most messages passed in one switch */
+	unsigned long	   message_alloc_failed; /* messages to Linux dropped */
+	unsigned long	   malloc_failed;        /* co_monitor_malloc() failures */
+} co_monitor_counters_t;
+
+typedef struct co_monitor_ioctl_counters {
+	co_manager_ioctl_monitor_t pc;
+	unsigned long long    timestamp;  /* host timestamp of the copy */
+	unsigned long long    freq;       /* timestamp units per second */
+	unsigned long	      linux_queue_size;
+	co_monitor_counters_t counters;
+} co_monitor_ioctl_counters_t;
+
 #ifdef CONFIG_COOPERATIVE_VIDEO
 /* interface for CO_MONITOR_IOCTL_VIDEO_ATTACH/DETACH: */
 typedef struct {
@@ -14,44 +14,152 @@
 
 #include "messages.h"
 
-static co_rc_t co_message_dup(co_message_t*  message,
-                              co_message_t** dup_message_out)
+/*
+ * A queued message lives in one block: the queue item header, our
+ * co_message_queue_item_t and then the copy of the message itself.
+ */
+#define CO_MESSAGE_BLOCK_OVERHEAD \
+	(sizeof(co_queue_item_t) + sizeof(co_message_queue_item_t))
+
+static const unsigned long pool_class_sizes[CO_MESSAGE_POOL_CLASSES] = CO_MESSAGE_POOL_CLASS_SIZES;
+
+static void *pool_block_get(co_message_pool_t *pool, long pool_class)
+{
+	co_message_pool_class_t *pclass = &pool->classes[pool_class];
+	void *block;
+
+	block = pclass->free_list;
+	if (block) {
+		pclass->free_list = *(void **)block;
+		pclass->free_count--;
+		pool->hits++;
+	} else {
+		block = co_os_malloc(pclass->block_size);
+		if (!block)
+			return NULL;
+		(*pool->blocks_allocated)++;
+		pool->misses++;
+	}
+
+	pool->blocks_in_use++;
+
+	return block;
+}
+
+static void pool_block_put(co_message_pool_t *pool, long pool_class, void *block)
+{
+	co_message_pool_class_t *pclass = &pool->classes[pool_class];
+
+	pool->blocks_in_use--;
+
+	if (pclass->free_count >= CO_MESSAGE_POOL_MAX_FREE) {
+		co_os_free(block);
+		(*pool->blocks_allocated)--;
+		return;
+	}
+
+	*(void **)block = pclass->free_list;
+	pclass->free_list = block;
+	pclass->free_count++;
+}
+
+co_rc_t co_message_pool_init(co_message_pool_t *pool, unsigned long *blocks_allocated)
+{
+	long pool_class;
+	int i;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->blocks_allocated = blocks_allocated;
+
+	for (pool_class = 0; pool_class < CO_MESSAGE_POOL_CLASSES; pool_class++) {
+		pool->classes[pool_class].block_size = pool_class_sizes[pool_class];
+
+		for (i = 0; i < CO_MESSAGE_POOL_PREALLOC; i++) {
+			void *block = co_os_malloc(pool_class_sizes[pool_class]);
+			if (!block) {
+				co_message_pool_free(pool);
+				return CO_RC(OUT_OF_MEMORY);
+			}
+
+			(*pool->blocks_allocated)++;
+			pool->blocks_in_use++;
+			pool_block_put(pool, pool_class, block);
+		}
+	}
+
+	return CO_RC(OK);
+}
+
+/* All blocks must have been given back, e.g. by co_message_queue_flush() */
+void co_message_pool_free(co_message_pool_t *pool)
 {
-	unsigned long size;
-	co_message_t* allocated;
+	long pool_class;
+
+	for (pool_class = 0; pool_class < CO_MESSAGE_POOL_CLASSES; pool_class++) {
+		co_message_pool_class_t *pclass = &pool->classes[pool_class];
+
+		while (pclass->free_list) {
+			void *block = pclass->free_list;
+
+			pclass->free_list = *(void **)block;
+			co_os_free(block);
+			(*pool->blocks_allocated)--;
+		}
+
+		pclass->free_count = 0;
+	}
+}
+
+static co_rc_t co_message_dup_to_queue_(co_message_pool_t* pool,
+					co_message_t*	   message,
+					co_queue_t*	   queue)
+{
+	unsigned long		 size;
+	unsigned long		 block_size;
+	long			 pool_class = CO_MESSAGE_POOL_EMBEDDED;
+	co_queue_item_t*	 block = NULL;
+	co_message_queue_item_t* queue_item;
 
 	size = sizeof(*message) + message->size;
+	block_size = CO_MESSAGE_BLOCK_OVERHEAD + size;
 
-	allocated = co_os_malloc(size);
-	if (allocated == NULL)
+	if (pool) {
+		for (pool_class = 0; pool_class < CO_MESSAGE_POOL_CLASSES; pool_class++)
+			if (block_size <= pool->classes[pool_class].block_size)
+				break;
+
+		if (pool_class < CO_MESSAGE_POOL_CLASSES)
+			block = pool_block_get(pool, pool_class);
+		else
+			pool_class = CO_MESSAGE_POOL_EMBEDDED;
+	}
+
+	if (pool_class == CO_MESSAGE_POOL_EMBEDDED)
+		block = co_os_malloc(block_size);
+
+	if (block == NULL)
 		return CO_RC(OUT_OF_MEMORY);
 
-	memcpy(allocated, message, size);
+	queue_item = (co_message_queue_item_t *)&block->data;
+	queue_item->message = (co_message_t *)(queue_item + 1);
+	queue_item->pool = pool;
+	queue_item->pool_class = pool_class;
 
-	*dup_message_out = allocated;
+	memcpy(queue_item->message, message, size);
+
+	co_queue_add_head(queue, queue_item);
 
 	return CO_RC(OK);
 }
 
 co_rc_t co_message_dup_to_queue(co_message_t* message, co_queue_t* queue)
 {
-	co_message_t* dup_message;
-	co_rc_t	      rc;
-
-	rc = co_message_dup(message, &dup_message);
-	if (CO_OK(rc)) {
-		co_message_queue_item_t* queue_item = NULL;
-
-		rc = co_queue_malloc(queue, sizeof(co_message_queue_item_t), (void**)&queue_item);
-		if (!CO_OK(rc)) {
-			co_os_free(dup_message);
-		} else {
-			queue_item->message = dup_message;
-			co_queue_add_head(queue, queue_item);
-		}
-	}
+	return co_message_dup_to_queue_(NULL, message, queue);
+}
 
-	return rc;
+co_rc_t co_message_pool_dup_to_queue(co_message_pool_t* pool, co_message_t* message, co_queue_t* queue)
+{
+	return co_message_dup_to_queue_(pool, message, queue);
 }
 
 co_rc_t co_message_mov_to_queue(co_message_t* message, co_queue_t* queue)
@@ -64,7 +172,34 @@ co_rc_t co_message_mov_to_queue(co_message_t* message, co_queue_t* queue)
 		return rc;
 
 	queue_item->message = message;
+	queue_item->pool = NULL;
+	queue_item->pool_class = CO_MESSAGE_POOL_MOVED;
 	co_queue_add_head(queue, queue_item);
 
 	return CO_RC(OK);
 }
+
+void co_message_queue_item_free(co_queue_t* queue, co_message_queue_item_t* message_item)
+{
+	switch (message_item->pool_class) {
+	case CO_MESSAGE_POOL_MOVED:
+		co_os_free(message_item->message);
+		co_queue_free(queue, message_item);
+		break;
+	case CO_MESSAGE_POOL_EMBEDDED:
+		co_queue_free(queue, message_item);
+		break;
+	default:
+		pool_block_put(message_item->pool, message_item->pool_class,
+			       ((char *)message_item) - sizeof(co_queue_item_t));
+		break;
+	}
+}
+
+void co_message_queue_flush(co_queue_t* queue)
+{
+	co_message_queue_item_t* message_item;
+
+	while (CO_OK(co_queue_pop_tail(queue, (void **)&message_item)))
+		co_message_queue_item_free(queue, message_item);
+}
@@ -14,17 +14,84 @@
 #include "queue.h"
 #include "common.h"
 
-#define CO_QUEUE_COUNT_LIMIT_BEFORE_SLEEP 1024
+/*
+ * Flow control of monitor to daemon messages, counted in messages
+ * waiting in a reader's queue. See co_manager_send().
+ */
+#define CO_QUEUE_SEND_CREDITS	1024
+#define CO_QUEUE_PARK_LIMIT	(4 * CO_QUEUE_SEND_CREDITS) /* monitor waits for the reader */
+
+/*
+ * Largest message, headers included, that can be passed to Linux. It
+ * has to fit in the I/O buffer by itself, see callback_return_messages().
+ */
+#define CO_LINUX_MESSAGE_MAX_SIZE	(CO_VPTR_IO_AREA_SIZE - sizeof(co_io_buffer_t))
+
+/*
+ * Where the memory of a queued message came from (pool_class below).
+ * Any other value is a size class of the item's pool.
+ */
+#define CO_MESSAGE_POOL_EMBEDDED	(-1) /* one co_os_malloc() block with the item */
+#define CO_MESSAGE_POOL_MOVED		(-2) /* separate co_os_malloc() block, see mov */
+
+/*
+ * Fixed size classes of queue item + message blocks: console
+ * operations, network frames up to the MTU plus headers, and jumbo
+ * frames. Bigger messages bypass the pool.
+ */
+#define CO_MESSAGE_POOL_CLASSES		3
+#define CO_MESSAGE_POOL_CLASS_SIZES	{ 0x100, 0x680, 0x2400 }
+#define CO_MESSAGE_POOL_PREALLOC	16   /* blocks per class at init */
+#define CO_MESSAGE_POOL_MAX_FREE	256  /* cached blocks per class */
+
+struct co_message_pool;
 
 typedef struct co_message_queue_item {
 	co_message_t *message;
+	struct co_message_pool *pool;
+	long pool_class;
 } co_message_queue_item_t;
 
+typedef struct co_message_pool_class {
+	unsigned long block_size;
+	void *free_list;
+	unsigned long free_count;
+} co_message_pool_class_t;
+
+/*
+ * A cache of message blocks, so that queueing a message on the packet
+ * path does not go to the host allocator. Not locked: the owner of
+ * the pool serializes access, normally with the lock of the queue the
+ * blocks go to. Every block taken from or given back to the host is
+ * counted in *blocks_allocated.
+ */
+typedef struct co_message_pool {
+	co_message_pool_class_t classes[CO_MESSAGE_POOL_CLASSES];
+	unsigned long *blocks_allocated;
+	unsigned long blocks_in_use;
+	unsigned long hits;
+	unsigned long misses;
+} co_message_pool_t;
+
 typedef char co_module_name_t[0x20];
 
+extern co_rc_t co_message_pool_init(co_message_pool_t *pool, unsigned long *blocks_allocated);
+extern void co_message_pool_free(co_message_pool_t *pool);
+
 extern co_rc_t co_message_dup_to_queue(co_message_t *message, co_queue_t *queue);
+extern co_rc_t co_message_pool_dup_to_queue(co_message_pool_t *pool, co_message_t *message, co_queue_t *queue);
 extern co_rc_t co_message_mov_to_queue(co_message_t *message, co_queue_t *queue);
 
+/**
+ * free a popped item together with its message, wherever they came from.
+ */
+extern void co_message_queue_item_free(co_queue_t *queue, co_message_queue_item_t *message_item);
+
+/**
+ * free all queued items and their messages.
+ */
+extern void co_message_queue_flush(co_queue_t *queue);
+
 extern char *co_module_repr(co_module_t module, co_module_name_t *str);
 
 #endif
@@ -0,0 +1,172 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * Dan Aloni <da-x@colinux.org>, 2003 (c)
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ */
+
+#ifndef __CO_COMMON_RING_H__
+#define __CO_COMMON_RING_H__
+
+#include "common.h"
+
+/*
+ * Single producer, single consumer ring of co_message_t records.
+ *
+ * The ring lives in pages that are mapped both in the host kernel and
+ * in a userspace daemon (see CO_MANAGER_IOCTL_MESSAGE_RING). Only the
+ * producer moves 'head' and only the consumer moves 'tail', so neither
+ * side takes a lock. Both are byte offsets into data[], and the ring is
+ * empty when they are equal.
+ *
+ * A record never wraps around the end of data[]. When the next record
+ * does not fit, the producer marks the rest of data[] with a message
+ * header of size CO_MESSAGE_RING_WRAP (or leaves it alone when it is
+ * too short to hold one) and continues at offset zero.
+ */
+typedef struct co_message_ring {
+	volatile unsigned long head;
+	volatile unsigned long tail;
+	unsigned long reserved[2];
+	unsigned char data[];
+} co_message_ring_t;
+
+/*
+ * The data[] size is a constant rather than a field: the host kernel
+ * must not trust anything that userspace can scribble on, so it
+ * validates head and tail against this before touching data[].
+ */
+#define CO_MESSAGE_RING_BYTES		0x10000
+#define CO_MESSAGE_RING_SIZE		(CO_MESSAGE_RING_BYTES - sizeof(co_message_ring_t))
+#define CO_MESSAGE_RING_WRAP		((unsigned long)-1)
+#define CO_MESSAGE_RING_ALIGN(size)	(((size) + sizeof(unsigned long) - 1) & ~(sizeof(unsigned long) - 1))
+
+#define co_message_ring_barrier()	__sync_synchronize()
+
+static inline void co_message_ring_init(co_message_ring_t *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->reserved[0] = 0;
+	ring->reserved[1] = 0;
+}
+
+static inline bool_t co_message_ring_empty(co_message_ring_t *ring)
+{
+	return ring->head == ring->tail;
+}
+
+/**
+ * Reserve room for a message of 'size' bytes (header included) at the
+ * producer side. Returns NULL when the ring is full. The message is not
+ * visible to the consumer until co_message_ring_commit().
+ */
+static inline co_message_t *co_message_ring_reserve(co_message_ring_t *ring, unsigned long size)
+{
+	unsigned long head = ring->head;
+	unsigned long tail = ring->tail;
+	unsigned long record = CO_MESSAGE_RING_ALIGN(size);
+
+	if (head >= CO_MESSAGE_RING_SIZE  ||  tail >= CO_MESSAGE_RING_SIZE)
+		return NULL;
+
+	if (head >= tail) {
+		unsigned long to_end = CO_MESSAGE_RING_SIZE - head;
+
+		/* Filling up to the end is fine as long as head won't land on tail */
+		if (record < to_end  ||  (record == to_end  &&  tail != 0))
+			return (co_message_t *)&ring->data[head];
+
+		if (record >= tail)
+			return NULL;
+
+		if (to_end >= sizeof(co_message_t))
+			((co_message_t *)&ring->data[head])->size = CO_MESSAGE_RING_WRAP;
+
+		return (co_message_t *)&ring->data[0];
+	}
+
+	if (record >= tail - head)
+		return NULL;
+
+	return (co_message_t *)&ring->data[head];
+}
+
+/**
+ * Publish a message returned by co_message_ring_reserve(). Returns PTRUE
+ * when the consumer had already drained the ring, i.e. when it needs to
+ * be woken up.
+ */
+static inline bool_t co_message_ring_commit(co_message_ring_t *ring, co_message_t *message)
+{
+	unsigned long old_head = ring->head;
+	unsigned long head;
+
+	head = ((unsigned char *)message - ring->data) + CO_MESSAGE_RING_ALIGN(sizeof(*message) + message->size);
+	if (head == CO_MESSAGE_RING_SIZE)
+		head = 0;
+
+	co_message_ring_barrier();
+	ring->head = head;
+	co_message_ring_barrier();
+
+	return ring->tail == old_head;
+}
+
+/**
+ * Return the oldest message in the ring without consuming it, or NULL
+ * if the ring is empty. '*size' receives the message size (header
+ * included), read once, so a consumer that does not trust the producer
+ * can copy exactly what was validated here.
+ */
+static inline co_message_t *co_message_ring_peek(co_message_ring_t *ring, unsigned long *size)
+{
+	unsigned long head = ring->head;
+	unsigned long tail = ring->tail;
+	unsigned long message_size;
+
+	if (tail == head)
+		return NULL;
+
+	if (head >= CO_MESSAGE_RING_SIZE  ||  tail >= CO_MESSAGE_RING_SIZE)
+		return NULL;
+
+	co_message_ring_barrier();
+
+	if (CO_MESSAGE_RING_SIZE - tail < sizeof(co_message_t)  ||
+	    ((co_message_t *)&ring->data[tail])->size == CO_MESSAGE_RING_WRAP) {
+		tail = 0;
+		ring->tail = tail;
+		if (tail == head)
+			return NULL;
+	}
+
+	message_size = ((co_message_t *)&ring->data[tail])->size;
+	if (message_size > CO_MESSAGE_RING_SIZE - tail - sizeof(co_message_t))
+		return NULL;
+
+	*size = sizeof(co_message_t) + message_size;
+
+	return (co_message_t *)&ring->data[tail];
+}
+
+/**
+ * Release a message returned by co_message_ring_peek(), along with the
+ * size it reported, back to the producer.
+ */
+static inline void co_message_ring_pop(co_message_ring_t *ring, co_message_t *message, unsigned long size)
+{
+	unsigned long tail;
+
+	tail = ((unsigned char *)message - ring->data) + CO_MESSAGE_RING_ALIGN(size);
+	if (tail == CO_MESSAGE_RING_SIZE)
+		tail = 0;
+
+	co_message_ring_barrier();
+	ring->tail = tail;
+	co_message_ring_barrier();
+}
+
+#endif
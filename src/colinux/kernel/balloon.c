@@ -0,0 +1,150 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+/*
+ * Memory balloon: the host sets how many pages a running guest should
+ * give back, the guest reports how many it has given back so far.
+ */
+
+#include <colinux/common/libc.h>
+#include <colinux/os/kernel/mutex.h>
+#include <colinux/arch/mmu.h>
+
+#include "monitor.h"
+#include "manager.h"
+#include "balloon.h"
+
+/* The balloon never takes the guest below this much RAM */
+#define CO_BALLOON_MIN_RAM (16 << 20)
+
+/*
+ * Without mem=lazy the whole RAM size was charged against the host memory
+ * usage limit at creation, so the pages in the balloon are uncharged here.
+ * With mem=lazy they were already uncharged when the guest freed them.
+ *
+ * The guest only tells how many pages it holds. What counts is how many
+ * the monitor really unmapped: 'balloon_pages' never exceeds the pages
+ * that are not resident, see also co_monitor_balloon_charge().
+ */
+static void balloon_account(co_monitor_t *cmon, unsigned long pages)
+{
+	co_manager_t *manager = cmon->manager;
+	unsigned long unmapped = cmon->physical_frames - cmon->resident_pages;
+
+	if (pages > unmapped)
+		pages = unmapped;
+
+	co_os_mutex_acquire(manager->lock);
+	if (!cmon->config.ram_lazy) {
+		manager->hostmem_used += cmon->balloon_pages << CO_ARCH_PAGE_SHIFT;
+		manager->hostmem_used -= pages << CO_ARCH_PAGE_SHIFT;
+	}
+	cmon->balloon_pages = pages;
+	co_os_mutex_release(manager->lock);
+}
+
+/*
+ * Without mem=lazy, pages that the guest maps again are taken from the
+ * unmapped pages outside of the balloon first, those are still charged.
+ * The rest comes out of the balloon and is charged again, as long as it
+ * fits under the limit.
+ */
+co_rc_t co_monitor_balloon_charge(co_monitor_t *cmon, unsigned long count)
+{
+	co_manager_t *manager = cmon->manager;
+	unsigned long unmapped, excess;
+	co_rc_t rc = CO_RC(OK);
+
+	co_os_mutex_acquire(manager->lock);
+
+	unmapped = cmon->physical_frames - cmon->resident_pages - cmon->balloon_pages;
+	if (count > unmapped) {
+		excess = count - unmapped;
+
+		if (manager->hostmem_used + (excess << CO_ARCH_PAGE_SHIFT) > manager->hostmem_usage_limit) {
+			rc = CO_RC(HOSTMEM_USE_LIMIT_REACHED);
+		} else {
+			manager->hostmem_used += excess << CO_ARCH_PAGE_SHIFT;
+			cmon->balloon_pages -= excess;
+		}
+	}
+
+	co_os_mutex_release(manager->lock);
+
+	return rc;
+}
+
+co_rc_t co_monitor_balloon_set(co_monitor_t *cmon, unsigned long target)
+{
+	co_manager_t *manager = cmon->manager;
+	struct {
+		co_message_t		   message;
+		co_linux_message_t	   linux_msg;
+		co_linux_message_balloon_t data;
+	} message;
+	co_rc_t rc = CO_RC(OK);
+
+	if (target > cmon->physical_frames - (CO_BALLOON_MIN_RAM >> CO_ARCH_PAGE_SHIFT))
+		return CO_RC(INVALID_PARAMETER);
+
+	/* Memory coming back out of the balloon must fit under the limit */
+	co_os_mutex_acquire(manager->lock);
+	if (!cmon->config.ram_lazy  &&  target < cmon->balloon_pages) {
+		unsigned long grow = (cmon->balloon_pages - target) << CO_ARCH_PAGE_SHIFT;
+
+		if (manager->hostmem_used + grow > manager->hostmem_usage_limit)
+			rc = CO_RC(HOSTMEM_USE_LIMIT_REACHED);
+	}
+	co_os_mutex_release(manager->lock);
+
+	if (!CO_OK(rc))
+		return rc;
+
+	co_debug("balloon target %ld pages (now %ld)", target, cmon->balloon_pages);
+
+	cmon->balloon_target = target;
+
+	message.message.from     = CO_MODULE_MONITOR;
+	message.message.to       = CO_MODULE_LINUX;
+	message.message.priority = CO_PRIORITY_IMPORTANT;
+	message.message.type     = CO_MESSAGE_TYPE_OTHER;
+	message.message.size     = sizeof(message.linux_msg) + sizeof(message.data);
+
+	message.linux_msg.device = CO_DEVICE_BALLOON;
+	message.linux_msg.unit   = 0;
+	message.linux_msg.size   = sizeof(message.data);
+
+	message.data.target	 = target;
+
+	return co_monitor_message_from_user(cmon, &message.message);
+}
+
+void co_monitor_balloon_request(co_monitor_t *cmon, unsigned long *params)
+{
+	switch (params[0]) {
+	case CO_BALLOON_REPORT: {
+		unsigned long pages = params[1];
+
+		if (pages > cmon->physical_frames)
+			pages = cmon->physical_frames;
+
+		co_debug_lvl(misc, 11, "balloon holds %ld pages", pages);
+		balloon_account(cmon, pages);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/* The guest is gone or starts over with all of its RAM */
+void co_monitor_balloon_reset(co_monitor_t *cmon)
+{
+	balloon_account(cmon, 0);
+	cmon->balloon_target = 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#ifndef __COLINUX_KERNEL_BALLOON_H__
+#define __COLINUX_KERNEL_BALLOON_H__
+
+#include "monitor.h"
+
+extern co_rc_t co_monitor_balloon_set(co_monitor_t *cmon, unsigned long target);
+extern void co_monitor_balloon_request(co_monitor_t *cmon, unsigned long *params);
+extern void co_monitor_balloon_reset(co_monitor_t *cmon);
+extern co_rc_t co_monitor_balloon_charge(co_monitor_t *cmon, unsigned long count);
+
+#endif
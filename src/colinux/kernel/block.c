@@ -11,6 +11,7 @@
 
 #include "block.h"
 #include "monitor.h"
+#include "transfer.h"
 
 void co_monitor_block_register_device(co_monitor_t *cmon, unsigned int index, co_block_dev_t *dev)
 {
@@ -37,6 +38,14 @@ void co_monitor_unregister_and_free_block_devices(co_monitor_t *cmon)
 	}
 }
 
+static void block_account(co_monitor_t *cmon, co_block_dev_t *dev, co_block_request_t *request)
+{
+	if (request->type == CO_BLOCK_READ)
+		cmon->counters.block_read_bytes[dev->unit] += request->size;
+	else if (request->type == CO_BLOCK_WRITE)
+		cmon->counters.block_write_bytes[dev->unit] += request->size;
+}
+
 static co_block_dev_t* co_monitor_block_dev_from_index(co_monitor_t *cmon, unsigned int index)
 {
 	if (index >= CO_MODULE_MAX_COBD)
@@ -45,6 +54,71 @@ static co_block_dev_t* co_monitor_block_dev_from_index(co_monitor_t *cmon, unsig
 	return cmon->block_devs[index];
 }
 
+/*
+ * Service a batch of read/write descriptors from guest memory with one
+ * switch. Without device specific batch support the descriptors are passed
+ * one by one to the device service, and those it queues are completed by
+ * one interrupt each, as flagged by their 'async'.
+ */
+static co_rc_t monitor_block_batch(co_monitor_t*	cmon,
+				   co_block_dev_t*	dev,
+				   co_block_request_t*	request)
+{
+	co_block_request_t *descs;
+	unsigned long size;
+	unsigned long i;
+	co_rc_t rc;
+
+	request->batch_done = 0;
+	request->async = 0;
+
+	if (request->batch_count == 0  ||  request->batch_count > CO_BLOCK_BATCH_MAX) {
+		co_debug_error("cobd%d: invalid batch count %ld", dev->unit, request->batch_count);
+		return CO_RC(ERROR);
+	}
+
+	size = request->batch_count * sizeof(co_block_request_t);
+	rc = co_monitor_malloc(cmon, size, (void **)&descs);
+	if (!CO_OK(rc))
+		return rc;
+
+	rc = co_monitor_linuxvm_to_host(cmon, request->batch_address, descs, size);
+	if (!CO_OK(rc))
+		goto out;
+
+	for (i = 0; i < request->batch_count; i++) {
+		if (descs[i].type != CO_BLOCK_READ  &&  descs[i].type != CO_BLOCK_WRITE) {
+			co_debug_error("cobd%d: invalid batch type %d", dev->unit, descs[i].type);
+			rc = CO_RC(ERROR);
+			goto out;
+		}
+		descs[i].rc = CO_BLOCK_REQUEST_RETCODE_ERROR;
+		descs[i].async = 0;
+		block_account(cmon, dev, &descs[i]);
+	}
+
+	if (dev->batch) {
+		rc = dev->batch(cmon, dev, request, descs);
+	} else {
+		for (i = 0; i < request->batch_count; i++) {
+			rc = (dev->service)(cmon, dev, &descs[i]);
+			if (CO_OK(rc))
+				descs[i].rc = CO_BLOCK_REQUEST_RETCODE_OK;
+			else
+				descs[i].async = 0; /* no interrupt will come */
+		}
+		request->batch_done = request->batch_count;
+		rc = CO_RC(OK);
+	}
+
+	if (CO_OK(rc))
+		rc = co_monitor_host_to_linuxvm(cmon, descs, request->batch_address, size);
+
+out:
+	co_monitor_free(cmon, descs);
+	return rc;
+}
+
 static co_rc_t intern_monitor_block_request(co_monitor_t*	cmon,
 					    unsigned int	index,
 					    co_block_request_t*	request)
@@ -85,10 +159,14 @@ static co_rc_t intern_monitor_block_request(co_monitor_t*	cmon,
 		co_snprintf(request->alias, sizeof(request->alias), "%s", dev->conf->alias);
 		return CO_RC_OK;
 	}
+	case CO_BLOCK_BATCH:
+		return monitor_block_batch(cmon, dev, request);
 	default:
 		break;
 	}
 
+	block_account(cmon, dev, request);
+
 	rc = (dev->service)(cmon, dev, request);
 
 	switch (request->type) {
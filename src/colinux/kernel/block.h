@@ -22,6 +22,8 @@ struct co_block_dev {
 	co_block_dev_desc_t *conf;
 	co_rc_t (*service)(struct co_monitor *cmon, co_block_dev_t *dev,
 			   co_block_request_t *request);
+	co_rc_t (*batch)(struct co_monitor *cmon, co_block_dev_t *dev,
+			 co_block_request_t *request, co_block_request_t *descs);
 	void (*free)(struct co_monitor *cmon, co_block_dev_t *dev);
 	unsigned int use_count;
 	int unit;
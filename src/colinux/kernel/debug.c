@@ -8,103 +8,15 @@
  */
 
 #include <colinux/os/alloc.h>
+#include <colinux/os/kernel/alloc.h>
+#include <colinux/os/kernel/misc.h>
 #include <colinux/os/kernel/user.h>
 #include <colinux/common/libc.h>
 
 #include "manager.h"
 #include "debug.h"
 
-static void report_status(const char *event, co_manager_debug_t *debug)
-{
-#if 0
-	co_debug_system("colinux-debug: %s: sections: %d, total: %ld, filled: %ld",
-			event, debug->sections_count, debug->sections_total_size,
-			debug->sections_total_filled);
-#endif
-}
-
-static co_rc_t create_section(co_debug_section_t **section_out)
-{
-	co_debug_section_t *section;
-	co_rc_t rc;
-
-	section = co_os_malloc(sizeof(co_debug_section_t));
-	if (!section)
-		return CO_RC(OUT_OF_MEMORY);
-
-	section->buffer = co_os_malloc(CO_DEBUG_SECTION_BUFFER_START_SIZE);
-	if (!section->buffer) {
-		co_os_free(section);
-		return CO_RC(OUT_OF_MEMORY);
-	}
-
-	rc = co_os_mutex_create(&section->mutex);
-	if (!CO_OK(rc)) {
-		co_os_free(section->buffer);
-		co_os_free(section);
-		return rc;
-	}
-
-	co_list_init(&section->node);
-	section->buffer_size = CO_DEBUG_SECTION_BUFFER_START_SIZE;
-	section->filled = 0;
-	section->refcount = 0;
-	section->folded = PFALSE;
-	section->peak_size = section->buffer_size;
-	section->max_size = CO_DEBUG_SECTION_BUFFER_MAX_SIZE;
-
-	*section_out = section;
-
-	return CO_RC(OK);
-}
-
-static void resize_section(co_manager_debug_t *debug, co_debug_section_t *section)
-{
-	long new_size = 0, old_size = 0;
-	char *new_buffer, *old_buffer;
-
-	if (section->filled >= section->buffer_size / 2) {
-		/*
-		 * If the buffer is half full, increase it's size by a factor
-		 * of two. This reduces the chance of losing logs due to write
-		 * bursts but keeps the buffers short.
-		 */
-
-		new_size = section->buffer_size * 2;
-		if (new_size > section->max_size)
-			return;
-	} else if (section->filled < CO_DEBUG_SECTION_BUFFER_START_SIZE) {
-		/*
-		 * Reduce to half the size of the peak size if the buffer is
-		 * quite empty.
-		 */
-		new_size = section->peak_size / 2;
-	}
-
-	if (new_size == 0)
-		return;
-
-	old_size = section->buffer_size;
-	if (old_size != new_size)
-		return;
-
-	new_buffer = co_os_malloc(new_size);
-	if (!new_buffer)
-		return;
-
-	old_buffer = section->buffer;
-	co_memcpy(new_buffer, old_buffer, section->filled);
-
-	debug->sections_total_size += new_size - old_size;
-	section->buffer_size = new_size;
-	section->buffer = new_buffer;
-
-	if (section->peak_size < new_size)
-		section->peak_size = new_size;
-
-	report_status("section resize", debug);
-	co_os_free(old_buffer);
-}
+#define CO_DEBUG_RING_PAGES (CO_DEBUG_RING_SIZE >> CO_ARCH_PAGE_SHIFT)
 
 static void memcpy_vector(char *dest, co_debug_write_vector_t *vec, int vec_size)
 {
@@ -128,269 +40,324 @@ static inline long co_debug_write_vector_size(co_debug_write_vector_t *vec, int
 	return size;
 }
 
-static co_rc_t append_to_buffer(co_manager_debug_t *debug, co_debug_section_t *section,
-				co_debug_write_vector_t *vec, int vec_size)
+static const co_debug_tlv_t debug_tlv_index = {
+	.type = CO_DEBUG_TYPE_DRIVER_INDEX,
+	.length = sizeof(int),
+};
+
+/*
+ * Called from any context the driver logs from. Costs a compare and
+ * exchange to reserve room in the ring of the current CPU, an atomic
+ * increment for the driver index and a barrier before the commit. The
+ * CPU is only a hint: the ring stays consistent if we move meanwhile.
+ */
+co_rc_t co_debug_write_log(co_manager_debug_t *debug,
+			   co_debug_write_vector_t *vec, int vec_size)
 {
-	co_rc_t rc = CO_RC(OK);
-	long vec_length = 0;
+	co_debug_ring_t *ring;
+	co_debug_ring_record_t *record;
+	co_debug_tlv_t tlv;
+	unsigned long size, record_size, aligned_size;
+	unsigned long pos, start, offset;
+	char *data;
+	int index;
 
-	resize_section(debug, section);
+	if (!debug->ready)
+		return CO_RC(OK);
 
-	vec_length = co_debug_write_vector_size(vec, vec_size);
+	size = co_debug_write_vector_size(vec, vec_size);
+	if (size > 0xf8)
+		return CO_RC(OK);
 
-	/* Check if there's not enough space left in the buffer */
-	if (section->buffer_size - section->filled < vec_length) {
-		rc = CO_RC(ERROR);
-	} else {
-		memcpy_vector(&section->buffer[section->filled], vec, vec_size);
-		section->filled += vec_length;
-		debug->sections_total_filled += vec_length;
+	record_size = sizeof(*record) + sizeof(tlv) + size + sizeof(debug_tlv_index) + sizeof(index);
+	aligned_size = CO_DEBUG_RING_ALIGN(record_size);
+
+	ring = &debug->rings[co_os_current_cpu() % debug->rings_count];
+
+	/* Records don't cross the end of the ring, pad up to it if needed */
+	do {
+		pos = ring->reserve;
+		offset = pos & (CO_DEBUG_RING_SIZE - 1);
+		start = pos;
+		if (CO_DEBUG_RING_SIZE - offset < aligned_size)
+			start += CO_DEBUG_RING_SIZE - offset;
+
+		if (start + aligned_size - ring->tail > CO_DEBUG_RING_SIZE) {
+			__sync_fetch_and_add(&ring->dropped, 1);
+			return CO_RC(OK);
+		}
+	} while (__sync_val_compare_and_swap(&ring->reserve, pos, start + aligned_size) != pos);
+
+	index = (int)__sync_add_and_fetch(&debug->driver_index, 1);
+
+	tlv.type = CO_DEBUG_TYPE_TLV;
+	tlv.length = size + sizeof(debug_tlv_index) + sizeof(index);
+
+	record = (co_debug_ring_record_t *)&ring->data[start & (CO_DEBUG_RING_SIZE - 1)];
+	record->size = record_size;
+	data = record->data;
+	co_memcpy(data, &tlv, sizeof(tlv));
+	data += sizeof(tlv);
+	memcpy_vector(data, vec, vec_size);
+	data += size;
+	co_memcpy(data, &debug_tlv_index, sizeof(debug_tlv_index));
+	data += sizeof(debug_tlv_index);
+	co_memcpy(data, &index, sizeof(index));
+
+	if (start != pos) {
+		co_debug_ring_record_t *pad = (co_debug_ring_record_t *)&ring->data[offset];
+
+		pad->size = (start - pos) | CO_DEBUG_RING_PAD;
+		co_debug_ring_barrier();
+		pad->pos = pos;
 	}
 
-	return rc;
-}
+	co_debug_ring_barrier();
+	record->pos = start;
 
-static void get_section(struct co_debug_section *section)
-{
-	section->refcount++;
+	if (debug->reader_sleeping)
+		co_os_wait_wakeup(debug->read_wait);
 
-	co_os_mutex_acquire_critical(section->mutex);
+	return CO_RC(OK);
 }
 
-static bool_t put_section(co_manager_debug_t *debug,
-			  struct co_debug_section *section)
+static bool_t rings_empty(co_manager_debug_t *debug)
 {
-	section->refcount--;
-	if (section->refcount == 0) {
-		debug->sections_count--;
-		debug->sections_total_size -= section->buffer_size;
-		co_os_mutex_release_critical(section->mutex);
-		co_os_mutex_destroy(section->mutex);
-		co_os_free(section->buffer);
-		co_os_free(section);
-		report_status("section release", debug);
-		return PFALSE;
-	}
+	int i;
 
-	co_os_mutex_release_critical(section->mutex);
+	for (i = 0; i < debug->rings_count; i++)
+		if (debug->rings[i].tail != debug->rings[i].reserve)
+			return PFALSE;
 
 	return PTRUE;
 }
 
-static co_rc_t co_debug_writev(co_manager_debug_t *debug,
-			struct co_debug_section **section_ptr,
-			co_debug_write_vector_t *vec, int vec_size)
+/* Sleep until there is something to read */
+static void wait_for_records(co_manager_debug_t *debug)
 {
-	co_rc_t rc;
-	co_debug_section_t *section;
+	debug->reader_sleeping = PTRUE;
+	co_debug_ring_barrier();
 
-	if (debug->sections_total_filled > CO_DEBUG_MAX_FILL)
-		return CO_RC(OK);
+	if (rings_empty(debug))
+		co_os_wait_sleep(debug->read_wait);
 
-	if (debug->freeing)
-		return CO_RC(OK);
+	debug->reader_sleeping = PFALSE;
+}
 
-	section = *section_ptr;
-	if (!section) {
-		rc = create_section(&section);
-		if (!CO_OK(rc))
-			goto out;
+/*
+ * CO_MANAGER_IOCTL_DEBUG_READER: copy the records out, for readers that
+ * don't map the rings.
+ */
+co_rc_t co_debug_read(co_manager_debug_t *debug,
+		      char *buf, unsigned long size,
+		      unsigned long *read_size)
+{
+	unsigned long user_filled = 0;
+	co_rc_t rc = CO_RC(OK);
+	int i;
 
-		debug->sections_count++;
-		debug->sections_total_size += section->buffer_size;
+	*read_size = 0;
 
-		co_os_mutex_acquire_critical(debug->mutex);
-		co_list_add_tail(&section->node, &debug->sections);
-		co_os_mutex_release_critical(debug->mutex);
+	wait_for_records(debug);
 
-		report_status("section created", debug);
-		get_section(section);
+	co_os_mutex_acquire(debug->mutex);
 
-		*section_ptr = section;
-		section->refcount++;
-	} else {
-		get_section(section);
+	if (debug->reader) {
+		co_os_mutex_release(debug->mutex);
+		return CO_RC(ERROR);
 	}
 
-	rc = append_to_buffer(debug, section, vec, vec_size);
+	for (i = 0; i < debug->rings_count; i++) {
+		co_debug_ring_t *ring = &debug->rings[i];
+		unsigned long head = ring->reserve;
+		unsigned long pos = ring->tail;
+		co_debug_ring_record_t *record;
+		unsigned long record_size;
 
-	if (!put_section(debug, section))
-		*section_ptr = NULL;
+		while ((record = co_debug_ring_peek(ring->data, pos, head, &record_size)) != NULL) {
+			if (!(record->size & CO_DEBUG_RING_PAD)) {
+				unsigned long data_size = record_size - sizeof(*record);
 
-	if (CO_OK(rc)) {
-		co_os_wait_wakeup(debug->read_wait);
-	}
+				if (size - user_filled < data_size)
+					break;
 
-out:
-	return rc;
-}
+				rc = co_copy_to_user(&buf[user_filled], record->data, data_size);
+				if (!CO_OK(rc))
+					break;
 
-static int debug_driver_index;
-static co_debug_tlv_t debug_tlv_index = {
-	.type = CO_DEBUG_TYPE_DRIVER_INDEX,
-	.length = sizeof(debug_driver_index),
-};
+				user_filled += data_size;
+			}
+
+			pos += CO_DEBUG_RING_ALIGN(record_size);
+		}
 
-static co_debug_write_vector_t driver_local_vec[2] = {
-	{
-	.size = sizeof(debug_tlv_index),
-	},
-	{
-	.size = sizeof(debug_driver_index),
+		co_debug_ring_barrier();
+		ring->tail = pos;
 	}
-};
 
-co_rc_t co_debug_write_log(co_manager_debug_t *debug,
-			   struct co_debug_section **section_ptr,
-			   co_debug_write_vector_t *vec, int vec_size)
-{
-	unsigned long size;
-	co_debug_tlv_t tlv;
-	co_debug_write_vector_t local_vec[3];
+	co_os_mutex_release(debug->mutex);
 
-	size = co_debug_write_vector_size(vec, vec_size);
-	if (size > 0xf8)
-		return CO_RC(OK);
+	*read_size = user_filled;
 
-	debug_driver_index++;
+	return rc;
+}
 
-	tlv.type = CO_DEBUG_TYPE_TLV;
-	tlv.length = size + sizeof(debug_tlv_index) + sizeof(debug_driver_index);
-
-	local_vec[0].vec_size = 0;
-	local_vec[0].size = sizeof(tlv);
-	local_vec[0].ptr = (void *)&tlv;
-	local_vec[1].vec_size = vec_size;
-	local_vec[1].size = size;
-	local_vec[1].vec = vec;
-	local_vec[2].vec_size = 2;
-	local_vec[2].size = sizeof(debug_tlv_index) + sizeof(debug_driver_index);
-	local_vec[2].vec = driver_local_vec;
-	driver_local_vec[0].ptr = (void *)&debug_tlv_index;
-	driver_local_vec[1].ptr = (void *)&debug_driver_index;
-
-	return co_debug_writev(debug, section_ptr, local_vec, 3);
+static void unmap_rings(co_manager_debug_t *debug)
+{
+	int i;
+
+	for (i = 0; i < debug->rings_count; i++) {
+		co_debug_ring_t *ring = &debug->rings[i];
+
+		if (ring->user_handle)
+			co_os_userspace_unmap(ring->user_address, ring->user_handle, CO_DEBUG_RING_PAGES);
+		ring->user_address = NULL;
+		ring->user_handle = NULL;
+	}
 }
 
-co_rc_t co_debug_read(co_manager_debug_t *debug,
-		      char *buf, unsigned long size,
-		      unsigned long *read_size)
+static co_rc_t map_rings(co_manager_debug_t *debug, co_manager_open_desc_t opened)
 {
 	co_rc_t rc;
-	co_debug_section_t *section, *section_new;
-	long user_filled = 0;
+	int i;
 
-	co_os_wait_sleep(debug->read_wait);
-	co_os_mutex_acquire(debug->mutex);
+	if (debug->reader)
+		return CO_RC(ERROR);
 
-	co_list_each_entry_safe(section, section_new, &debug->sections, node) {
-		bool_t saved = PFALSE;
-		get_section(section);
-
-		if (!(size - user_filled < section->filled)) {
-			rc = co_copy_to_user(&buf[user_filled], section->buffer, section->filled);
-			if (CO_OK(rc)) {
-				user_filled += section->filled;
-				debug->sections_total_filled -= section->filled;
-				section->filled = 0;
-				saved = PTRUE;
-			}
-		}
+	for (i = 0; i < debug->rings_count; i++) {
+		co_debug_ring_t *ring = &debug->rings[i];
 
-		if (saved  &&  section->folded) {
-			co_list_del(&section->node);
-			section->refcount--;
-			section->folded = PFALSE;
+		rc = co_os_userspace_map(ring->data, CO_DEBUG_RING_PAGES,
+					 &ring->user_address, &ring->user_handle);
+		if (!CO_OK(rc)) {
+			ring->user_handle = NULL;
+			unmap_rings(debug);
+			return rc;
 		}
-
-		if (!section->folded)
-			resize_section(debug, section);
-
-		put_section(debug, section);
 	}
 
-	co_os_mutex_release(debug->mutex);
-
-	*read_size = user_filled;
+	debug->reader = opened;
 
 	return CO_RC(OK);
 }
 
-
-co_rc_t co_debug_fold(co_manager_debug_t *debug, co_debug_section_t *section)
+/*
+ * CO_MANAGER_IOCTL_DEBUG_RINGS: the reader reads the records right from
+ * the rings, mapped into it on the first call. Each later call gives
+ * back what it has read and waits for more.
+ */
+co_rc_t co_debug_rings(co_manager_debug_t *debug,
+		       co_manager_open_desc_t opened,
+		       co_manager_ioctl_debug_rings_t *params)
 {
-	char *shrunk_buffer;
 	co_rc_t rc = CO_RC(OK);
+	int i;
 
 	co_os_mutex_acquire(debug->mutex);
-	get_section(section);
 
-	shrunk_buffer = co_os_malloc(section->filled + 1);
-	if (!shrunk_buffer) {
-		rc = CO_RC(OUT_OF_MEMORY);
+	if (params->map) {
+		rc = map_rings(debug, opened);
+	} else if (debug->reader != opened) {
+		rc = CO_RC(ERROR);
 	} else {
-		co_memcpy(shrunk_buffer, section->buffer, section->filled);
-		co_os_free(section->buffer);
+		for (i = 0; i < debug->rings_count; i++) {
+			co_debug_ring_t *ring = &debug->rings[i];
+			unsigned long tail = params->tail[i];
 
-		debug->sections_total_size -= section->buffer_size;
-		section->buffer = shrunk_buffer;
-		section->buffer_size = section->filled;
-		debug->sections_total_size += section->buffer_size;
+			/* Userspace can't move the tail back or past the writers */
+			if (tail - ring->tail <= ring->reserve - ring->tail)
+				ring->tail = tail;
+		}
 	}
 
-	section->folded = PTRUE;
-
-	put_section(debug, section);
 	co_os_mutex_release(debug->mutex);
 
-	return rc;
+	if (!CO_OK(rc))
+		return rc;
+
+	if (!params->map)
+		wait_for_records(debug);
+
+	params->count = debug->rings_count;
+	params->dropped = 0;
+	for (i = 0; i < debug->rings_count; i++) {
+		co_debug_ring_t *ring = &debug->rings[i];
+
+		params->user_address[i] = ring->user_address;
+		params->tail[i] = ring->tail;
+		params->head[i] = ring->reserve;
+		params->dropped += ring->dropped;
+	}
+
+	return CO_RC(OK);
+}
+
+void co_debug_reader_close(co_manager_debug_t *debug, co_manager_open_desc_t opened)
+{
+	co_os_mutex_acquire(debug->mutex);
+	if (debug->reader == opened) {
+		unmap_rings(debug);
+		debug->reader = NULL;
+	}
+	co_os_mutex_release(debug->mutex);
 }
 
 co_rc_t co_debug_init(co_manager_debug_t *debug)
 {
 	co_rc_t rc;
+	int i;
 
-	debug->freeing = PFALSE;
-	debug->section = NULL;
-	debug->sections_total_filled = 0;
-	debug->sections_total_size = 0;
+	co_memset(debug, 0, sizeof(*debug));
 
-	co_list_init(&debug->sections);
+	debug->rings_count = co_os_cpu_count();
+	if (debug->rings_count > CO_DEBUG_RINGS_MAX)
+		debug->rings_count = CO_DEBUG_RINGS_MAX;
+	if (debug->rings_count < 1)
+		debug->rings_count = 1;
+
+	for (i = 0; i < debug->rings_count; i++) {
+		debug->rings[i].data = co_os_alloc_pages(CO_DEBUG_RING_PAGES);
+		if (!debug->rings[i].data) {
+			rc = CO_RC(OUT_OF_MEMORY);
+			goto out_free_rings;
+		}
+
+		/* No stale header may look committed at its position */
+		co_memset(debug->rings[i].data, 0xff, CO_DEBUG_RING_SIZE);
+	}
 
 	rc = co_os_mutex_create(&debug->mutex);
 	if (!CO_OK(rc))
-		goto out;
+		goto out_free_rings;
 
 	rc = co_os_wait_create(&debug->read_wait);
-	if (!CO_OK(rc)) {
-		co_os_mutex_destroy(debug->mutex);
-		goto out;
-	}
+	if (!CO_OK(rc))
+		goto out_free_mutex;
 
 	debug->ready = PTRUE;
 
-out:
+	return CO_RC(OK);
+
+out_free_mutex:
+	co_os_mutex_destroy(debug->mutex);
+out_free_rings:
+	while (i--)
+		co_os_free_pages(debug->rings[i].data, CO_DEBUG_RING_PAGES);
 	return rc;
 }
 
 co_rc_t co_debug_free(co_manager_debug_t *debug)
 {
-	co_debug_section_t *section, *section_new;
+	int i;
 
-	report_status("freeing all sections", debug);
 	debug->ready = PFALSE;
-	debug->freeing = PTRUE;
 
-	co_list_each_entry_safe(section, section_new, &debug->sections, node) {
-		get_section(section);
-		co_list_del(&section->node);
-		section->refcount--;
-		put_section(debug, section);
-	}
+	/* All files are closed by now, and with them any reader */
+	for (i = 0; i < debug->rings_count; i++)
+		co_os_free_pages(debug->rings[i].data, CO_DEBUG_RING_PAGES);
 
 	co_os_wait_destroy(debug->read_wait);
 	co_os_mutex_destroy(debug->mutex);
-	report_status("done freeing", debug);
 
 	return CO_RC(OK);
 }
@@ -409,6 +376,6 @@ void co_debug_buf(const char *buf, long size)
 	vec.size = size;
 	vec.ptr = buf;
 
-	co_debug_write_log(&co_global_manager->debug, &co_global_manager->debug.section, &vec, 1);
+	co_debug_write_log(&co_global_manager->debug, &vec, 1);
 }
 
@@ -11,43 +11,39 @@
 #define __COLINUX_KERNEL_DEBUG_H__
 
 #include <colinux/common/common.h>
+#include <colinux/common/ioctl.h>
+#include <colinux/common/debug_ring.h>
 #include <colinux/common/list.h>
 #include <colinux/os/kernel/mutex.h>
 #include <colinux/os/kernel/wait.h>
 
 struct co_manager;
+struct co_manager_open_desc;
 
-#define CO_DEBUG_MAX_FILL                    (0x100000)
-#define CO_DEBUG_SECTION_BUFFER_MAX_SIZE     (0x10000)
-#define CO_DEBUG_SECTION_BUFFER_START_SIZE   (0x1000)
-
-typedef struct co_debug_section {
-	co_list_t node;
-	char *buffer;
-	long buffer_size;
-	long peak_size;
-	long filled;
-	co_os_mutex_t mutex;
-	int refcount;
-	long max_size;
-	bool_t folded;
-} co_debug_section_t;
+/* One ring per host CPU, see common/debug_ring.h */
+typedef struct co_debug_ring {
+	unsigned char*	       data;
+	volatile unsigned long reserve;  /* position after the last reserved record */
+	volatile unsigned long tail;     /* position of the first unread record */
+	volatile unsigned long dropped;  /* records that found no room */
+	void*		       user_address;
+	void*		       user_handle;
+} co_debug_ring_t;
 
 typedef struct co_manager_debug {
 	bool_t ready;
-	co_list_t sections;
+	int rings_count;
+	co_debug_ring_t rings[CO_DEBUG_RINGS_MAX];
+	volatile unsigned long driver_index;
+
+	/* Readers */
 	co_os_mutex_t mutex;
-	co_debug_section_t *section;
 	co_os_wait_t read_wait;
-	bool_t freeing;
-	int sections_count;
-	long sections_total_size;
-	long sections_total_filled;
+	volatile bool_t reader_sleeping;
+	struct co_manager_open_desc* reader; /* has the rings mapped */
 } co_manager_debug_t;
 
-struct co_manager_per_fd_state;
-
-extern co_rc_t co_debug_init(co_manager_debug_t *manager);
+extern co_rc_t co_debug_init(co_manager_debug_t *debug);
 
 typedef struct co_debug_write_vector {
 	int vec_size;
@@ -59,16 +55,19 @@ typedef struct co_debug_write_vector {
 } co_debug_write_vector_t;
 
 extern co_rc_t co_debug_write_log(co_manager_debug_t *debug,
-				  struct co_debug_section **section_ptr,
 				  co_debug_write_vector_t *vec, int vec_size);
 
-extern co_rc_t co_debug_read(co_manager_debug_t *manager,
+extern co_rc_t co_debug_read(co_manager_debug_t *debug,
 			     char *buf, unsigned long size,
 			     unsigned long *read_size);
 
-extern co_rc_t co_debug_fold(co_manager_debug_t *manager,
-			     co_debug_section_t *section);
+extern co_rc_t co_debug_rings(co_manager_debug_t *debug,
+			      struct co_manager_open_desc *opened,
+			      co_manager_ioctl_debug_rings_t *params);
+
+extern void co_debug_reader_close(co_manager_debug_t *debug,
+				  struct co_manager_open_desc *opened);
 
-extern co_rc_t co_debug_free(co_manager_debug_t *manager);
+extern co_rc_t co_debug_free(co_manager_debug_t *debug);
 
 #endif
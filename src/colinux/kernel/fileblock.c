@@ -92,6 +92,21 @@ static co_rc_t co_monitor_file_block_service(co_monitor_t *cmon,
 	return rc;
 }
 
+static co_rc_t co_monitor_file_block_batch(co_monitor_t *cmon,
+					   co_block_dev_t *dev,
+					   co_block_request_t *request,
+					   co_block_request_t *descs)
+{
+	co_monitor_file_block_dev_t *fdev = (co_monitor_file_block_dev_t *)dev;
+
+	if (fdev->state != CO_MONITOR_FILE_BLOCK_OPENED) {
+		co_debug_error("monitor: batch: cobd not open!");
+		return CO_RC_ERROR;
+	}
+
+	return fdev->op->batch(cmon, dev, fdev, request, descs);
+}
+
 co_rc_t co_monitor_file_block_init(struct co_monitor *cmon,
 				   co_monitor_file_block_dev_t *dev,
 				   co_pathname_t *pathname)
@@ -105,6 +120,8 @@ co_rc_t co_monitor_file_block_init(struct co_monitor *cmon,
 		dev->op = &co_os_file_block_default_operations;
 	dev->state = CO_MONITOR_FILE_BLOCK_CLOSED;
 	dev->dev.service = co_monitor_file_block_service;
+	if (dev->op->batch)
+		dev->dev.batch = co_monitor_file_block_batch;
 
 	return CO_RC(OK);
 }
@@ -30,6 +30,10 @@ typedef struct {
 	co_rc_t (*write)(struct co_monitor *cmon, co_block_dev_t *dev,
 			 co_monitor_file_block_dev_t *fdev, co_block_request_t *request);
 	co_rc_t (*close)(co_monitor_file_block_dev_t *fdev);
+	/* optional, completes all descriptors of a CO_BLOCK_BATCH at once */
+	co_rc_t (*batch)(struct co_monitor *cmon, co_block_dev_t *dev,
+			 co_monitor_file_block_dev_t *fdev, co_block_request_t *request,
+			 co_block_request_t *descs);
 } co_monitor_file_block_operations_t;
 
 struct co_monitor_file_block_dev {
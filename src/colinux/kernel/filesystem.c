@@ -32,6 +32,28 @@ out:
 	return inode;
 }
 
+static unsigned long name_hash(co_inode_t *parent, const char *name)
+{
+	unsigned long hash = parent->number;
+
+	while (*name)
+		hash = hash * 31 + (unsigned char)*name++;
+
+	return hash % CO_FS_HASH_TABLE_SIZE;
+}
+
+static void hash_inode_name(co_filesystem_t *filesystem, co_inode_t *inode)
+{
+	co_list_add_tail(&inode->name_hash_node,
+			 &filesystem->name_hashes[name_hash(inode->parent, inode->name)]);
+}
+
+static void unhash_inode_name(co_inode_t *inode)
+{
+	co_list_del(&inode->name_hash_node);
+	co_list_init(&inode->name_hash_node);
+}
+
 static co_inode_t *alloc_inode(co_filesystem_t *filesystem, co_inode_t *parent, const char *name)
 {
 	co_inode_t *inode;
@@ -65,6 +87,9 @@ static co_inode_t *alloc_inode(co_filesystem_t *filesystem, co_inode_t *parent,
 	}
 
 	co_list_init(&inode->sub_inodes);
+	co_list_init(&inode->name_hash_node);
+	if (parent && inode->name)
+		hash_inode_name(filesystem, inode);
 	co_list_add_tail(&inode->flat_node, &filesystem->list_inodes);
 	co_list_add_tail(&inode->hash_node, &filesystem->inode_hashes[inode->number % CO_FS_HASH_TABLE_SIZE]);
 
@@ -86,18 +111,211 @@ static co_inode_t *find_inode(co_filesystem_t *filesystem, co_inode_t *parent, c
 {
 	co_inode_t *inode = NULL;
 
-        co_list_each_entry(inode, &parent->sub_inodes, node) {
-		if (co_strcmp(inode->name, name) == 0)
+        co_list_each_entry(inode, &filesystem->name_hashes[name_hash(parent, name)], name_hash_node) {
+		if (inode->parent == parent  &&  co_strcmp(inode->name, name) == 0)
 			return inode;
 	}
 
 	return NULL;
 }
 
+/*
+ * Names from the guest become a component of a host pathname, so they
+ * must name an entry of their directory and nothing else.
+ */
+bool_t co_filesystem_name_valid(const char *name)
+{
+	if (!name  ||  !*name)
+		return PFALSE;
+
+	if (co_strcmp(name, ".") == 0  ||  co_strcmp(name, "..") == 0)
+		return PFALSE;
+
+	for (; *name; name++)
+		if (*name == '/')
+			return PFALSE;
+
+	return PTRUE;
+}
+
+/*
+ * Attribute cache.
+ *
+ * Host attributes are kept in the co_inode_t they belong to. Without
+ * change notification an entry is trusted for CO_FS_ATTR_TIMEOUT_MS, the
+ * same time the guest caches it. In a directory that the host watches,
+ * an entry stays valid until the watch reports a change, with
+ * CO_FS_ATTR_NOTIFY_TIMEOUT_MS as a safety net for changes that the
+ * host does not report (e.g. on network filesystems). Changes done by
+ * the guest itself invalidate the entries they touch directly.
+ *
+ * The guest is told at mount to cache attributes as long as the host
+ * does: CO_FS_ATTR_NOTIFY_TIMEOUT_MS when the host has notification,
+ * so that a stat doesn't cost a switch every second.
+ */
+#define CO_FS_ATTR_TIMEOUT_MS		1000
+#define CO_FS_ATTR_NOTIFY_TIMEOUT_MS	60000
+
+static bool_t attr_generation(co_filesystem_t *filesystem, co_inode_t *dir,
+			      co_inode_t *inode, unsigned long *generation)
+{
+	unsigned long self;
+
+	if (!dir)
+		dir = inode;
+
+	if (!filesystem->notify)
+		return PFALSE;
+
+	/* A failed watch costs a host lookup, so it is only tried once */
+	if (!dir->watch) {
+		if (dir->watch_failed)
+			return PFALSE;
+		if (!CO_OK(co_os_fs_watch_dir(filesystem, dir))) {
+			dir->watch_failed = PTRUE;
+			return PFALSE;
+		}
+	}
+
+	if (!co_os_fs_watch_generation(dir->watch, generation))
+		return PFALSE;
+
+	/* A directory also changes with its entries */
+	if (inode  &&  inode != dir  &&  inode->watch  &&
+	    co_os_fs_watch_generation(inode->watch, &self))
+		*generation += self;
+
+	return PTRUE;
+}
+
+static bool_t inode_attr_cached(co_filesystem_t *filesystem, co_inode_t *inode,
+				struct fuse_attr *attr)
+{
+	unsigned long generation;
+	co_timestamp_t now;
+
+	if (!inode->attr_cached)
+		return PFALSE;
+
+	co_os_get_timestamp(&now);
+
+	if (inode->attr_notified) {
+		if (!attr_generation(filesystem, inode->parent, inode, &generation)  ||
+		    generation != inode->attr_generation  ||
+		    now.quad - inode->attr_time.quad > filesystem->attr_notify_timeout)
+			goto expired;
+	} else {
+		if (now.quad - inode->attr_time.quad > filesystem->attr_timeout)
+			goto expired;
+	}
+
+	*attr = inode->attr;
+	return PTRUE;
+
+expired:
+	inode->attr_cached = PFALSE;
+	return PFALSE;
+}
+
+/* 'notified' and 'generation' must be sampled before the host was asked */
+static void inode_attr_store(co_filesystem_t *filesystem, co_inode_t *inode,
+			     struct fuse_attr *attr, bool_t notified,
+			     unsigned long generation)
+{
+	if (filesystem->flags & COFS_MOUNT_NOCACHE)
+		return;
+
+	inode->attr = *attr;
+	inode->attr_generation = generation;
+	inode->attr_notified = notified;
+	co_os_get_timestamp(&inode->attr_time);
+	inode->attr_cached = PTRUE;
+}
+
+static void inode_attr_invalidate(co_inode_t *inode)
+{
+	if (inode)
+		inode->attr_cached = PFALSE;
+}
+
+static void dir_entry_attr_invalidate(co_filesystem_t *filesystem, co_inode_t *dir, const char *name)
+{
+	if (!dir)
+		return;
+
+	inode_attr_invalidate(dir);
+	inode_attr_invalidate(find_inode(filesystem, dir, name));
+}
+
+/* Largest FUSE_READ_PAGES/FUSE_WRITE_PAGES, told to the guest at mount */
+#define CO_FS_IO_MAX		0x100000
+#define CO_FS_IO_PAGES_MAX	((CO_FS_IO_MAX >> CO_ARCH_PAGE_SHIFT) + 1)
+
+/* Most host files kept open at once, see inode_file() */
+#define CO_FS_OPEN_FILES_MAX	64
+
+static void inode_file_close(co_filesystem_t *filesystem, co_inode_t *inode)
+{
+	if (!inode  ||  !inode->file)
+		return;
+
+	co_os_fs_file_close(inode->file);
+	inode->file = NULL;
+	co_list_del(&inode->file_node);
+	filesystem->open_files_count--;
+}
+
+/*
+ * The host file of an inode, opened on the first read or write and kept
+ * open for the following ones, instead of being opened by its pathname
+ * every time. A file that was opened for reading is opened again when
+ * the guest writes to it. The least recently used file is closed when
+ * there are CO_FS_OPEN_FILES_MAX of them.
+ */
+static co_rc_t inode_file(co_filesystem_t *filesystem, co_inode_t *inode,
+			  bool_t write, struct co_os_fs_file **file)
+{
+	co_rc_t rc;
+
+	if (inode->file  &&  (inode->file_write  ||  !write)) {
+		co_list_del(&inode->file_node);
+		co_list_add_head(&inode->file_node, &filesystem->open_files);
+		*file = inode->file;
+		return CO_RC(OK);
+	}
+
+	inode_file_close(filesystem, inode);
+
+	if (filesystem->open_files_count >= CO_FS_OPEN_FILES_MAX) {
+		co_inode_t *oldest;
+
+		co_list_entry_assign(filesystem->open_files.prev, oldest, file_node);
+		inode_file_close(filesystem, oldest);
+	}
+
+	rc = filesystem->ops->inode_open_file(filesystem, inode, write, &inode->file);
+	if (!CO_OK(rc)) {
+		inode->file = NULL;
+		return rc;
+	}
+
+	inode->file_write = write;
+	co_list_add_head(&inode->file_node, &filesystem->open_files);
+	filesystem->open_files_count++;
+
+	*file = inode->file;
+	return CO_RC(OK);
+}
+
 static void free_inode(co_filesystem_t *filesystem, co_inode_t *inode)
 {
+	if (inode->watch)
+		co_os_fs_unwatch_dir(filesystem, inode);
+	inode_file_close(filesystem, inode);
+
 	co_list_del(&inode->flat_node);
 	co_list_del(&inode->hash_node);
+	co_list_del(&inode->name_hash_node);
 	if (inode->parent)
 		co_list_del(&inode->node);
 	if (inode->names)
@@ -118,6 +336,7 @@ static void free_inode_children(co_filesystem_t *filesystem, co_list_t *delete_n
 		co_list_each_entry_safe(inode, inode_new, delete_now, node) {
 			co_list_del(&inode->node);
 			co_list_add_head(&inode->node, delete_later);
+			unhash_inode_name(inode);
 			inode->parent = NULL;
 		}
 	} else {
@@ -174,6 +393,9 @@ static co_rc_t inode_dir_open(co_filesystem_t *filesystem, co_inode_t *inode)
 
 	inode->names->refcount = 1;
 	co_list_init(&inode->names->list);
+	inode->names->cursor = NULL;
+	inode->names->cursor_pos = 0;
+	inode->names->cursor_plus = PFALSE;
 
 	rc = filesystem->ops->getdir(filesystem, inode, inode->names);
 
@@ -187,21 +409,80 @@ static co_rc_t inode_dir_open(co_filesystem_t *filesystem, co_inode_t *inode)
 
 static co_rc_t inode_open(co_filesystem_t *filesystem, co_inode_t *inode, unsigned long flags)
 {
+	/* The guest opens whatever file has the name now, the host follows */
+	inode_file_close(filesystem, inode);
+
 	return CO_RC(OK);
 }
 
-static co_rc_t inode_read(co_monitor_t *cmon, co_filesystem_t *filesystem, co_inode_t *inode,
-			  unsigned long long offset, unsigned long size,
-			  vm_ptr_t dest_buffer)
+static co_rc_t inode_read_write(co_monitor_t *cmon, co_filesystem_t *filesystem, co_inode_t *inode,
+				unsigned long long offset, unsigned long size,
+				vm_ptr_t buffer, bool_t read)
 {
-	return filesystem->ops->inode_read_write(cmon, filesystem, inode, offset, size, dest_buffer, PTRUE);
+	co_filesystem_io_t io;
+	co_rc_t rc;
+
+	if (!inode)
+		return CO_RC(ERROR);
+
+	if (!read)
+		inode_attr_invalidate(inode);
+
+	rc = inode_file(filesystem, inode, !read, &io.file);
+	if (!CO_OK(rc))
+		return rc;
+
+	io.offset = offset;
+	io.done = 0;
+
+	return co_monitor_host_linuxvm_transfer_vec(cmon, &io, co_os_fs_file_transfer,
+						    buffer, size,
+						    read ? CO_MONITOR_TRANSFER_FROM_HOST :
+							   CO_MONITOR_TRANSFER_FROM_LINUX);
 }
 
-static co_rc_t inode_write(co_monitor_t *cmon, co_filesystem_t *filesystem, co_inode_t *inode,
-			   unsigned long long offset, unsigned long size,
-			   vm_ptr_t src_buffer)
+/*
+ * FUSE_READ_PAGES/FUSE_WRITE_PAGES: the data goes between the host file
+ * and the guest pages in 'pages' (a guest array of 'count' page frame
+ * numbers) without a guest side copy. '*size' returns the bytes done.
+ */
+static co_rc_t inode_read_write_pages(co_monitor_t *cmon, co_filesystem_t *filesystem,
+				      co_inode_t *inode, unsigned long long offset,
+				      unsigned long *size, vm_ptr_t pages, unsigned long count,
+				      unsigned long page_offset, bool_t read)
 {
-	return filesystem->ops->inode_read_write(cmon, filesystem, inode, offset, size, src_buffer, PFALSE);
+	co_filesystem_io_t io;
+	co_rc_t rc;
+
+	if (!inode)
+		return CO_RC(ERROR);
+
+	if (*size > CO_FS_IO_MAX  ||  count > CO_FS_IO_PAGES_MAX)
+		return CO_RC(INVALID_PARAMETER);
+
+	if (!read)
+		inode_attr_invalidate(inode);
+
+	rc = co_monitor_linuxvm_to_host(cmon, pages, filesystem->io_pages,
+					count * sizeof(filesystem->io_pages[0]));
+	if (!CO_OK(rc))
+		return rc;
+
+	rc = inode_file(filesystem, inode, !read, &io.file);
+	if (!CO_OK(rc))
+		return rc;
+
+	io.offset = offset;
+	io.done = 0;
+
+	rc = co_monitor_host_linuxvm_transfer_pages(cmon, &io, co_os_fs_file_transfer,
+						    filesystem->io_pages, count,
+						    page_offset, *size,
+						    read ? CO_MONITOR_TRANSFER_FROM_HOST :
+							   CO_MONITOR_TRANSFER_FROM_LINUX);
+	*size = io.done;
+
+	return rc;
 }
 
 static co_rc_t inode_mknod(co_filesystem_t *filesystem, co_inode_t *dir, unsigned long mode,
@@ -209,6 +490,9 @@ static co_rc_t inode_mknod(co_filesystem_t *filesystem, co_inode_t *dir, unsigne
 {
 	co_rc_t rc;
 
+	if (!co_filesystem_name_valid(name))
+		return CO_RC(INVALID_PARAMETER);
+
 	attr->size = 0;
 	attr->mode = mode & filesystem->file_mode;
 	attr->nlink = 1;
@@ -226,9 +510,14 @@ static co_rc_t inode_mknod(co_filesystem_t *filesystem, co_inode_t *dir, unsigne
 	if (CO_OK(rc)) {
 		co_inode_t *inode;
 
+		inode_attr_invalidate(dir);
+
 		inode = find_inode(filesystem, dir, name);
 		if (!inode)
 			inode = alloc_inode(filesystem, dir, name);
+		if (!inode)
+			return CO_RC(OUT_OF_MEMORY);
+		inode_attr_invalidate(inode);
 		*ino = inode->number;
 	}
 
@@ -238,22 +527,44 @@ static co_rc_t inode_mknod(co_filesystem_t *filesystem, co_inode_t *dir, unsigne
 static co_rc_t inode_mkdir(co_filesystem_t *filesystem, co_inode_t *inode, unsigned long mode,
 			   char *name)
 {
+	if (!co_filesystem_name_valid(name))
+		return CO_RC(INVALID_PARAMETER);
+
+	dir_entry_attr_invalidate(filesystem, inode, name);
+
 	return filesystem->ops->inode_mkdir(filesystem, inode, mode, name);
 }
 
 static co_rc_t inode_unlink(co_filesystem_t *filesystem, co_inode_t *inode, char *name)
 {
+	if (!co_filesystem_name_valid(name))
+		return CO_RC(INVALID_PARAMETER);
+
+	dir_entry_attr_invalidate(filesystem, inode, name);
+	if (inode)
+		inode_file_close(filesystem, find_inode(filesystem, inode, name));
+
 	return filesystem->ops->inode_unlink(filesystem, inode, name);
 }
 
 static co_rc_t inode_rmdir(co_filesystem_t *filesystem, co_inode_t *inode, char *name)
 {
+	if (!co_filesystem_name_valid(name))
+		return CO_RC(INVALID_PARAMETER);
+
+	dir_entry_attr_invalidate(filesystem, inode, name);
+
 	return filesystem->ops->inode_rmdir(filesystem, inode, name);
 }
 
 static co_rc_t inode_set_attr(co_filesystem_t *filesystem, co_inode_t *inode,
 			      unsigned long valid, struct fuse_attr *attr)
 {
+	inode_attr_invalidate(inode);
+
+	/* Some hosts open the file exclusively to change it */
+	inode_file_close(filesystem, inode);
+
 	return filesystem->ops->inode_set_attr(filesystem, inode, valid, attr);
 }
 
@@ -263,15 +574,30 @@ static co_rc_t inode_rename(co_filesystem_t *filesystem, co_inode_t *dir,
 	static co_inode_t *new_dir_inode;
 	co_rc_t rc;
 
+	if (!co_filesystem_name_valid(oldname)  ||  !co_filesystem_name_valid(newname))
+		return CO_RC(INVALID_PARAMETER);
+
 	new_dir_inode = ino_num_to_inode(new_dir_num, filesystem);
 	if (!new_dir_inode)
 		return CO_RC(ERROR);
+
+	dir_entry_attr_invalidate(filesystem, dir, oldname);
+	dir_entry_attr_invalidate(filesystem, new_dir_inode, newname);
+
+	/* Some hosts can't rename open files, or rename over them */
+	if (dir) {
+		inode_file_close(filesystem, find_inode(filesystem, dir, oldname));
+		inode_file_close(filesystem, find_inode(filesystem, new_dir_inode, newname));
+	}
+
 	rc = filesystem->ops->inode_rename(filesystem, dir, new_dir_inode, oldname, newname);
 	if (CO_OK(rc)) {
 		co_inode_t *old_inode = find_inode(filesystem, dir, oldname);
 		if (old_inode) {
 			int size;
 
+			unhash_inode_name(old_inode);
+
 			// This moves the file from one dir to an other
 			reparent_inode(old_inode, new_dir_inode);
 
@@ -282,25 +608,73 @@ static co_rc_t inode_rename(co_filesystem_t *filesystem, co_inode_t *dir,
 			if (!old_inode->name)
 				return CO_RC(OUT_OF_MEMORY);
 			co_memcpy(old_inode->name, newname, size);
+
+			hash_inode_name(filesystem, old_inode);
 		}
 	}
 	return rc;
 }
 
 
+/* Upper bound of the dirents staged for one FUSE_DIR_READ(PLUS) */
+#define CO_FS_DIR_READ_MAX	0x10000
+
+static co_rc_t inode_get_attr(co_filesystem_t *filesystem, co_inode_t *inode,
+			      struct fuse_getattr_out *attr);
+static co_rc_t inode_lookup(co_filesystem_t *filesystem, co_inode_t *dir,
+			    char *name, struct fuse_lookup_out *args);
+
+/*
+ * The inode number and attributes of one FUSE_DIR_READPLUS entry, like
+ * a FUSE_LOOKUP of it would return them. An entry that went away since
+ * the directory was opened gets ino -1, the guest looks it up by itself.
+ */
+static void dir_entry_plus(co_filesystem_t *filesystem, co_inode_t *dir,
+			   co_filesystem_name_t *name, struct fuse_direntplus *direntplus)
+{
+	struct fuse_lookup_out lookup;
+	co_inode_t *inode = NULL;
+	co_rc_t rc;
+
+	if (co_strcmp(name->name, ".") == 0)
+		inode = dir;
+	else if (co_strcmp(name->name, "..") == 0)
+		inode = dir->parent ? dir->parent : dir;
+
+	if (inode) {
+		rc = inode_get_attr(filesystem, inode, (struct fuse_getattr_out *)&lookup.attr);
+		lookup.ino = inode->number;
+	} else {
+		rc = inode_lookup(filesystem, dir, name->name, &lookup);
+	}
+
+	if (!CO_OK(rc)) {
+		direntplus->dirent.ino = -1;
+		return;
+	}
+
+	direntplus->attr = lookup.attr;
+	direntplus->dirent.ino = lookup.ino;
+}
+
 static co_rc_t inode_dir_read(co_monitor_t *cmon,
+			      co_filesystem_t *filesystem,
 			      co_inode_t *inode,
 			      vm_ptr_t buff,
 			      unsigned long size,
 			      unsigned long *fill_size,
-			      unsigned long file_pos)
+			      unsigned long file_pos,
+			      bool_t plus)
 {
+	co_filesystem_dir_names_t *names;
 	co_filesystem_name_t *name;
+	co_list_t *item;
 	unsigned long file_pos_seek = 0;
-	struct fuse_dirent dirent;
+	unsigned long name_offset;
+	struct fuse_dirent *dirent;
 	unsigned long dirent_size;
-	vm_ptr_t buff_writeptr;
-	co_rc_t rc;
+	unsigned char *buffer;
+	co_rc_t rc = CO_RC(OK);
 
 	if (!inode)
 		return CO_RC(ERROR);
@@ -308,13 +682,39 @@ static co_rc_t inode_dir_read(co_monitor_t *cmon,
 	if (!inode->names)
 		return CO_RC(ERROR);
 
-	buff_writeptr = buff;
+	names = inode->names;
 	*fill_size = 0;
 
-        co_list_each_entry(name, &inode->names->list, node) {
-		int slen = co_strlen(name->name);
+	name_offset = plus ? FUSE_DIRENTPLUS_NAME_OFFSET : FUSE_NAME_OFFSET;
+
+	if (size > CO_FS_DIR_READ_MAX)
+		size = CO_FS_DIR_READ_MAX;
+
+	buffer = co_os_malloc(size);
+	if (!buffer)
+		return CO_RC(OUT_OF_MEMORY);
+
+	/* Continue from the cursor unless the guest seeked backwards */
+	item = names->list.next;
+	if (names->cursor  &&  names->cursor_plus == plus  &&  names->cursor_pos <= file_pos) {
+		item = names->cursor;
+		file_pos_seek = names->cursor_pos;
+	}
+
+	for (; item != &names->list; item = item->next) {
+		int slen;
+
+		name = co_list_entry(item, co_filesystem_name_t, node);
+		slen = co_strlen(name->name);
+
+		/* TODO: Make it dynamicly.  See NAME_MAX in linux kernel. */
+		if (slen > sizeof(dirent->name)) {
+			/* Name to long */
+			co_debug_lvl(filesystem, 5, "name to long (%d) '%s'", slen, name->name);
+			slen = sizeof(dirent->name);
+		}
 
-		dirent_size = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + slen);
+		dirent_size = FUSE_DIRENT_ALIGN(name_offset + slen);
 		if (file_pos_seek < file_pos) {
 			file_pos_seek += dirent_size;
 			continue;
@@ -325,39 +725,49 @@ static co_rc_t inode_dir_read(co_monitor_t *cmon,
 			break;
 		}
 
-		if (co_strcmp(name->name, "..") == 0) {
-			if (inode->parent)
-				dirent.ino = inode->parent->number;
-			else
-				dirent.ino = inode->number;
-		} else if (co_strcmp(name->name, ".") == 0) {
-			dirent.ino = inode->number;
-		} else {
-			dirent.ino = -1;
-		}
+		co_memset(&buffer[*fill_size], 0, dirent_size);
 
-		/* TODO: Make it dynamicly.  See NAME_MAX in linux kernel. */
-		if (slen > sizeof(dirent.name)) {
-			/* Name to long */
-			co_debug_lvl(filesystem, 5, "name to long (%d) '%s'", slen, name->name);
-			slen = sizeof(dirent.name);
-		}
+		if (plus) {
+			struct fuse_direntplus *direntplus;
+
+			direntplus = (struct fuse_direntplus *)&buffer[*fill_size];
+			dirent = &direntplus->dirent;
 
-		dirent.namelen = slen;
-		dirent.type = name->type;
+			dir_entry_plus(filesystem, inode, name, direntplus);
+		} else {
+			dirent = (struct fuse_dirent *)&buffer[*fill_size];
+
+			if (co_strcmp(name->name, "..") == 0) {
+				if (inode->parent)
+					dirent->ino = inode->parent->number;
+				else
+					dirent->ino = inode->number;
+			} else if (co_strcmp(name->name, ".") == 0) {
+				dirent->ino = inode->number;
+			} else {
+				dirent->ino = -1;
+			}
+		}
 
-		co_memcpy(dirent.name, name->name, slen);
+		dirent->namelen = slen;
+		dirent->type = name->type;
 
-		rc = co_monitor_host_to_linuxvm(cmon, &dirent, buff_writeptr, dirent_size);
-		if (!CO_OK(rc))
-			return rc;
+		co_memcpy(dirent->name, name->name, slen);
 
-		buff_writeptr += dirent_size;
 		*fill_size += dirent_size;
 		file_pos_seek += dirent_size;
 	}
 
-	return CO_RC(OK);
+	names->cursor = item;
+	names->cursor_pos = file_pos_seek;
+	names->cursor_plus = plus;
+
+	if (*fill_size)
+		rc = co_monitor_host_to_linuxvm(cmon, buffer, buff, *fill_size);
+
+	co_os_free(buffer);
+
+	return rc;
 }
 
 static co_rc_t inode_dir_release(co_inode_t *inode)
@@ -394,6 +804,7 @@ co_rc_t co_monitor_file_system_init(co_monitor_t *cmon, unsigned int unit,
 				    co_cofsdev_desc_t *desc)
 {
 	co_filesystem_t *filesystem;
+	unsigned long long n;
 	int i;
 
 	filesystem = co_os_malloc(sizeof(*filesystem));
@@ -404,10 +815,26 @@ co_rc_t co_monitor_file_system_init(co_monitor_t *cmon, unsigned int unit,
 
 	for (i=0; i < CO_FS_HASH_TABLE_SIZE; i++) {
 		co_list_init(&filesystem->inode_hashes[i]);
+		co_list_init(&filesystem->name_hashes[i]);
 	}
 
 	filesystem->next_inode_num = 1;
 
+	co_list_init(&filesystem->open_files);
+	filesystem->io_pages = co_os_malloc(CO_FS_IO_PAGES_MAX * sizeof(filesystem->io_pages[0]));
+	if (!filesystem->io_pages) {
+		co_os_free(filesystem);
+		return CO_RC(OUT_OF_MEMORY);
+	}
+
+	n = cmon->timestamp_freq.quad * CO_FS_ATTR_TIMEOUT_MS;
+	co_div64_32(&n, 1000);
+	filesystem->attr_timeout = n;
+
+	n = cmon->timestamp_freq.quad * CO_FS_ATTR_NOTIFY_TIMEOUT_MS;
+	co_div64_32(&n, 1000);
+	filesystem->attr_notify_timeout = n;
+
 	co_list_init(&filesystem->list_inodes);
 	co_memcpy(&filesystem->base_path, &desc->pathname, sizeof(co_pathname_t));
 	filesystem->desc = desc;
@@ -415,10 +842,15 @@ co_rc_t co_monitor_file_system_init(co_monitor_t *cmon, unsigned int unit,
 	filesystem->root = alloc_inode(filesystem, NULL, NULL);
 
 	if (!filesystem->root) {
+		co_os_free(filesystem->io_pages);
 		co_os_free(filesystem);
 		return CO_RC(OUT_OF_MEMORY);
 	}
 
+	/* Without notification the cache falls back to its timeout */
+	if (!CO_OK(co_os_fs_notify_init(filesystem)))
+		filesystem->notify = NULL;
+
 	cmon->filesystems[unit] = filesystem;
 
 	return CO_RC(OK);
@@ -437,6 +869,10 @@ void co_monitor_file_system_free(co_monitor_t *cmon, int unit)
 		free_inode(filesystem, inode);
 	}
 
+	if (filesystem->notify)
+		co_os_fs_notify_free(filesystem);
+
+	co_os_free(filesystem->io_pages);
 	co_os_free(filesystem);
 	cmon->filesystems[unit] = NULL;
 }
@@ -444,28 +880,61 @@ void co_monitor_file_system_free(co_monitor_t *cmon, int unit)
 static co_rc_t inode_get_attr(co_filesystem_t *filesystem, co_inode_t *inode,
 			      struct fuse_getattr_out *attr)
 {
+	unsigned long generation = 0;
+	bool_t notified;
 	char *name;
+	co_rc_t rc;
 
-	name = inode->name;
-	inode = inode->parent;
+	if (!inode)
+		return CO_RC(ERROR);
+
+	if (inode_attr_cached(filesystem, inode, &attr->attr))
+		return CO_RC(OK);
 
+	name = inode->name;
 	if (name == NULL)
 		name = "";
 
-	return filesystem->ops->getattr(filesystem, inode, name, &attr->attr);
+	notified = attr_generation(filesystem, inode->parent, inode, &generation);
+
+	rc = filesystem->ops->getattr(filesystem, inode->parent, name, &attr->attr);
+	if (CO_OK(rc))
+		inode_attr_store(filesystem, inode, &attr->attr, notified, generation);
+
+	return rc;
 }
 
 static co_rc_t inode_lookup(co_filesystem_t *filesystem, co_inode_t *dir,
 			    char *name, struct fuse_lookup_out *args)
 {
-	co_rc_t rc = filesystem->ops->getattr(filesystem, dir, name, &args->attr);
+	unsigned long generation = 0;
+	bool_t notified;
+	co_inode_t *inode;
+	co_rc_t rc;
+
+	if (!dir)
+		return CO_RC(ERROR);
+
+	if (!co_filesystem_name_valid(name))
+		return CO_RC(NOT_FOUND);
+
+	inode = find_inode(filesystem, dir, name);
+	if (inode  &&  inode_attr_cached(filesystem, inode, &args->attr)) {
+		args->ino = inode->number;
+		return CO_RC(OK);
+	}
+
+	notified = attr_generation(filesystem, dir, inode, &generation);
+
+	rc = filesystem->ops->getattr(filesystem, dir, name, &args->attr);
 
 	if (CO_OK(rc)) {
-		co_inode_t *inode = NULL;
-		inode = find_inode(filesystem, dir, name);
 		if (!inode)
 			inode = alloc_inode(filesystem, dir, name);
+		if (!inode)
+			return CO_RC(OUT_OF_MEMORY);
 		args->ino = inode->number;
+		inode_attr_store(filesystem, inode, &args->attr, notified, generation);
 	}
 
 	return rc;
@@ -487,16 +956,45 @@ static int translate_code(co_rc_t value)
 	}
 }
 
+/*
+ * The subpath of FUSE_MOUNT is joined to the configured host directory,
+ * it may only go down from there.
+ */
+static bool_t mount_subpath_valid(const char *pathname)
+{
+	const char *next;
+	int len;
+
+	for (; *pathname; pathname = next) {
+		while (*pathname == '/')
+			pathname++;
+
+		for (next = pathname; *next  &&  *next != '/'; next++)
+			;
+
+		len = next - pathname;
+		if ((len == 1  &&  pathname[0] == '.')  ||
+		    (len == 2  &&  pathname[0] == '.'  &&  pathname[1] == '.'))
+			return PFALSE;
+	}
+
+	return PTRUE;
+}
+
 static co_rc_t fs_mount(co_filesystem_t *filesystem, const char *pathname,
 			int uid, int gid,
 			unsigned long dir_mode, unsigned long file_mode,
 			int flags)
 {
 	co_cofsdev_desc_t *desc;
+	co_inode_t *inode;
 	co_rc_t rc;
 
 	desc = filesystem->desc;
 
+	if (!mount_subpath_valid(pathname))
+		return CO_RC(INVALID_PARAMETER);
+
 	filesystem->uid = uid;
 	filesystem->gid = gid;
 	filesystem->dir_mode = dir_mode;
@@ -507,6 +1005,15 @@ static co_rc_t fs_mount(co_filesystem_t *filesystem, const char *pathname,
 
 	rc = co_os_fs_dir_join_unix_path(&filesystem->base_path, pathname);
 
+	/* Nothing cached so far refers to the new base path */
+	co_list_each_entry(inode, &filesystem->list_inodes, flat_node) {
+		inode->attr_cached = PFALSE;
+		inode->watch_failed = PFALSE;
+		if (inode->watch)
+			co_os_fs_unwatch_dir(filesystem, inode);
+		inode_file_close(filesystem, inode);
+	}
+
 	return rc;
 }
 
@@ -538,6 +1045,13 @@ void co_monitor_file_system(co_monitor_t *cmon, unsigned int unit,
 				  co_passage_page->params[8],
 				  co_passage_page->params[9]);
 		result = translate_code(result);
+		/* Tells the guest how long it may cache attributes */
+		if (filesystem->notify)
+			co_passage_page->params[10] = CO_FS_ATTR_NOTIFY_TIMEOUT_MS;
+		else
+			co_passage_page->params[10] = CO_FS_ATTR_TIMEOUT_MS;
+		co_passage_page->params[11] = COFS_FEATURE_READDIRPLUS | COFS_FEATURE_PAGEIO;
+		co_passage_page->params[12] = CO_FS_IO_MAX;
 		goto out;
 	case FUSE_STATFS:
 		result = fs_stat(filesystem, (struct fuse_statfs_out *)(&co_passage_page->params[5]));
@@ -603,20 +1117,26 @@ void co_monitor_file_system(co_monitor_t *cmon, unsigned int unit,
 		result = translate_code(result);
 		break;
 
-	case FUSE_WRITE: {
-		result = inode_write(cmon, filesystem, inode,
-				     *((unsigned long long *)&co_passage_page->params[5]),
-				     co_passage_page->params[7],
-				     co_passage_page->params[8]);
+	case FUSE_WRITE:
+	case FUSE_READ: {
+		result = inode_read_write(cmon, filesystem, inode,
+					  *((unsigned long long *)&co_passage_page->params[5]),
+					  co_passage_page->params[7],
+					  co_passage_page->params[8],
+					  opcode == FUSE_READ);
 		result = translate_code(result);
 		break;
 	}
 
-	case FUSE_READ: {
-		result = inode_read(cmon, filesystem, inode,
-				    *((unsigned long long *)&co_passage_page->params[5]),
-				    co_passage_page->params[7],
-				    co_passage_page->params[8]);
+	case FUSE_WRITE_PAGES:
+	case FUSE_READ_PAGES: {
+		result = inode_read_write_pages(cmon, filesystem, inode,
+						*((unsigned long long *)&co_passage_page->params[5]),
+						&co_passage_page->params[7],
+						co_passage_page->params[8],
+						co_passage_page->params[9],
+						co_passage_page->params[10],
+						opcode == FUSE_READ_PAGES);
 		result = translate_code(result);
 		break;
 	}
@@ -648,11 +1168,13 @@ void co_monitor_file_system(co_monitor_t *cmon, unsigned int unit,
 		break;
 
 	case FUSE_DIR_READ:
-		result = inode_dir_read(cmon, inode,
+	case FUSE_DIR_READPLUS:
+		result = inode_dir_read(cmon, filesystem, inode,
 					co_passage_page->params[6],
 					co_passage_page->params[5],
 					&co_passage_page->params[7],
-					co_passage_page->params[8]);
+					co_passage_page->params[8],
+					opcode == FUSE_DIR_READPLUS);
 		result = translate_code(result);
 		break;
 
@@ -688,7 +1210,7 @@ static co_rc_t co_fs_get_attr(co_filesystem_t *fs, char *filename, struct fuse_a
 {
 	co_rc_t rc;
 
-	rc = co_os_file_get_attr(filename, attr);
+	rc = co_os_file_get_attr(fs, filename, attr);
 	if (!CO_OK(rc))
 		return rc;
 
@@ -719,7 +1241,7 @@ static co_rc_t flat_mode_inode_rename(co_filesystem_t *filesystem, co_inode_t *o
 	if (CO_OK(rc)) {
 		rc = co_os_fs_dir_inode_to_path(filesystem, new_inode, &new_dirname, newname);
 		if (CO_OK(rc)) {
-			rc = co_os_file_rename(old_dirname, new_dirname);
+			rc = co_os_file_rename(filesystem, old_dirname, new_dirname);
 			co_os_free(new_dirname);
 		}
 		co_os_free(old_dirname);
@@ -753,15 +1275,14 @@ static co_rc_t flat_mode_getdir(co_filesystem_t *fs, co_inode_t *dir, co_filesys
 	if (!CO_OK(rc))
 		return rc;
 
-	rc = co_os_file_getdir(dirname, names);
+	rc = co_os_file_getdir(fs, dirname, names);
 	co_os_free(dirname);
 
 	return rc;
 }
 
-static co_rc_t flat_mode_inode_read_write(co_monitor_t *linuxvm, co_filesystem_t *filesystem, co_inode_t *inode,
-				  unsigned long long offset, unsigned long size,
-				  vm_ptr_t src_buffer, bool_t read)
+static co_rc_t flat_mode_inode_open_file(co_filesystem_t *filesystem, co_inode_t *inode,
+					 bool_t write, struct co_os_fs_file **file)
 {
 	char *filename;
 	co_rc_t rc;
@@ -770,7 +1291,7 @@ static co_rc_t flat_mode_inode_read_write(co_monitor_t *linuxvm, co_filesystem_t
 	if (!CO_OK(rc))
 		return rc;
 
-	rc = co_os_file_read_write(linuxvm, filename, offset, size, src_buffer, read);
+	rc = co_os_fs_file_open(filesystem, filename, write, file);
 	co_os_free(filename);
 
 	return rc;
@@ -805,7 +1326,7 @@ static co_rc_t flat_mode_inode_set_attr(co_filesystem_t *filesystem, co_inode_t
 	if (filesystem->flags & COFS_MOUNT_NOATTRIB)
 		valid &= ~FATTR_MODE;
 
-	rc = co_os_file_set_attr(filename, valid, attr);
+	rc = co_os_file_set_attr(filesystem, filename, valid, attr);
 	co_os_free(filename);
 
 	return rc;
@@ -821,7 +1342,7 @@ static co_rc_t flat_mode_inode_mkdir(co_filesystem_t *filesystem, co_inode_t *in
 	if (!CO_OK(rc))
 		return rc;
 
-	rc = co_os_file_mkdir(dirname);
+	rc = co_os_file_mkdir(filesystem, dirname);
 	co_os_free(dirname);
 
 	return rc;
@@ -836,7 +1357,7 @@ static co_rc_t flat_mode_inode_unlink(co_filesystem_t *filesystem, co_inode_t *i
 	if (!CO_OK(rc))
 		return rc;
 
-	rc = co_os_file_unlink(filename);
+	rc = co_os_file_unlink(filesystem, filename);
 	co_os_free(filename);
 
 	return rc;
@@ -851,7 +1372,7 @@ static co_rc_t flat_mode_inode_rmdir(co_filesystem_t *filesystem, co_inode_t *in
 	if (!CO_OK(rc))
 		return rc;
 
-	rc = co_os_file_rmdir(dirname);
+	rc = co_os_file_rmdir(filesystem, dirname);
 	co_os_free(dirname);
 
 	return rc;
@@ -867,7 +1388,7 @@ static struct co_filesystem_ops flat_mode = {
 	.inode_rename = flat_mode_inode_rename,
 	.getattr = flat_mode_getattr,
 	.getdir = flat_mode_getdir,
-	.inode_read_write = flat_mode_inode_read_write,
+	.inode_open_file = flat_mode_inode_open_file,
 	.inode_mknod = flat_mode_inode_mknod,
 	.inode_set_attr = flat_mode_inode_set_attr,
 	.inode_mkdir = flat_mode_inode_mkdir,
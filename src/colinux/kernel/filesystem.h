@@ -13,6 +13,7 @@
 #include <colinux/common/list.h>
 #include <colinux/common/common.h>
 #include <colinux/common/config.h>
+#include <colinux/os/timer.h>
 
 #include <linux/cooperative_fs.h>
 
@@ -25,17 +26,42 @@ typedef struct  co_filesystem_name {
 typedef struct co_filesystem_dir_names {
 	co_list_t list;
 	int refcount;
+
+	/*
+	 * Readdir continuation: the next name to send and its offset in
+	 * the dirent stream, so a sequential listing needs no rescan.
+	 */
+	co_list_t *cursor;
+	unsigned long cursor_pos;
+	bool_t cursor_plus; /* FUSE_DIR_READPLUS stream */
 } co_filesystem_dir_names_t;
 
 typedef struct co_inode {
 	co_list_t flat_node;
 	co_list_t hash_node;
+	co_list_t name_hash_node;
 	co_list_t node;
 	struct co_inode *parent;
 	co_list_t sub_inodes;
 	char *name;
 	co_filesystem_dir_names_t *names;
 	int number;
+
+	/* Cached host attributes, see inode_attr_cached() */
+	struct fuse_attr attr;
+	co_timestamp_t attr_time;
+	unsigned long attr_generation;
+	bool_t attr_cached;
+	bool_t attr_notified;
+
+	/* Host change notification, directories only */
+	struct co_os_fs_watch *watch;
+	bool_t watch_failed; /* don't retry, the plain timeout applies */
+
+	/* Host file kept open between reads and writes, see inode_file() */
+	struct co_os_fs_file *file;
+	bool_t file_write;
+	co_list_t file_node;
 } co_inode_t;
 
 #define CO_FS_HASH_TABLE_SIZE     0x1000
@@ -55,9 +81,35 @@ typedef struct co_filesystem {
 
 	/* Inode hash table */
 	co_list_t inode_hashes[CO_FS_HASH_TABLE_SIZE];
+
+	/* Children by (parent, name), see find_inode() */
+	co_list_t name_hashes[CO_FS_HASH_TABLE_SIZE];
+
+	/* Attribute cache, timeouts in timestamp units */
+	unsigned long long attr_timeout;
+	unsigned long long attr_notify_timeout;
+	struct co_os_fs_notify *notify; /* NULL without host change notification */
+
+	/* Inodes with an open host file, most recently used first */
+	co_list_t open_files;
+	int open_files_count;
+
+	/* Guest page frames of the current FUSE_READ_PAGES/FUSE_WRITE_PAGES */
+	unsigned long *io_pages;
 	int next_inode_num;
 } co_filesystem_t;
 
+/*
+ * Host data of co_os_fs_file_transfer(): the file and its offset at the
+ * start of the transfer. 'done' counts the bytes transferred, reads stop
+ * short at the end of the file.
+ */
+typedef struct co_filesystem_io {
+	struct co_os_fs_file *file;
+	unsigned long long offset;
+	unsigned long done;
+} co_filesystem_io_t;
+
 struct co_monitor;
 
 typedef struct co_filesystem_ops {
@@ -65,9 +117,8 @@ typedef struct co_filesystem_ops {
 				char *oldname, char *newname);
 	co_rc_t (*getattr)(co_filesystem_t *fs, co_inode_t *dir, char *name, struct fuse_attr *attr);
 	co_rc_t (*getdir)(co_filesystem_t *fs, co_inode_t *dir, co_filesystem_dir_names_t *names);
-	co_rc_t (*inode_read_write)(struct co_monitor *linuxvm, co_filesystem_t *filesystem,
-				    co_inode_t *inode, unsigned long long offset, unsigned long size,
-				    vm_ptr_t src_buffer, bool_t read);
+	co_rc_t (*inode_open_file)(co_filesystem_t *filesystem, co_inode_t *inode,
+				   bool_t write, struct co_os_fs_file **file);
 	co_rc_t (*inode_mknod)(co_filesystem_t *filesystem, co_inode_t *inode, unsigned long mode,
 			       unsigned long rdev, char *name, int *ino, struct fuse_attr *attr);
 	co_rc_t (*inode_set_attr)(co_filesystem_t *filesystem, co_inode_t *inode,
@@ -84,6 +135,7 @@ extern void co_monitor_file_system(struct co_monitor *cmon, unsigned int unit,
 				   enum fuse_opcode opcode, unsigned long *params);
 
 extern void co_filesystem_getdir_free(co_filesystem_dir_names_t *names);
+extern bool_t co_filesystem_name_valid(const char *name);
 
 extern co_rc_t co_monitor_file_system_init(struct co_monitor *cmon, unsigned int unit,
 					   co_cofsdev_desc_t *desc);
@@ -29,14 +29,17 @@ co_manager_t* co_global_manager = NULL;
 
 static void set_hostmem_usage_limit(co_manager_t* manager)
 {
-	if (manager->hostmem_amount >= 256) {
+	/* Only the pages below CO_HOST_PFN_LIMIT can be given to monitors */
+	unsigned long amount = manager->hostmem_pfn_limit >> (20-CO_ARCH_PAGE_SHIFT);
+
+	if (amount >= 256) {
 		/* more than 256MB */
 		/* use_limit = host - 64mb */
-		manager->hostmem_usage_limit = manager->hostmem_amount - 64;
+		manager->hostmem_usage_limit = amount - 64;
 	} else {
 		/* less then 256MB */
 		/* use_limit = host * (3/4) */
-		manager->hostmem_usage_limit = manager->hostmem_amount*3/4;
+		manager->hostmem_usage_limit = amount*3/4;
 	}
 
 	co_debug("machine RAM use limit: %ld MB" , manager->hostmem_usage_limit);
@@ -68,11 +71,10 @@ co_rc_t co_manager_load(co_manager_t *manager)
 	manager->hostmem_amount = manager->hostmem_pages >> (20-CO_ARCH_PAGE_SHIFT);
 	co_debug("machine has %ld MB of RAM", manager->hostmem_amount);
 
-	if (manager->hostmem_pages > 0x100000) {
-		co_debug_error("error, machines with more than 4GB are not currently supported");
-		rc = CO_RC(ERROR);
-		goto out_err_mutex;
-	}
+	manager->hostmem_pfn_limit = min(manager->hostmem_pages, CO_HOST_PFN_LIMIT);
+	if (manager->hostmem_pfn_limit < manager->hostmem_pages)
+		co_debug("using host RAM below %ld MB for monitors",
+			 manager->hostmem_pfn_limit >> (20-CO_ARCH_PAGE_SHIFT));
 
 	set_hostmem_usage_limit(manager);
 
@@ -140,28 +142,56 @@ void co_manager_unload(co_manager_t* manager)
 	manager->state = CO_MANAGER_STATE_NOT_INITIALIZED;
 }
 
+/*
+ * Credit based flow control towards the daemons: each reader can have
+ * up to CO_QUEUE_SEND_CREDITS messages waiting in its out_queue, and
+ * gets a credit back for every message it drains. This runs in the
+ * world switch path, so it must never wait for the reader. Once the
+ * credits run out, discardable messages are dropped and counted.
+ *
+ * Important messages are never dropped, the old sleeping sender never
+ * lost any either: they are parked in the queue past the credit limit
+ * until the reader catches up. Once CO_QUEUE_PARK_LIMIT messages pile
+ * up, the reader is marked parked, and the monitor stops running Linux
+ * until it drained its queue back below the credits, see
+ * co_manager_send_unpark(). The queue grows by no more than one message
+ * per switch past the limit meanwhile.
+ */
 co_rc_t co_manager_send(co_manager_t*		manager,
                         co_manager_open_desc_t 	opened,
                         co_message_t*		message)
 {
-	bool_t  ret;
-	co_rc_t rc = CO_RC_OK;
+	bool_t        ret;
+	unsigned long queued;
+	co_rc_t       rc = CO_RC_OK;
 
 	co_os_mutex_acquire(opened->lock);
 
 	ret = co_os_manager_userspace_try_send_direct(manager, opened, message);
 	if (!ret && opened->active) {
-		rc = co_message_dup_to_queue(message, &opened->out_queue);
+		queued = co_queue_size(&opened->out_queue);
+
+		if (queued >= CO_QUEUE_SEND_CREDITS  &&  message->priority == CO_PRIORITY_DISCARDABLE) {
+			if (!opened->throttled)
+				co_debug("queue %d out of credits with %ld items, dropping",
+				         message->to, queued);
+			opened->throttled = PTRUE;
+			opened->messages_dropped++;
+			rc = CO_RC(ERROR);
+		} else {
+			if (opened->throttled  &&  queued < CO_QUEUE_SEND_CREDITS) {
+				co_debug("queue %d has credits again, %ld messages dropped so far",
+				         message->to, opened->messages_dropped);
+				opened->throttled = PFALSE;
+			}
 
-		if (co_queue_size(&opened->out_queue) > CO_QUEUE_COUNT_LIMIT_BEFORE_SLEEP)
-			co_debug("queue %d exceed limit with items %ld",
-			         message->to, opened->out_queue.items_count);
+			if (queued >= CO_QUEUE_PARK_LIMIT  &&  !opened->parked) {
+				co_debug_error("queue %d: reader stalled, %ld messages parked",
+					       message->to, queued);
+				opened->parked = PTRUE;
+			}
 
-		while (co_queue_size(&opened->out_queue) > CO_QUEUE_COUNT_LIMIT_BEFORE_SLEEP
-		       && opened->active) {
-			co_os_mutex_release(opened->lock);
-			co_os_msleep(100);
-			co_os_mutex_acquire(opened->lock);
+			rc = co_message_dup_to_queue(message, &opened->out_queue);
 		}
 	}
 
@@ -170,9 +200,45 @@ co_rc_t co_manager_send(co_manager_t*		manager,
 	return rc;
 }
 
+/*
+ * Called by the monitor before it runs Linux again, after a send parked
+ * 'opened'. Sleeps once on the reader. Returns PFALSE if the reader is
+ * still parked then; the monitor goes back to userspace and tries again
+ * on its next run, so it can still be stopped.
+ */
+bool_t co_manager_send_unpark(co_manager_t *manager, co_manager_open_desc_t opened)
+{
+	bool_t parked;
+
+	co_os_mutex_acquire(opened->lock);
+	parked = opened->parked  &&  opened->active;
+	co_os_mutex_release(opened->lock);
+
+	if (!parked)
+		return PTRUE;
+
+	co_os_wait_sleep(opened->drained);
+
+	co_os_mutex_acquire(opened->lock);
+	parked = opened->parked  &&  opened->active;
+	co_os_mutex_release(opened->lock);
+
+	return !parked;
+}
+
+/* Called with opened->lock held, after the reader took messages out */
+void co_manager_reader_drained(co_manager_open_desc_t opened)
+{
+	if (opened->parked  &&  co_queue_size(&opened->out_queue) < CO_QUEUE_SEND_CREDITS) {
+		opened->parked = PFALSE;
+		co_os_wait_wakeup(opened->drained);
+	}
+}
+
 co_rc_t co_manager_send_eof(co_manager_t* manager, co_manager_open_desc_t opened)
 {
 	opened->active = PFALSE;
+	co_os_wait_wakeup(opened->drained);
 
 	return co_os_manager_userspace_eof(manager, opened);
 }
@@ -192,15 +258,22 @@ co_rc_t co_manager_open(co_manager_t* manager, co_manager_open_desc_t* opened_ou
 	if (!CO_OK(rc))
 		return rc;
 
+	rc = co_os_wait_create(&opened->drained);
+	if (!CO_OK(rc)) {
+		co_os_mutex_destroy(opened->lock);
+		co_os_free(opened);
+		return rc;
+	}
+
 	rc = co_os_manager_userspace_open(opened);
 	if (!CO_OK(rc)) {
+		co_os_wait_destroy(opened->drained);
 		co_os_mutex_destroy(opened->lock);
 		co_os_free(opened);
 		return rc;
 	}
 
 	opened->monitor = NULL;
-	opened->debug_section = NULL;
 	opened->ref_count = 1;
 	opened->active = PTRUE;
 
@@ -227,18 +300,16 @@ static co_rc_t co_manager_close_(co_manager_t*          manager,
 		co_monitor_refdown(mon, PFALSE, opened->monitor_owner);
 	}
 
-	if (opened->debug_section != NULL) {
-		co_debug_fold(&manager->debug, opened->debug_section);
-		opened->debug_section = NULL;
-	}
+	co_debug_reader_close(&manager->debug, opened);
 
 	co_os_mutex_acquire(manager->lock);
 	co_list_del(&opened->node);
 	manager->num_opens--;
 	co_os_mutex_release(manager->lock);
 
+	co_os_wait_destroy(opened->drained);
 	co_os_mutex_destroy(opened->lock);
-	co_queue_flush(&opened->out_queue);
+	co_message_queue_flush(&opened->out_queue);
 	co_os_free(opened);
 
 	return CO_RC(OK);
@@ -281,6 +352,7 @@ co_rc_t co_manager_open_desc_deactive_and_close(co_manager_t*	       manager,
 	co_rc_t rc;
 
 	opened->active = PFALSE;
+	co_os_wait_wakeup(opened->drained);
 	if (opened->monitor != NULL) {
 		co_monitor_t* mon = opened->monitor;
 		int           index;
@@ -346,6 +418,7 @@ co_rc_t co_manager_ioctl(co_manager_t* 		manager,
 		params = (typeof(params))(io_buffer);
 		params->hostmem_usage_limit = manager->hostmem_usage_limit;
 		params->hostmem_used        = manager->hostmem_used;
+		params->reversed_pages_used = manager->reversed_pages_used;
 
 		*return_size = sizeof(*params);
 		return CO_RC(OK);
@@ -358,7 +431,7 @@ co_rc_t co_manager_ioctl(co_manager_t* 		manager,
 		vec.size     = in_size;
 		vec.ptr      = io_buffer;
 
-		co_debug_write_log(&manager->debug, &opened->debug_section, &vec, 1);
+		co_debug_write_log(&manager->debug, &vec, 1);
 
 		return CO_RC(OK);
 	}
@@ -373,6 +446,19 @@ co_rc_t co_manager_ioctl(co_manager_t* 		manager,
 
 		*return_size = sizeof(*params);
 
+		return CO_RC(OK);
+	}
+	case CO_MANAGER_IOCTL_DEBUG_RINGS: {
+		co_manager_ioctl_debug_rings_t *params;
+
+		if (in_size < sizeof(*params)  ||  out_size < sizeof(*params))
+			return CO_RC(ERROR);
+
+		params = (typeof(params))(io_buffer);
+		params->rc = co_debug_rings(&manager->debug, opened, params);
+
+		*return_size = sizeof(*params);
+
 		return CO_RC(OK);
 	}
 #ifdef COLINUX_DEBUG
@@ -512,6 +598,13 @@ co_rc_t co_manager_ioctl(co_manager_t* 		manager,
 		break;
 
 	}
+	case CO_MANAGER_IOCTL_MESSAGE_RING: {
+		co_manager_ioctl_message_ring_t* params = (typeof(params))(io_buffer);
+
+		*return_size = sizeof(*params);
+		params->rc = co_os_manager_userspace_message_ring(manager, opened, params);
+		break;
+	}
 	default:
 		return CO_RC(ERROR);
 	}
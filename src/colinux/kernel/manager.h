@@ -42,11 +42,21 @@ typedef struct co_manager_open_desc {
 	struct co_monitor *monitor;
 
 	co_queue_t out_queue;
+	unsigned long messages_dropped;
+	bool_t throttled;
+	bool_t parked;        /* out_queue reached CO_QUEUE_PARK_LIMIT */
+	co_os_wait_t drained; /* woken when it goes back below the credits */
 
 	co_manager_open_desc_os_t os;
-	co_debug_section_t *debug_section;
 } *co_manager_open_desc_t;
 
+/*
+ * The guest's page tables are not PAE, so it can only reach host pages
+ * below 4GB. Pages for monitors come from there, and the reversed PFN
+ * map covers no more than that, however much RAM the host has.
+ */
+#define CO_HOST_PFN_LIMIT 0x100000
+
 /*
  * The manager module manages the running coLinux systems.
  */
@@ -57,9 +67,11 @@ typedef struct co_manager {
 	unsigned long hostmem_used;
 	unsigned long hostmem_usage_limit;
 	unsigned long hostmem_pages;
+	unsigned long hostmem_pfn_limit;
 
-	co_pfn_t *reversed_map_pfns;
+	struct co_reversed_pfns_page **reversed_map_pages;
 	unsigned long reversed_page_count;
+	unsigned long reversed_pages_used;
 	unsigned long *reversed_map_pgds;
 	unsigned long reversed_map_pgds_count;
 
@@ -87,6 +99,8 @@ extern co_rc_t co_manager_ioctl(co_manager_t *manager, unsigned long ioctl,
 
 extern co_rc_t co_manager_send_eof(co_manager_t *manager, co_manager_open_desc_t opened);
 extern co_rc_t co_manager_send(co_manager_t *manager, co_manager_open_desc_t opened, co_message_t *message);
+extern bool_t co_manager_send_unpark(co_manager_t *manager, co_manager_open_desc_t opened);
+extern void co_manager_reader_drained(co_manager_open_desc_t opened);
 extern co_rc_t co_manager_open(co_manager_t *manager, co_manager_open_desc_t *opened_out);
 extern co_rc_t co_manager_open_ref(co_manager_open_desc_t opened);
 extern co_rc_t co_manager_open_desc_deactive_and_close(co_manager_t *manager, co_manager_open_desc_t opened);
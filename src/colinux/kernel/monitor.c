@@ -34,17 +34,28 @@
 #include "transfer.h"
 #include "filesystem.h"
 #include "pages.h"
+#include "reversedpfns.h"
 #include "pci.h"
 #include "video.h"
+#include "balloon.h"
+#include "switchtrace.h"
 
 #define co_offsetof(TYPE, MEMBER) ((int) &((TYPE *)0)->MEMBER)
 
+/* HZ value of the guest, and rate of the host timer */
+#define CO_MONITOR_HZ			100
+
+/* Longest host sleep for an idle guest, in ticks */
+#define CO_MONITOR_IDLE_MAX_TICKS	(60 * CO_MONITOR_HZ)
+
 co_rc_t co_monitor_malloc(co_monitor_t* cmon, unsigned long bytes, void** ptr)
 {
 	void* block = co_os_malloc(bytes);
 
-	if (block == NULL)
+	if (block == NULL) {
+		cmon->counters.malloc_failed++;
 		return CO_RC(OUT_OF_MEMORY);
+	}
 
 	*ptr = block;
 
@@ -272,6 +283,10 @@ static bool_t device_request(co_monitor_t *cmon, co_device_t device, unsigned lo
 		co_scsi_request(cmon, params[0], params[1]);
 		return PTRUE;
 
+	case CO_DEVICE_BALLOON:
+		co_monitor_balloon_request(cmon, params);
+		return PTRUE;
+
 #ifdef CONFIG_COOPERATIVE_VIDEO
 	case CO_DEVICE_VIDEO:
 		co_video_request(cmon, params[0], params[1]);
@@ -331,15 +346,13 @@ static co_rc_t callback_return_messages(co_monitor_t *cmon)
 
 		if ((unsigned long)message->from >= (unsigned long)CO_MODULES_MAX) {
 			co_debug_system("BUG! %s:%d", __FILE__, __LINE__);
-			co_queue_free(queue, message_item);
-			co_os_free(message);
+			co_message_queue_item_free(queue, message_item);
 			break;
 		}
 
 		if ((unsigned long)message->to >= (unsigned long)CO_MODULES_MAX){
 			co_debug_system("BUG! %s:%d", __FILE__, __LINE__);
-			co_queue_free(queue, message_item);
-			co_os_free(message);
+			co_message_queue_item_free(queue, message_item);
 			break;
 		}
 
@@ -347,20 +360,25 @@ static co_rc_t callback_return_messages(co_monitor_t *cmon)
 		if ((unsigned long)linux_message->device >= (unsigned long)CO_DEVICES_TOTAL){
 			co_debug_system("BUG! %s:%d %d %d", __FILE__, __LINE__,
 					message->to, message->from);
-			co_queue_free(queue, message_item);
-			co_os_free(message);
+			co_message_queue_item_free(queue, message_item);
 			break;
 		}
 
 		cmon->io_buffer->messages_waiting += 1;
-		co_queue_free(queue, message_item);
+		cmon->counters.messages_to_linux[message->from]++;
 		co_memcpy(io_buffer, message, size);
 		io_buffer += size;
-		co_os_free(message);
+		co_message_queue_item_free(queue, message_item);
 	}
 
 	co_os_mutex_release(cmon->linux_message_queue_mutex);
 
+	if (cmon->io_buffer->messages_waiting) {
+		cmon->counters.linux_interrupts++;
+		if (cmon->io_buffer->messages_waiting > cmon->counters.io_buffer_peak)
+			cmon->counters.io_buffer_peak = cmon->io_buffer->messages_waiting;
+	}
+
 	co_passage_page->params[0] = io_buffer - (unsigned char *)&cmon->io_buffer->buffer;
 
 	co_debug_lvl(messages, 12, "sending messages to linux (%ld bytes)", co_passage_page->params[0]);
@@ -377,7 +395,7 @@ static void callback_return_jiffies(co_monitor_t *cmon)
 
 	/* Skip timestamp glitches, see http://support.microsoft.com/kb/274323 */
 	if (timestamp.quad > cmon->timestamp.quad) {
-		diff = cmon->timestamp_reminder + 100 * (timestamp.quad - cmon->timestamp.quad);  /* 100 = HZ value */
+		diff = cmon->timestamp_reminder + CO_MONITOR_HZ * (timestamp.quad - cmon->timestamp.quad);
 		cmon->timestamp_reminder = co_div64_32(&diff, cmon->timestamp_freq.quad);
 		cmon->timestamp		 = timestamp;
 	} else {
@@ -437,11 +455,25 @@ static bool_t co_terminate(co_monitor_t *cmon)
 
 static bool_t co_idle(co_monitor_t *cmon)
 {
-	co_queue_t* queue;
+	co_queue_t* queue = &cmon->linux_message_queue;
+	unsigned long ticks = co_passage_page->params[0];
 
-	co_os_wait_sleep(cmon->idle_wait);
+	if (ticks > 1 && co_queue_size(queue) == 0) {
+		/*
+		 * Nothing for Linux to do before its next timer. Sleep until
+		 * then instead of waking up on every tick. The jiffies that
+		 * passed are given back to it by callback_return_jiffies().
+		 */
+		if (ticks > CO_MONITOR_IDLE_MAX_TICKS)
+			ticks = CO_MONITOR_IDLE_MAX_TICKS;
+
+		co_os_timer_oneshot(cmon->timer, ticks * (1000 / CO_MONITOR_HZ));
+		co_os_wait_sleep(cmon->idle_wait);
+		co_os_timer_activate(cmon->timer);
+	} else {
+		co_os_wait_sleep(cmon->idle_wait);
+	}
 
-	queue = &cmon->linux_message_queue;
 	if (co_queue_size(queue) == 0)
 		return PFALSE;
 	else
@@ -450,34 +482,12 @@ static bool_t co_idle(co_monitor_t *cmon)
 
 static void co_free_pages(co_monitor_t *cmon, vm_ptr_t address, int num_pages)
 {
-	unsigned long scan_address;
-	int j;
-
-	scan_address = address;
-	for (j=0; j < num_pages; j++) {
-		co_monitor_free_and_unmap_page(cmon, scan_address);
-		scan_address += CO_ARCH_PAGE_SIZE;
-	}
+	co_monitor_free_and_unmap_pages(cmon, address, num_pages);
 }
 
 static co_rc_t co_alloc_pages(co_monitor_t *cmon, vm_ptr_t address, int num_pages)
 {
-	unsigned long scan_address;
-	co_rc_t rc = CO_RC(OK);
-	int i;
-
-	scan_address = address;
-	for (i=0; i < num_pages; i++, scan_address += CO_ARCH_PAGE_SIZE) {
-		rc = co_monitor_alloc_and_map_page(cmon, scan_address);
-		if (!CO_OK(rc)) {
-			scan_address = address;
-			for (; i; i--, scan_address += CO_ARCH_PAGE_SIZE)
-				co_monitor_free_and_unmap_page(cmon, scan_address);
-			break;
-		}
-	}
-
-	return rc;
+	return co_monitor_alloc_and_map_pages(cmon, address, num_pages);
 }
 
 /* Send the physical pages of a buffer to the guest */
@@ -538,6 +548,7 @@ static void co_monitor_getpp(co_monitor_t* cmon,
 static co_rc_t co_monitor_filter_linux_message(co_monitor_t *monitor, co_message_t *message)
 {
 	if (message->from == CO_MODULE_LINUX &&
+	    message->type == CO_MESSAGE_TYPE_OTHER &&
 	    message->to >= CO_MODULE_CONET0 &&
 	    message->to <= CO_MODULE_CONET_END) {
 		return co_conet_inject_packet_to_adapter(monitor,
@@ -565,7 +576,17 @@ static void incoming_message(co_monitor_t* cmon, co_message_t* message)
 		// ligong liu, support kernel mode conet, filter for conet message
 		if ( co_monitor_filter_linux_message(cmon, message) != CO_RC_OK )
 			co_manager_send(cmon->manager, opened, message);
-		co_manager_close(cmon->manager, opened);
+
+		/* Keep the reference, run() waits for the reader to drain */
+		co_os_mutex_acquire(cmon->connected_modules_write_lock);
+		if (opened->parked  &&  !cmon->parked_reader) {
+			cmon->parked_reader = opened;
+			opened = NULL;
+		}
+		co_os_mutex_release(cmon->connected_modules_write_lock);
+
+		if (opened)
+			co_manager_close(cmon->manager, opened);
 	}
 
 	switch (message->to) {
@@ -581,14 +602,35 @@ static void incoming_message(co_monitor_t* cmon, co_message_t* message)
 	}
 }
 
+/* Called with linux_message_queue_mutex held, after queuing a message */
+static void linux_message_queued(co_monitor_t *monitor, co_rc_t rc)
+{
+	unsigned long size;
+
+	if (!CO_OK(rc)) {
+		monitor->counters.message_alloc_failed++;
+		return;
+	}
+
+	size = co_queue_size(&monitor->linux_message_queue);
+	if (size > monitor->counters.linux_queue_peak)
+		monitor->counters.linux_queue_peak = size;
+}
+
 /* Copy user message to queue */
 co_rc_t co_monitor_message_from_user(co_monitor_t* monitor, co_message_t *message)
 {
 	co_rc_t rc;
 
+	/* It would never leave the queue, and hold back everything behind it */
+	if (message->size > CO_LINUX_MESSAGE_MAX_SIZE - sizeof(*message))
+		return CO_RC(ERROR);
+
 	if (message->to == CO_MODULE_LINUX) {
 		co_os_mutex_acquire(monitor->linux_message_queue_mutex);
-		rc = co_message_dup_to_queue(message, &monitor->linux_message_queue);
+		rc = co_message_pool_dup_to_queue(&monitor->linux_message_pool, message,
+						  &monitor->linux_message_queue);
+		linux_message_queued(monitor, rc);
 		co_os_mutex_release(monitor->linux_message_queue_mutex);
 		co_os_wait_wakeup(monitor->idle_wait);
 	} else {
@@ -602,9 +644,15 @@ co_rc_t co_monitor_message_from_user_free(co_monitor_t *monitor, co_message_t *m
 {
 	co_rc_t rc;
 
+	if (message->size > CO_LINUX_MESSAGE_MAX_SIZE - sizeof(*message)) {
+		co_os_free(message);
+		return CO_RC(ERROR);
+	}
+
 	if (message->to == CO_MODULE_LINUX) {
 		co_os_mutex_acquire(monitor->linux_message_queue_mutex);
 		rc = co_message_mov_to_queue(message, &monitor->linux_message_queue);
+		linux_message_queued(monitor, rc);
 		co_os_mutex_release(monitor->linux_message_queue_mutex);
 		co_os_wait_wakeup(monitor->idle_wait);
 	} else {
@@ -625,6 +673,8 @@ co_rc_t co_monitor_message_from_user_free(co_monitor_t *monitor, co_message_t *m
 
 static bool_t iteration(co_monitor_t *cmon)
 {
+	bool_t trace = cmon->trace_enabled;
+
 	switch (co_passage_page->operation) {
 	case CO_OPERATION_FORWARD_INTERRUPT:
 	case CO_OPERATION_IDLE:
@@ -633,7 +683,14 @@ static bool_t iteration(co_monitor_t *cmon)
 	}
 
 	co_debug_lvl(context_switch, 14, "switching to linux (%ld)", co_passage_page->operation);
+	if (trace)
+		co_monitor_trace_switch_start(cmon);
 	co_host_switch_wrapper(cmon);
+	if (trace)
+		co_monitor_trace_switch_end(cmon);
+
+	if (co_passage_page->operation < CO_OPERATION_MAX)
+		cmon->counters.switches[co_passage_page->operation]++;
 
 	if (co_passage_page->operation == CO_OPERATION_FORWARD_INTERRUPT)
 		co_monitor_arch_real_hardware_interrupt(cmon);
@@ -682,18 +739,26 @@ static bool_t iteration(co_monitor_t *cmon)
 		co_debug_lvl(context_switch, 14, "switching from linux (CO_OPERATION_MESSAGE_TO_MONITOR)");
 
 		message = (co_message_t *)cmon->io_buffer->buffer;
-		if (message  &&  message->to < CO_MONITOR_MODULES_COUNT)
+		if (message  &&  message->to < CO_MONITOR_MODULES_COUNT) {
+			cmon->counters.messages_from_linux[message->to]++;
 			/* Redirect operation to user level */
 			incoming_message(cmon, message);
+		}
 
 		cmon->io_buffer->messages_waiting = 0;
 
+		/* A reader fell behind, don't run Linux until it caught up */
+		if (cmon->parked_reader)
+			return PFALSE;
+
 		return PTRUE;
 	}
 
 	case CO_OPERATION_DEVICE: {
 		unsigned long device = co_passage_page->params[0];
 		co_debug_lvl(context_switch, 14, "switching from linux (CO_OPERATION_DEVICE)");
+		if (device < CO_DEVICES_TOTAL)
+			cmon->counters.device_requests[device]++;
 		return device_request(cmon, device, &co_passage_page->params[1]);
 	}
 	case CO_OPERATION_GET_TIME: {
@@ -837,6 +902,8 @@ static void free_pseudo_physical_memory(co_monitor_t *monitor)
 		if (!monitor->pp_pfns[i])
 			continue;
 
+		co_manager_clear_reversed_pfns(monitor->manager, monitor->pp_pfns[i], PTRS_PER_PTE);
+
 		for (j=0; j < PTRS_PER_PTE; j++)
 			if (monitor->pp_pfns[i][j] != 0)
 				co_os_put_page(monitor->manager, monitor->pp_pfns[i][j]);
@@ -847,6 +914,14 @@ static void free_pseudo_physical_memory(co_monitor_t *monitor)
 	co_monitor_free(monitor, monitor->pp_pfns);
 	monitor->pp_pfns = NULL;
 
+	/* With mem=lazy the resident pages were charged one by one */
+	if (monitor->config.ram_lazy) {
+		co_os_mutex_acquire(monitor->manager->lock);
+		monitor->manager->hostmem_used -= monitor->resident_pages << CO_ARCH_PAGE_SHIFT;
+		co_os_mutex_release(monitor->manager->lock);
+	}
+	monitor->resident_pages = 0;
+
 	co_debug("done freeing");
 }
 
@@ -1005,6 +1080,40 @@ static co_rc_t start(co_monitor_t *cmon)
 	return CO_RC(OK);
 }
 
+/*
+ * Wait for the reader that a message to userspace parked. Returns PFALSE
+ * if it is still behind, so that Linux doesn't run yet.
+ */
+static bool_t unpark(co_monitor_t *cmon)
+{
+	co_manager_open_desc_t opened;
+	bool_t drained;
+
+	co_os_mutex_acquire(cmon->connected_modules_write_lock);
+	opened = cmon->parked_reader;
+	cmon->parked_reader = NULL;
+	co_os_mutex_release(cmon->connected_modules_write_lock);
+
+	if (!opened)
+		return PTRUE;
+
+	drained = co_manager_send_unpark(cmon->manager, opened);
+
+	if (!drained) {
+		co_os_mutex_acquire(cmon->connected_modules_write_lock);
+		if (!cmon->parked_reader) {
+			cmon->parked_reader = opened;
+			opened = NULL;
+		}
+		co_os_mutex_release(cmon->connected_modules_write_lock);
+	}
+
+	if (opened)
+		co_manager_close(cmon->manager, opened);
+
+	return drained;
+}
+
 static co_rc_t run(co_monitor_t *cmon,
 		   co_monitor_ioctl_run_t *params,
 		   unsigned long out_size,
@@ -1014,6 +1123,10 @@ static co_rc_t run(co_monitor_t *cmon,
 
 	if (cmon->state == CO_MONITOR_STATE_RUNNING) {
 		bool_t ret;
+
+		if (cmon->parked_reader  &&  !unpark(cmon))
+			return CO_RC(OK);
+
 		do {
 			ret = iteration(cmon);
 		} while (ret);
@@ -1086,6 +1199,10 @@ co_rc_t co_monitor_create(co_manager_t*		     manager,
 	if (!CO_OK(rc))
 		goto out_free_shared_page;
 
+	rc = co_message_pool_init(&cmon->linux_message_pool, &cmon->blocks_allocated);
+	if (!CO_OK(rc))
+		goto out_free_shared_page;
+
 	rc = co_monitor_os_init(cmon);
 	if (!CO_OK(rc))
 		goto out_free_linux_message_queue;
@@ -1133,13 +1250,17 @@ co_rc_t co_monitor_create(co_manager_t*		     manager,
 
 	cmon->memory_size <<= 20; /* Megify */
 
-	if (cmon->manager->hostmem_used + cmon->memory_size > cmon->manager->hostmem_usage_limit) {
-		rc			    = CO_RC(HOSTMEM_USE_LIMIT_REACHED);
-		params->actual_memsize_used = cmon->memory_size;
-		goto out_free_os_dep;
-	}
+	if (cmon->config.ram_lazy) {
+		co_debug("lazy RAM, charged as the guest allocates it");
+	} else {
+		if (cmon->manager->hostmem_used + cmon->memory_size > cmon->manager->hostmem_usage_limit) {
+			rc			    = CO_RC(HOSTMEM_USE_LIMIT_REACHED);
+			params->actual_memsize_used = cmon->memory_size;
+			goto out_free_os_dep;
+		}
 
-	cmon->manager->hostmem_used += cmon->memory_size;
+		cmon->manager->hostmem_used += cmon->memory_size;
+	}
 
 	cmon->physical_frames	 = cmon->memory_size >> CO_ARCH_PAGE_SHIFT;
 	cmon->end_physical	 = CO_ARCH_KERNEL_OFFSET + cmon->memory_size;
@@ -1150,7 +1271,7 @@ co_rc_t co_monitor_create(co_manager_t*		     manager,
 		goto out_revert_used_mem;
 	}
 
-        rc = co_os_timer_create(&timer_callback, cmon, 10, &cmon->timer); /* HZ value */
+        rc = co_os_timer_create(&timer_callback, cmon, 1000 / CO_MONITOR_HZ, &cmon->timer);
         if (!CO_OK(rc)) {
                 co_debug_error("error %08x creating host OS timer", (int)rc);
                 goto out_free_pp;
@@ -1183,13 +1304,15 @@ out_free_pp:
 	free_pseudo_physical_memory(cmon);
 
 out_revert_used_mem:
-	cmon->manager->hostmem_used -= cmon->memory_size;
+	if (!cmon->config.ram_lazy)
+		cmon->manager->hostmem_used -= cmon->memory_size;
 
 out_free_os_dep:
 	co_monitor_os_exit(cmon);
 
 out_free_linux_message_queue:
-	co_queue_flush(&cmon->linux_message_queue);
+	co_message_queue_flush(&cmon->linux_message_queue);
+	co_message_pool_free(&cmon->linux_message_pool);
 
 out_free_shared_page:
 	free_shared_page(cmon);
@@ -1223,7 +1346,9 @@ static co_rc_t co_monitor_destroy(co_monitor_t *cmon, bool_t user_context)
 	manager = cmon->manager;
 
 	co_debug("cleaning up");
-	co_debug("before free: %ld blocks", cmon->blocks_allocated);
+	co_debug("before free: %ld blocks (messages: %ld in use, %ld pool hits, %ld misses)",
+		 cmon->blocks_allocated, cmon->linux_message_pool.blocks_in_use,
+		 cmon->linux_message_pool.hits, cmon->linux_message_pool.misses);
 
 	if (cmon->state == CO_MONITOR_STATE_RUNNING ||
 	    cmon->state == CO_MONITOR_STATE_STARTED)
@@ -1242,11 +1367,15 @@ static co_rc_t co_monitor_destroy(co_monitor_t *cmon, bool_t user_context)
 	co_monitor_unregister_video_devices(cmon);
 #endif
 	free_pseudo_physical_memory(cmon);
-	manager->hostmem_used -= cmon->memory_size;
+	co_monitor_balloon_reset(cmon);
+	if (!cmon->config.ram_lazy)
+		manager->hostmem_used -= cmon->memory_size;
+	co_monitor_trace_free(cmon);
 	co_os_free(cmon->io_buffer);
 	free_shared_page(cmon);
 	co_monitor_os_exit(cmon);
-	co_queue_flush(&cmon->linux_message_queue);
+	co_message_queue_flush(&cmon->linux_message_queue);
+	co_message_pool_free(&cmon->linux_message_pool);
         co_os_timer_destroy(cmon->timer);
 	co_os_mutex_destroy(cmon->connected_modules_write_lock);
 	co_os_mutex_destroy(cmon->linux_message_queue_mutex);
@@ -1274,6 +1403,11 @@ static void send_monitor_end_messages(co_monitor_t *cmon)
 		cmon->connected_modules[i] = NULL;
 		co_manager_close(cmon->manager, opened);
 	}
+
+	if (cmon->parked_reader) {
+		co_manager_close(cmon->manager, cmon->parked_reader);
+		cmon->parked_reader = NULL;
+	}
 	co_os_mutex_release(cmon->connected_modules_write_lock);
 }
 
@@ -1316,22 +1450,27 @@ static co_rc_t co_monitor_user_reset(co_monitor_t *monitor)
 
 	monitor->state = CO_MONITOR_STATE_EMPTY;
 
+	/*
+	 * Devices first: closing them waits for the requests in flight,
+	 * which write into guest RAM and queue their completions.
+	 */
+	co_monitor_unregister_and_free_scsi_devices(monitor);
+	co_monitor_unregister_and_free_block_devices(monitor);
+	co_monitor_unregister_filesystems(monitor);
+#ifdef CONFIG_COOPERATIVE_VIDEO
+	co_monitor_unregister_video_devices(monitor);
+#endif
+
 	co_os_mutex_acquire(monitor->linux_message_queue_mutex);
-	co_queue_flush(&monitor->linux_message_queue);
+	co_message_queue_flush(&monitor->linux_message_queue);
 	co_os_mutex_release(monitor->linux_message_queue_mutex);
 
 	free_pseudo_physical_memory(monitor);
+	co_monitor_balloon_reset(monitor);
 	rc = alloc_pp_ram_mapping(monitor);
 	if (!CO_OK(rc))
 		goto out;
 
-	co_monitor_unregister_and_free_scsi_devices(monitor);
-	co_monitor_unregister_and_free_block_devices(monitor);
-	co_monitor_unregister_filesystems(monitor);
-#ifdef CONFIG_COOPERATIVE_VIDEO
-	co_monitor_unregister_video_devices(monitor);
-#endif
-
 	rc = load_configuration(monitor);
 	if (!CO_OK(rc)) {
 		free_pseudo_physical_memory(monitor);
@@ -1363,6 +1502,38 @@ static co_rc_t co_monitor_user_get_state(co_monitor_t* monitor, co_monitor_ioctl
 	return CO_RC(OK);
 }
 
+static co_rc_t co_monitor_user_status(co_monitor_t* monitor, co_monitor_ioctl_status_t* params)
+{
+	params->memory_size	    = monitor->memory_size;
+	params->memory_lazy	    = monitor->config.ram_lazy;
+	params->resident_pages	    = monitor->resident_pages;
+	params->resident_pages_peak = monitor->resident_pages_peak;
+	params->pages_allocated	    = monitor->pages_allocated;
+	params->pages_freed	    = monitor->pages_freed;
+	params->pages_alloc_failed  = monitor->pages_alloc_failed;
+	params->balloon_target	    = monitor->balloon_target;
+	params->balloon_pages	    = monitor->balloon_pages;
+
+	return CO_RC(OK);
+}
+
+static co_rc_t co_monitor_user_counters(co_monitor_t* monitor, co_monitor_ioctl_counters_t* params)
+{
+	co_timestamp_t timestamp, freq;
+
+	co_os_get_timestamp_freq(&timestamp, &freq);
+	params->timestamp = timestamp.quad;
+	params->freq	  = freq.quad;
+
+	co_os_mutex_acquire(monitor->linux_message_queue_mutex);
+	params->linux_queue_size = co_queue_size(&monitor->linux_message_queue);
+	co_os_mutex_release(monitor->linux_message_queue_mutex);
+
+	co_memcpy(&params->counters, &monitor->counters, sizeof(params->counters));
+
+	return CO_RC(OK);
+}
+
 static co_rc_t co_monitor_user_get_console(co_monitor_t*                   monitor,
                                            co_monitor_ioctl_get_console_t* params)
 {
@@ -1457,6 +1628,54 @@ co_rc_t co_monitor_ioctl(co_monitor_t* 		     cmon,
 
 		return co_monitor_user_get_console(cmon, params);
 	}
+	case CO_MONITOR_IOCTL_STATUS: {
+		co_monitor_ioctl_status_t* params;
+
+		if (out_size < sizeof(*params))
+			return CO_RC(ERROR);
+
+		*return_size = sizeof(*params);
+		params       = (typeof(params))(io_buffer);
+
+		return co_monitor_user_status(cmon, params);
+	}
+	case CO_MONITOR_IOCTL_BALLOON: {
+		co_monitor_ioctl_balloon_t* params;
+
+		/* in_size doesn't count the co_manager_ioctl_monitor_t header */
+		if (in_size < sizeof(*params) - sizeof(params->pc)  ||
+		    out_size < sizeof(*params))
+			return CO_RC(ERROR);
+
+		*return_size = sizeof(*params);
+		params       = (typeof(params))(io_buffer);
+
+		params->size_mb = cmon->balloon_pages >> (20 - CO_ARCH_PAGE_SHIFT);
+
+		return co_monitor_balloon_set(cmon, params->target_mb << (20 - CO_ARCH_PAGE_SHIFT));
+	}
+	case CO_MONITOR_IOCTL_TRACE: {
+		co_monitor_ioctl_trace_t* params;
+
+		if (out_size < sizeof(*params))
+			return CO_RC(ERROR);
+
+		*return_size = sizeof(*params);
+		params       = (typeof(params))(io_buffer);
+
+		return co_monitor_trace_ioctl(cmon, params);
+	}
+	case CO_MONITOR_IOCTL_COUNTERS: {
+		co_monitor_ioctl_counters_t* params;
+
+		if (out_size < sizeof(*params))
+			return CO_RC(ERROR);
+
+		*return_size = sizeof(*params);
+		params       = (typeof(params))(io_buffer);
+
+		return co_monitor_user_counters(cmon, params);
+	}
 #ifdef CONFIG_COOPERATIVE_VIDEO
 	case CO_MONITOR_IOCTL_VIDEO_ATTACH: {
 		co_monitor_ioctl_video_t* params;
@@ -102,6 +102,14 @@ typedef struct co_monitor {
 	unsigned long end_physical;     /* In what virtual address the map of the
 					   pseudo physical RAM ends */
 	co_pfn_t** pp_pfns;
+	unsigned long resident_pages;      /* How many of them are backed by host
+					      pages right now */
+	unsigned long resident_pages_peak;
+	unsigned long pages_allocated;     /* Totals since the monitor was created */
+	unsigned long pages_freed;
+	unsigned long pages_alloc_failed;
+	unsigned long balloon_target;      /* Pages the guest was asked to give back */
+	unsigned long balloon_pages;       /* and has given back, as it reports */
 
 	/*
 	 * Dynamic allocations in the host
@@ -131,6 +139,19 @@ typedef struct co_monitor {
 	unsigned long long timestamp_reminder;
 	co_os_wait_t	   idle_wait;
 
+	/*
+	 * World switch trace (CO_MONITOR_IOCTL_TRACE)
+	 */
+	struct co_monitor_trace* trace;
+	bool_t			 trace_enabled;
+
+	/*
+	 * Performance counters (CO_MONITOR_IOCTL_COUNTERS), only ever
+	 * incremented. Readers take them without locks and may see a
+	 * counter in the middle of an update.
+	 */
+	co_monitor_counters_t counters;
+
 	/*
 	 * Video devices
 	*/
@@ -159,8 +180,9 @@ typedef struct co_monitor {
 	/*
 	 * Message passing stuff
 	 */
-	co_queue_t	linux_message_queue;
-	co_os_mutex_t 	linux_message_queue_mutex;
+	co_queue_t	   linux_message_queue;
+	co_os_mutex_t 	   linux_message_queue_mutex;
+	co_message_pool_t  linux_message_pool; /* under linux_message_queue_mutex */
 
 	co_io_buffer_t* 		 io_buffer;
 	co_monitor_user_kernel_shared_t* shared;
@@ -169,6 +191,7 @@ typedef struct co_monitor {
 
 	struct co_manager_open_desc* connected_modules[CO_MONITOR_MODULES_COUNT];
 	co_os_mutex_t 		     connected_modules_write_lock;
+	struct co_manager_open_desc* parked_reader; /* referenced, see co_manager_send() */
 
 	co_console_t* console;
 
@@ -9,37 +9,48 @@
 
 #include <colinux/arch/mmu.h>
 #include <colinux/os/kernel/alloc.h>
+#include <colinux/os/kernel/mutex.h>
 #include <colinux/common/libc.h>
 
 #include "monitor.h"
 #include "pages.h"
 #include "reversedpfns.h"
+#include "balloon.h"
 
 /*
- * co_manager_get_page - allocate a page from the host,
- * return as a PFN (page frame number).
+ * co_manager_get_pages - allocate @count pages from the host,
+ * return as PFNs (page frame numbers).
  */
 
-co_rc_t co_manager_get_page(struct co_manager *manager, co_pfn_t *pfn)
+co_rc_t co_manager_get_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count)
 {
-	co_rc_t rc = CO_RC_OK;
+	unsigned long i;
+	co_rc_t rc;
 
-	rc = co_os_get_page(manager, pfn);
+	rc = co_os_get_pages(manager, pfns, count);
 	if (!CO_OK(rc))
 		return rc;
 
-	if (*pfn >= manager->hostmem_pages) {
-		/* Surprise! We have a bug! */
+	for (i = 0; i < count; i++) {
+		if (pfns[i] >= manager->hostmem_pfn_limit) {
+			/* The host gave us a page the guest can't address */
 
-		co_debug_error("PFN too high! %ld >= %ld",
-			 *pfn, manager->hostmem_pages);
+			co_debug_error("PFN too high! %ld >= %ld",
+				 pfns[i], manager->hostmem_pfn_limit);
 
-		return CO_RC(ERROR);
+			co_os_put_pages(manager, pfns, count);
+			return CO_RC(OUT_OF_MEMORY);
+		}
 	}
 
 	return rc;
 }
 
+co_rc_t co_manager_get_page(struct co_manager *manager, co_pfn_t *pfn)
+{
+	return co_manager_get_pages(manager, pfn, 1);
+}
+
 /*
  * co_monitor_get_pfn - Return the PFN of the physical
  * page mapped at the given guest virtual address.
@@ -334,26 +345,86 @@ co_rc_t co_monitor_copy_region(
 					      copy_region_split_callback);
 }
 
-/**
- * co_monitor_alloc_and_map_page - allocate a page and
- * map in the guest's virtual address space.
+/*
+ * With mem=lazy nothing of the pseudo physical RAM is reserved when
+ * the monitor is created; instead every page the guest faults in is
+ * charged against the host memory usage limit. Running into it fails
+ * CO_OPERATION_ALLOC_PAGES, and the guest shrinks its caches and
+ * retries. Without mem=lazy only pages taken back out of the balloon
+ * are charged again.
  */
-co_rc_t co_monitor_alloc_and_map_page(
-	struct co_monitor *monitor,
-	vm_ptr_t address
-	)
+static co_rc_t charge_pages(co_monitor_t *monitor, unsigned long count)
+{
+	co_manager_t *manager = monitor->manager;
+	unsigned long bytes = count << CO_ARCH_PAGE_SHIFT;
+	co_rc_t rc = CO_RC(OK);
+
+	if (!monitor->config.ram_lazy)
+		return co_monitor_balloon_charge(monitor, count);
+
+	co_os_mutex_acquire(manager->lock);
+	if (manager->hostmem_used + bytes > manager->hostmem_usage_limit)
+		rc = CO_RC(HOSTMEM_USE_LIMIT_REACHED);
+	else
+		manager->hostmem_used += bytes;
+	co_os_mutex_release(manager->lock);
+
+	return rc;
+}
+
+static void uncharge_pages(co_monitor_t *monitor, unsigned long count)
+{
+	co_manager_t *manager = monitor->manager;
+
+	if (!monitor->config.ram_lazy)
+		return;
+
+	co_os_mutex_acquire(manager->lock);
+	manager->hostmem_used -= count << CO_ARCH_PAGE_SHIFT;
+	co_os_mutex_release(manager->lock);
+}
+
+/*
+ * Guest RAM is allocated and freed in batches of up to CO_PAGES_BATCH
+ * pages that don't cross a page table: the host pages come in one call,
+ * the reversed map is updated in one pass and the PTEs are written under
+ * one mapping of the page table.
+ */
+#define CO_PAGES_BATCH 64
+
+static co_pfn_t no_pfns[CO_PAGES_BATCH];
+
+static unsigned long batch_length(vm_ptr_t address, unsigned long count)
+{
+	unsigned long left_in_table;
+
+	left_in_table = PTRS_PER_PTE - ((address >> CO_ARCH_PAGE_SHIFT) % PTRS_PER_PTE);
+	if (count > left_in_table)
+		count = left_in_table;
+	if (count > CO_PAGES_BATCH)
+		count = CO_PAGES_BATCH;
+
+	return count;
+}
+
+static vm_ptr_t pseudo_ram_pte_address(vm_ptr_t address)
 {
+	long virtual_pfn = ((address - CO_ARCH_KERNEL_OFFSET) >> CO_ARCH_PAGE_SHIFT);
+
+	return CO_VPTR_PSEUDO_RAM_PAGE_TABLES + sizeof(linux_pte_t)*virtual_pfn;
+}
+
+static co_rc_t alloc_and_map_batch(struct co_monitor *monitor, vm_ptr_t address, unsigned long count)
+{
+	co_pfn_t new_pfns[CO_PAGES_BATCH];
+	co_pfn_t *pfns;
+	unsigned long current_pfn, pfn_group, i, missing, used;
 	co_rc_t rc;
-	vm_ptr_t pte_address;
-	long virtual_pfn;
-	co_pfn_t physical_pfn;
-	unsigned long current_pfn, pfn_group, pfn_index;
 
-	/* first, allocate the page if needed. */
+	/* first, allocate the pages if needed. */
 
 	current_pfn = (address >> CO_ARCH_PAGE_SHIFT);
 	pfn_group = current_pfn / PTRS_PER_PTE;
-	pfn_index = current_pfn % PTRS_PER_PTE;
 
 	if (monitor->pp_pfns[pfn_group] == NULL) {
 		rc = co_monitor_malloc(monitor, sizeof(co_pfn_t)*PTRS_PER_PTE,
@@ -365,70 +436,170 @@ co_rc_t co_monitor_alloc_and_map_page(
 			  sizeof(co_pfn_t)*PTRS_PER_PTE);
 	}
 
-	physical_pfn = monitor->pp_pfns[pfn_group][pfn_index];
-	if (physical_pfn)
+	pfns = &monitor->pp_pfns[pfn_group][current_pfn % PTRS_PER_PTE];
+
+	missing = 0;
+	for (i = 0; i < count; i++)
+		if (pfns[i] == 0)
+			missing++;
+
+	if (missing == 0)
 		return CO_RC(OK);
 
-	rc = co_manager_get_page(monitor->manager, &physical_pfn);
-	if (!CO_OK(rc))
+	rc = charge_pages(monitor, missing);
+	if (!CO_OK(rc)) {
+		monitor->pages_alloc_failed++;
+		return rc;
+	}
+
+	rc = co_manager_get_pages(monitor->manager, new_pfns, missing);
+	if (!CO_OK(rc)) {
+		uncharge_pages(monitor, missing);
+		monitor->pages_alloc_failed++;
 		return rc;
+	}
 
-	monitor->pp_pfns[pfn_group][pfn_index] = physical_pfn;
+	for (i = 0, used = 0; i < count; i++)
+		if (pfns[i] == 0)
+			pfns[i] = new_pfns[used++];
 
-	/* next, map the page */
-	virtual_pfn = ((address - CO_ARCH_KERNEL_OFFSET) >> CO_ARCH_PAGE_SHIFT);
-	pte_address = CO_VPTR_PSEUDO_RAM_PAGE_TABLES;
-	pte_address += sizeof(linux_pte_t)*virtual_pfn;
+	monitor->pages_allocated += missing;
+	monitor->resident_pages += missing;
+	if (monitor->resident_pages > monitor->resident_pages_peak)
+		monitor->resident_pages_peak = monitor->resident_pages;
 
-	rc = co_manager_set_reversed_pfn(monitor->manager,
-					 physical_pfn, virtual_pfn);
+	/* next, map the pages */
+	rc = co_manager_set_reversed_pfns(monitor->manager, pfns,
+					  (address - CO_ARCH_KERNEL_OFFSET) >> CO_ARCH_PAGE_SHIFT,
+					  count);
 	if (!CO_OK(rc))
 		return rc;
 
 	/*
-	 * pte_address is the virtual address where the PTE
-	 * for this page is located. create the PTE:
+	 * The PTEs for these pages follow each other in the pseudo
+	 * physical RAM page tables, create them in one go:
 	 */
-	rc = co_monitor_create_ptes(monitor, pte_address,
-				    sizeof(linux_pte_t), &physical_pfn);
-	return rc;
+	return co_monitor_create_ptes(monitor, pseudo_ram_pte_address(address),
+				      sizeof(linux_pte_t)*count, pfns);
 }
 
-/**
- * co_monitor_free_and_unmap - free a page and unmap
- * it from the guest's virtual address space.
- */
-
-co_rc_t co_monitor_free_and_unmap_page(
-	struct co_monitor *monitor,
-	vm_ptr_t address
-	)
+static co_rc_t free_and_unmap_batch(struct co_monitor *monitor, vm_ptr_t address, unsigned long count)
 {
-	unsigned long physical_pfn = 0;
-	vm_ptr_t pte_address;
-	long virtual_pfn;
-	unsigned long current_pfn, pfn_group, pfn_index;
+	co_pfn_t freed_pfns[CO_PAGES_BATCH];
+	co_pfn_t *pfns;
+	unsigned long current_pfn, pfn_group, i, freed;
 
 	current_pfn = (address >> CO_ARCH_PAGE_SHIFT);
 	pfn_group = current_pfn / PTRS_PER_PTE;
-	pfn_index = current_pfn % PTRS_PER_PTE;
 
 	if (monitor->pp_pfns[pfn_group] == NULL)
 		return CO_RC(ERROR);
 
-	virtual_pfn = ((address - CO_ARCH_KERNEL_OFFSET) >> CO_ARCH_PAGE_SHIFT);
-	pte_address = CO_VPTR_PSEUDO_RAM_PAGE_TABLES;
-	pte_address += sizeof(linux_pte_t) * virtual_pfn;
+	/* erase the mappings */
+	co_monitor_create_ptes(monitor, pseudo_ram_pte_address(address),
+			       sizeof(linux_pte_t)*count, no_pfns);
+
+	pfns = &monitor->pp_pfns[pfn_group][current_pfn % PTRS_PER_PTE];
+
+	for (i = 0, freed = 0; i < count; i++) {
+		if (pfns[i] != 0) {
+			freed_pfns[freed++] = pfns[i];
+			pfns[i] = 0;
+		}
+	}
+
+	if (freed == 0)
+		return CO_RC(OK);
+
+	co_manager_clear_reversed_pfns(monitor->manager, freed_pfns, freed);
+	co_os_put_pages(monitor->manager, freed_pfns, freed);
+
+	uncharge_pages(monitor, freed);
+	monitor->pages_freed += freed;
+	monitor->resident_pages -= freed;
+
+	return CO_RC(OK);
+}
+
+/**
+ * co_monitor_alloc_and_map_pages - allocate @count pages and
+ * map them in the guest's virtual address space from @address.
+ * On failure the pages before the failing batch are freed again.
+ */
+co_rc_t co_monitor_alloc_and_map_pages(
+	struct co_monitor *monitor,
+	vm_ptr_t address,
+	unsigned long count
+	)
+{
+	vm_ptr_t start = address;
+	unsigned long batch;
+	co_rc_t rc;
+
+	while (count > 0) {
+		batch = batch_length(address, count);
 
-	/* erase the mapping */
-	co_monitor_create_ptes(monitor, pte_address, sizeof(linux_pte_t), &physical_pfn);
+		rc = alloc_and_map_batch(monitor, address, batch);
+		if (!CO_OK(rc)) {
+			co_monitor_free_and_unmap_pages(monitor, start,
+							(address - start) >> CO_ARCH_PAGE_SHIFT);
+			return rc;
+		}
 
-	physical_pfn = monitor->pp_pfns[pfn_group][pfn_index];
-	if (physical_pfn != 0) {
-		co_manager_set_reversed_pfn(monitor->manager, physical_pfn, 0);
-		co_os_put_page(monitor->manager, physical_pfn);
-		monitor->pp_pfns[pfn_group][pfn_index] = 0;
+		address += batch << CO_ARCH_PAGE_SHIFT;
+		count -= batch;
 	}
 
 	return CO_RC(OK);
 }
+
+/**
+ * co_monitor_free_and_unmap_pages - free @count pages and unmap
+ * them from the guest's virtual address space from @address.
+ */
+co_rc_t co_monitor_free_and_unmap_pages(
+	struct co_monitor *monitor,
+	vm_ptr_t address,
+	unsigned long count
+	)
+{
+	unsigned long batch;
+	co_rc_t rc = CO_RC(OK);
+
+	while (count > 0) {
+		batch = batch_length(address, count);
+
+		if (!CO_OK(free_and_unmap_batch(monitor, address, batch)))
+			rc = CO_RC(ERROR);
+
+		address += batch << CO_ARCH_PAGE_SHIFT;
+		count -= batch;
+	}
+
+	return rc;
+}
+
+/**
+ * co_monitor_alloc_and_map_page - allocate a page and
+ * map in the guest's virtual address space.
+ */
+co_rc_t co_monitor_alloc_and_map_page(
+	struct co_monitor *monitor,
+	vm_ptr_t address
+	)
+{
+	return alloc_and_map_batch(monitor, address, 1);
+}
+
+/**
+ * co_monitor_free_and_unmap - free a page and unmap
+ * it from the guest's virtual address space.
+ */
+
+co_rc_t co_monitor_free_and_unmap_page(
+	struct co_monitor *monitor,
+	vm_ptr_t address
+	)
+{
+	return free_and_unmap_batch(monitor, address, 1);
+}
@@ -13,6 +13,7 @@
 #include "manager.h"
 
 extern co_rc_t co_manager_get_page(struct co_manager *manager, co_pfn_t *pfn);
+extern co_rc_t co_manager_get_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count);
 extern co_rc_t co_monitor_get_pfn(co_monitor_t *cmon, vm_ptr_t address, co_pfn_t *pfn);
 
 extern co_rc_t co_monitor_copy_and_create_pfns(
@@ -52,4 +53,16 @@ extern co_rc_t co_monitor_free_and_unmap_page(
 	vm_ptr_t address
 	);
 
+extern co_rc_t co_monitor_alloc_and_map_pages(
+	struct co_monitor *monitor,
+	vm_ptr_t address,
+	unsigned long count
+	);
+
+extern co_rc_t co_monitor_free_and_unmap_pages(
+	struct co_monitor *monitor,
+	vm_ptr_t address,
+	unsigned long count
+	);
+
 #endif
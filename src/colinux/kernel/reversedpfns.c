@@ -18,35 +18,106 @@
 #include "manager.h"
 #include "monitor.h"
 #include "pages.h"
+#include "reversedpfns.h"
+
+/*
+ * The reversed map tells the guest which pseudo physical page a host page
+ * is mapped at. It is one long array at CO_VPTR_PHYSICAL_TO_PSEUDO_PFN_MAP,
+ * shared by all monitors, with one host page of entries for every
+ * PTRS_PER_PTE host PFNs.
+ *
+ * The page tables above those pages are allocated at load, because every
+ * monitor copies their PGD entries when it starts. The pages of entries
+ * themselves are allocated when a monitor first maps a host page in their
+ * range and freed when the last one is unmapped, so a host with a lot of
+ * RAM and no running monitors costs close to nothing.
+ *
+ * A guest only reads the entries of host pages it owns, and it gets a new
+ * one only by switching to the host, which reloads its page tables. So a
+ * page of entries can go away while other guests are running.
+ */
+typedef struct co_reversed_pfns_page {
+	co_pfn_t pfn;
+	unsigned long refs;
+	unsigned long owned[PTRS_PER_PTE / (sizeof(unsigned long) * 8)];
+} co_reversed_pfns_page_t;
+
+#define OWNED_BIT(entry)  (1UL << ((entry) % (sizeof(unsigned long) * 8)))
+#define OWNED_WORD(entry) ((entry) / (sizeof(unsigned long) * 8))
+
+static void set_reversed_pte(co_manager_t *manager, unsigned long top_level, co_pfn_t pfn)
+{
+	co_pfn_t pte_pfn;
+	linux_pte_t *pte;
+
+	pte_pfn = manager->reversed_map_pgds[top_level / PTRS_PER_PTE] >> CO_ARCH_PAGE_SHIFT;
+
+	pte = co_os_map(manager, pte_pfn);
+	if (pfn)
+		pte[top_level % PTRS_PER_PTE] = (pfn << CO_ARCH_PAGE_SHIFT) |
+			(_PAGE_PRESENT | _PAGE_RW | _PAGE_DIRTY | _PAGE_ACCESSED);
+	else
+		pte[top_level % PTRS_PER_PTE] = 0;
+	co_os_unmap(manager, pte, pte_pfn);
+}
+
+static co_reversed_pfns_page_t *get_reversed_page(co_manager_t *manager, unsigned long top_level)
+{
+	co_reversed_pfns_page_t *page;
+	void *mapped;
+	co_rc_t rc;
+
+	page = co_os_malloc(sizeof(*page));
+	if (!page)
+		return NULL;
+
+	co_memset(page, 0, sizeof(*page));
+
+	rc = co_manager_get_page(manager, &page->pfn);
+	if (!CO_OK(rc)) {
+		co_os_free(page);
+		return NULL;
+	}
+
+	mapped = co_os_map(manager, page->pfn);
+	co_memset(mapped, 0, CO_ARCH_PAGE_SIZE);
+	co_os_unmap(manager, mapped, page->pfn);
+
+	set_reversed_pte(manager, top_level, page->pfn);
+	manager->reversed_map_pages[top_level] = page;
+	manager->reversed_pages_used++;
+
+	return page;
+}
+
+static void put_reversed_page(co_manager_t *manager, unsigned long top_level)
+{
+	co_reversed_pfns_page_t *page = manager->reversed_map_pages[top_level];
+
+	set_reversed_pte(manager, top_level, 0);
+	manager->reversed_map_pages[top_level] = NULL;
+	manager->reversed_pages_used--;
+
+	co_os_put_page(manager, page->pfn);
+	co_os_free(page);
+}
 
 co_rc_t co_manager_alloc_reversed_pfns(co_manager_t *manager)
 {
 	unsigned long map_size, covered_physical;
-	unsigned long reversed_page_count;
 	co_rc_t rc = CO_RC(OK);
-	int i, j;
+	int i;
 
 	co_debug("allocating reversed physical mapping");
-	manager->reversed_page_count = manager->hostmem_pages / PTRS_PER_PTE;
-	map_size = sizeof(co_pfn_t) * manager->reversed_page_count;
+	manager->reversed_page_count = manager->hostmem_pfn_limit / PTRS_PER_PTE;
+	map_size = sizeof(co_reversed_pfns_page_t *) * manager->reversed_page_count;
 
 	co_debug("allocating top level pages map (%ld bytes)", map_size);
-	manager->reversed_map_pfns = co_os_malloc(map_size);
-	if (manager->reversed_map_pfns == NULL)
+	manager->reversed_map_pages = co_os_malloc(map_size);
+	if (manager->reversed_map_pages == NULL)
 		return CO_RC(OUT_OF_MEMORY);
 
-	co_memset(manager->reversed_map_pfns, 0, map_size);
-
-	co_debug("allocating %ld top level pages", manager->reversed_page_count);
-	for (i=0; i < manager->reversed_page_count; i++) {
-		co_pfn_t pfn;
-
-		rc = co_manager_get_page(manager, &pfn);
-		if (!CO_OK(rc))
-			return rc;
-
-		manager->reversed_map_pfns[i] = pfn;
-	}
+	co_memset(manager->reversed_map_pages, 0, map_size);
 
 	manager->reversed_map_pgds_count =
 		(((unsigned long)(CO_VPTR_BASE - CO_VPTR_PHYSICAL_TO_PSEUDO_PFN_MAP)
@@ -55,37 +126,27 @@ co_rc_t co_manager_alloc_reversed_pfns(co_manager_t *manager)
 	co_debug("using %ld table entries for reversed physical mapping", manager->reversed_map_pgds_count);
 	manager->reversed_map_pgds = co_os_malloc(manager->reversed_map_pgds_count*sizeof(linux_pgd_t));
 	if (!manager->reversed_map_pgds) {
-		if (!CO_OK(rc)) /* TODO: handle error */
-			return rc;
+		rc = CO_RC(OUT_OF_MEMORY);
+		goto out_error;
 	}
 
+	co_memset(manager->reversed_map_pgds, 0, manager->reversed_map_pgds_count*sizeof(linux_pgd_t));
+
 	covered_physical = 0;
-	reversed_page_count = 0;
 	for (i=0; i < manager->reversed_map_pgds_count; i++) {
 		co_pfn_t pfn;
 		linux_pte_t *pte;
 
-		if (covered_physical >= manager->hostmem_pages) {
-			manager->reversed_map_pgds[i] = 0;
-			continue;
-		}
+		if (covered_physical >= manager->hostmem_pfn_limit)
+			break;
 
 		rc = co_manager_get_page(manager, &pfn);
 		if (!CO_OK(rc))
-			return rc;
+			goto out_error;
 
+		/* No pages of entries yet, see get_reversed_page() */
 		pte = co_os_map(manager, pfn);
-		for (j=0; j < PTRS_PER_PTE; j++) {
-			co_pfn_t rpfn;
-			if (reversed_page_count >= manager->reversed_page_count) {
-				pte[j] = 0;
-				continue;
-			}
-
-			rpfn = manager->reversed_map_pfns[reversed_page_count];
-			pte[j] = (rpfn << CO_ARCH_PAGE_SHIFT) | (_PAGE_PRESENT | _PAGE_RW | _PAGE_DIRTY | _PAGE_ACCESSED);
-			reversed_page_count++;
-		}
+		co_memset(pte, 0, CO_ARCH_PAGE_SIZE);
 		co_os_unmap(manager, pte, pfn);
 
 		manager->reversed_map_pgds[i] = (pfn << CO_ARCH_PAGE_SHIFT) | _KERNPG_TABLE;
@@ -94,17 +155,26 @@ co_rc_t co_manager_alloc_reversed_pfns(co_manager_t *manager)
 	}
 
 	return CO_RC(OK);
+
+out_error:
+	co_manager_free_reversed_pfns(manager);
+	return rc;
 }
 
 void co_manager_free_reversed_pfns(co_manager_t *manager)
 {
 	int i;
 
-	if (manager->reversed_map_pfns) {
-		for (i=0; i < manager->reversed_page_count; i++)
-			co_os_put_page(manager, manager->reversed_map_pfns[i]);
+	if (manager->reversed_map_pages) {
+		for (i=0; i < manager->reversed_page_count; i++) {
+			if (manager->reversed_map_pages[i] != NULL) {
+				co_os_put_page(manager, manager->reversed_map_pages[i]->pfn);
+				co_os_free(manager->reversed_map_pages[i]);
+			}
+		}
 
-		co_os_free(manager->reversed_map_pfns);
+		co_os_free(manager->reversed_map_pages);
+		manager->reversed_map_pages = NULL;
 	}
 
 	if (manager->reversed_map_pgds) {
@@ -115,25 +185,143 @@ void co_manager_free_reversed_pfns(co_manager_t *manager)
 		}
 
 		co_os_free(manager->reversed_map_pgds);
+		manager->reversed_map_pgds = NULL;
 	}
 }
 
+/*
+ * Consecutive host pages mostly share a page of entries, so the bulk
+ * versions below keep the last one mapped until they need another.
+ */
+typedef struct {
+	co_pfn_t pfn;
+	co_pfn_t *entries;
+} co_reversed_mapping_t;
+
+static co_pfn_t *map_reversed_page(co_manager_t *manager, co_reversed_mapping_t *mapping,
+				   co_reversed_pfns_page_t *page)
+{
+	if (mapping->entries  &&  mapping->pfn == page->pfn)
+		return mapping->entries;
+
+	if (mapping->entries)
+		co_os_unmap(manager, mapping->entries, mapping->pfn);
+
+	mapping->pfn = page->pfn;
+	mapping->entries = co_os_map(manager, page->pfn);
+
+	return mapping->entries;
+}
+
+static void unmap_reversed_page(co_manager_t *manager, co_reversed_mapping_t *mapping)
+{
+	if (mapping->entries)
+		co_os_unmap(manager, mapping->entries, mapping->pfn);
+
+	mapping->entries = NULL;
+}
+
+/*
+ * co_manager_set_reversed_pfns - the host pages @real_pfns are mapped
+ * by a monitor at pseudo PFNs @pseudo_pfn onwards.
+ */
+co_rc_t co_manager_set_reversed_pfns(co_manager_t *manager, co_pfn_t *real_pfns,
+				     co_pfn_t pseudo_pfn, unsigned long count)
+{
+	co_reversed_mapping_t mapping = {0, NULL};
+	unsigned long entry, top_level, i;
+	co_reversed_pfns_page_t *page;
+	co_pfn_t *entries;
+	co_rc_t rc = CO_RC(OK);
+
+	co_os_mutex_acquire(manager->lock);
+
+	for (i=0; i < count; i++) {
+		top_level = real_pfns[i] / PTRS_PER_PTE;
+		if (top_level >= manager->reversed_page_count) {
+			rc = CO_RC(ERROR);
+			break;
+		}
+
+		entry = real_pfns[i] % PTRS_PER_PTE;
+
+		page = manager->reversed_map_pages[top_level];
+		if (page == NULL) {
+			page = get_reversed_page(manager, top_level);
+			if (page == NULL) {
+				rc = CO_RC(OUT_OF_MEMORY);
+				break;
+			}
+		}
+
+		entries = map_reversed_page(manager, &mapping, page);
+		entries[entry] = pseudo_pfn + i;
+
+		if (!(page->owned[OWNED_WORD(entry)] & OWNED_BIT(entry))) {
+			page->owned[OWNED_WORD(entry)] |= OWNED_BIT(entry);
+			page->refs++;
+		}
+	}
+
+	unmap_reversed_page(manager, &mapping);
+
+	co_os_mutex_release(manager->lock);
+
+	return rc;
+}
+
 co_rc_t co_manager_set_reversed_pfn(co_manager_t *manager, co_pfn_t real_pfn, co_pfn_t pseudo_pfn)
 {
-	int entry, top_level;
-	co_pfn_t *reversed_pfns;
-	co_pfn_t mapped_pfn;
+	return co_manager_set_reversed_pfns(manager, &real_pfn, pseudo_pfn, 1);
+}
+
+/*
+ * co_manager_clear_reversed_pfns - the host pages @real_pfns are no
+ * longer mapped by a monitor. Zeros, and pages that never had an entry
+ * set, are skipped.
+ */
+void co_manager_clear_reversed_pfns(co_manager_t *manager, co_pfn_t *real_pfns, unsigned long count)
+{
+	co_reversed_mapping_t mapping = {0, NULL};
+	unsigned long entry, top_level, i;
+	co_reversed_pfns_page_t *page;
+	co_pfn_t *entries;
+
+	co_os_mutex_acquire(manager->lock);
 
-	top_level = real_pfn / PTRS_PER_PTE;
-	if (top_level >= manager->reversed_page_count)
-		return CO_RC(ERROR);
+	for (i=0; i < count; i++) {
+		if (real_pfns[i] == 0)
+			continue;
 
-	entry = real_pfn % PTRS_PER_PTE;
+		top_level = real_pfns[i] / PTRS_PER_PTE;
+		if (top_level >= manager->reversed_page_count)
+			continue;
 
-	mapped_pfn = manager->reversed_map_pfns[top_level];
-	reversed_pfns = co_os_map(manager, mapped_pfn);
-	reversed_pfns[entry] = pseudo_pfn;
-	co_os_unmap(manager, reversed_pfns, mapped_pfn);
+		entry = real_pfns[i] % PTRS_PER_PTE;
 
-	return CO_RC(OK);
+		page = manager->reversed_map_pages[top_level];
+		if (page == NULL  ||  !(page->owned[OWNED_WORD(entry)] & OWNED_BIT(entry)))
+			continue;
+
+		page->owned[OWNED_WORD(entry)] &= ~OWNED_BIT(entry);
+
+		if (--page->refs == 0) {
+			if (mapping.entries  &&  mapping.pfn == page->pfn)
+				unmap_reversed_page(manager, &mapping);
+			put_reversed_page(manager, top_level);
+			continue;
+		}
+
+		entries = map_reversed_page(manager, &mapping, page);
+		entries[entry] = 0;
+	}
+
+	unmap_reversed_page(manager, &mapping);
+
+	co_os_mutex_release(manager->lock);
+}
+
+void co_manager_clear_reversed_pfn(co_manager_t *manager, co_pfn_t real_pfn)
+{
+	co_manager_clear_reversed_pfns(manager, &real_pfn, 1);
 }
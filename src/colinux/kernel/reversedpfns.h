@@ -13,6 +13,10 @@
 #include <colinux/arch/manager.h>
 
 extern co_rc_t co_manager_set_reversed_pfn(co_manager_t *manager, co_pfn_t real_pfn, co_pfn_t pseudo_pfn);
+extern void co_manager_clear_reversed_pfn(co_manager_t *manager, co_pfn_t real_pfn);
+extern co_rc_t co_manager_set_reversed_pfns(co_manager_t *manager, co_pfn_t *real_pfns,
+					    co_pfn_t pseudo_pfn, unsigned long count);
+extern void co_manager_clear_reversed_pfns(co_manager_t *manager, co_pfn_t *real_pfns, unsigned long count);
 extern void co_manager_free_reversed_pfns(co_manager_t *manager);
 extern co_rc_t co_manager_alloc_reversed_pfns(co_manager_t *manager);
 
@@ -0,0 +1,183 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+/*
+ * World switch trace: a record per switch to Linux and back, saying
+ * which operation Linux came back with and how long the host took to
+ * serve it. The monitor thread is the only writer and never waits for
+ * readers; it overwrites the oldest records once the ring is full.
+ * Readers (CO_MONITOR_IOCTL_TRACE) check afterwards which of the
+ * records they copied may have been overwritten meanwhile.
+ */
+
+#include <colinux/common/libc.h>
+#include <colinux/os/kernel/alloc.h>
+#include <colinux/os/kernel/mutex.h>
+#include <colinux/os/timer.h>
+
+#include "monitor.h"
+#include "manager.h"
+#include "switchtrace.h"
+
+#define CO_MONITOR_TRACE_RECORDS 4096 /* power of two */
+
+#define co_trace_barrier() __sync_synchronize()
+
+struct co_monitor_trace {
+	volatile unsigned long	  head;        /* records published so far */
+	volatile unsigned long	  generation;  /* bumped when tracing is started */
+	unsigned long		  current_generation;
+	co_monitor_trace_record_t current;     /* switch in progress */
+	co_monitor_trace_record_t records[CO_MONITOR_TRACE_RECORDS];
+};
+
+/* Called right before switching to Linux */
+void co_monitor_trace_switch_start(co_monitor_t *cmon)
+{
+	struct co_monitor_trace *trace = cmon->trace;
+	co_timestamp_t now;
+
+	co_os_get_timestamp(&now);
+
+	/*
+	 * Linux waited for the previous operation until now. Skip it if
+	 * tracing was restarted in between, its service time is bogus.
+	 */
+	if (trace->current_generation == trace->generation) {
+		co_monitor_trace_record_t *record;
+
+		record = &trace->records[trace->head & (CO_MONITOR_TRACE_RECORDS - 1)];
+		*record = trace->current;
+		record->service_time = now.quad - trace->current.switch_end;
+
+		co_trace_barrier();
+		trace->head++;
+	}
+
+	trace->current.switch_start = now.quad;
+	trace->current_generation = trace->generation - 1;
+}
+
+/* Called when Linux switched back to us */
+void co_monitor_trace_switch_end(co_monitor_t *cmon)
+{
+	struct co_monitor_trace *trace = cmon->trace;
+	co_timestamp_t now;
+
+	co_os_get_timestamp(&now);
+
+	trace->current.operation  = co_passage_page->operation;
+	trace->current.device     = 0;
+	if (co_passage_page->operation == CO_OPERATION_DEVICE)
+		trace->current.device = co_passage_page->params[0];
+	trace->current.switch_end = now.quad;
+
+	trace->current_generation = trace->generation;
+}
+
+static co_rc_t trace_enable(co_monitor_t *cmon)
+{
+	struct co_monitor_trace *trace;
+	co_manager_t *manager = cmon->manager;
+
+	/* Allocated once, the monitor thread may be using it from now on */
+	co_os_mutex_acquire(manager->lock);
+	trace = cmon->trace;
+	if (!trace) {
+		trace = co_os_malloc(sizeof(*trace));
+		if (!trace) {
+			co_os_mutex_release(manager->lock);
+			return CO_RC(OUT_OF_MEMORY);
+		}
+
+		co_memset(trace, 0, sizeof(*trace));
+		trace->current_generation = -1;
+
+		co_trace_barrier();
+		cmon->trace = trace;
+	}
+
+	trace->generation++;
+	co_trace_barrier();
+	cmon->trace_enabled = PTRUE;
+	co_os_mutex_release(manager->lock);
+
+	return CO_RC(OK);
+}
+
+co_rc_t co_monitor_trace_ioctl(co_monitor_t *cmon, co_monitor_ioctl_trace_t *params)
+{
+	struct co_monitor_trace *trace;
+	co_timestamp_t now, freq;
+	unsigned long head, first, count, valid;
+	unsigned long i;
+
+	if (params->enable == 0) {
+		cmon->trace_enabled = PFALSE;
+	} else if (params->enable > 0) {
+		co_rc_t rc = trace_enable(cmon);
+		if (!CO_OK(rc))
+			return rc;
+	}
+
+	co_os_get_timestamp_freq(&now, &freq);
+	params->freq  = freq.quad;
+	params->first = params->start;
+	params->count = 0;
+	params->head  = 0;
+
+	trace = cmon->trace;
+	if (!trace)
+		return CO_RC(OK);
+
+	head = trace->head;
+	co_trace_barrier();
+
+	/* Older records are gone, newer ones don't exist yet */
+	first = params->start;
+	if (head - first > CO_MONITOR_TRACE_RECORDS)
+		first = head - CO_MONITOR_TRACE_RECORDS;
+
+	count = head - first;
+	if (count > CO_MONITOR_TRACE_CHUNK)
+		count = CO_MONITOR_TRACE_CHUNK;
+
+	for (i = 0; i < count; i++)
+		params->records[i] = trace->records[(first + i) & (CO_MONITOR_TRACE_RECORDS - 1)];
+
+	co_trace_barrier();
+	head = trace->head;
+
+	/* The slot of record 'head' may be in the middle of a write */
+	valid = head + 1 - CO_MONITOR_TRACE_RECORDS;
+	if ((long)(valid - first) > 0) {
+		unsigned long lost = valid - first;
+
+		if (lost > count)
+			lost = count;
+
+		co_memmove(&params->records[0], &params->records[lost],
+			   (count - lost) * sizeof(params->records[0]));
+		first += lost;
+		count -= lost;
+	}
+
+	params->first = first;
+	params->count = count;
+	params->head  = head;
+
+	return CO_RC(OK);
+}
+
+void co_monitor_trace_free(co_monitor_t *cmon)
+{
+	if (cmon->trace) {
+		co_os_free(cmon->trace);
+		cmon->trace = NULL;
+	}
+}
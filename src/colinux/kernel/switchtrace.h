@@ -0,0 +1,19 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#ifndef __COLINUX_KERNEL_SWITCHTRACE_H__
+#define __COLINUX_KERNEL_SWITCHTRACE_H__
+
+#include "monitor.h"
+
+extern void co_monitor_trace_switch_start(co_monitor_t *cmon);
+extern void co_monitor_trace_switch_end(co_monitor_t *cmon);
+extern co_rc_t co_monitor_trace_ioctl(co_monitor_t *cmon, co_monitor_ioctl_trace_t *params);
+extern void co_monitor_trace_free(co_monitor_t *cmon);
+
+#endif
@@ -110,6 +110,147 @@ co_rc_t co_monitor_host_linuxvm_transfer(
 	return CO_RC(OK);
 }
 
+typedef struct {
+	co_monitor_transfer_vec_t vec;
+	unsigned char *page;
+	co_pfn_t pfn;
+} co_monitor_transfer_chunk_t;
+
+static void transfer_vec_unmap(co_monitor_t *cmon,
+			       co_monitor_transfer_chunk_t *maps,
+			       unsigned long mapped)
+{
+	while (mapped--)
+		co_os_unmap(cmon->manager, maps[mapped].page, maps[mapped].pfn);
+}
+
+/*
+ * Maps the guest memory page by page and calls the host function once
+ * per batch of CO_MONITOR_TRANSFER_VEC_MAX pages. Without 'pages' the
+ * guest memory is the linear buffer at 'vaddr', otherwise 'vaddr' is
+ * the offset in the first of the 'count' guest page frames in 'pages'.
+ */
+static co_rc_t transfer_vec(
+	co_monitor_t *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_func_t host_func,
+	vm_ptr_t vaddr,
+	unsigned long *pages,
+	unsigned long count,
+	unsigned long size,
+	co_monitor_transfer_dir_t dir
+	)
+{
+	co_monitor_transfer_chunk_t maps[CO_MONITOR_TRANSFER_VEC_MAX];
+	co_monitor_transfer_vec_t vec[CO_MONITOR_TRANSFER_VEC_MAX];
+	unsigned long offset = 0;
+	co_rc_t rc;
+
+	while (size > 0) {
+		unsigned long mapped = 0;
+		unsigned long chunks = 0;
+		unsigned long batch = 0;
+
+		while (size > 0  &&  mapped < CO_MONITOR_TRANSFER_VEC_MAX) {
+			co_monitor_transfer_chunk_t *map = &maps[mapped];
+			unsigned long one_copy;
+
+			if (pages) {
+				if (count == 0  ||  *pages >= (cmon->memory_size >> CO_ARCH_PAGE_SHIFT)) {
+					transfer_vec_unmap(cmon, maps, mapped);
+					co_debug_error("monitor: transfer pages: off bounds");
+					return CO_RC(TRANSFER_OFF_BOUNDS);
+				}
+				vaddr += CO_ARCH_KERNEL_OFFSET + (*pages++ << CO_ARCH_PAGE_SHIFT);
+				count--;
+			}
+
+			rc = co_monitor_get_pfn(cmon, vaddr, &map->pfn);
+			if (!CO_OK(rc)) {
+				transfer_vec_unmap(cmon, maps, mapped);
+				return rc;
+			}
+
+			one_copy = ((vaddr + CO_ARCH_PAGE_SIZE) & CO_ARCH_PAGE_MASK) - vaddr;
+			if (one_copy > size)
+				one_copy = size;
+
+			map->page = co_os_map(cmon->manager, map->pfn);
+			map->vec.ptr = map->page + (vaddr & ~CO_ARCH_PAGE_MASK);
+			map->vec.size = one_copy;
+			mapped++;
+
+			/* Merge with the previous chunk, if the host mapping is contiguous */
+			if (chunks > 0  &&
+			    (unsigned char *)vec[chunks-1].ptr + vec[chunks-1].size == map->vec.ptr)
+				vec[chunks-1].size += one_copy;
+			else
+				vec[chunks++] = map->vec;
+
+			batch += one_copy;
+			size -= one_copy;
+			vaddr = pages ? 0 : vaddr + one_copy;
+		}
+
+		rc = host_func(cmon, host_data, vec, chunks, offset, dir);
+		transfer_vec_unmap(cmon, maps, mapped);
+
+		if (!CO_OK(rc))
+			return rc;
+
+		offset += batch;
+	}
+
+	return CO_RC(OK);
+}
+
+/*
+ * Same as co_monitor_host_linuxvm_transfer(), but collects the mapped
+ * pages of the guest buffer and calls the host function once per batch
+ * instead of once per page.
+ */
+
+co_rc_t co_monitor_host_linuxvm_transfer_vec(
+	co_monitor_t *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_func_t host_func,
+	vm_ptr_t vaddr,
+	unsigned long size,
+	co_monitor_transfer_dir_t dir
+	)
+{
+	if ((vaddr < CO_ARCH_KERNEL_OFFSET) || (vaddr >= cmon->end_physical)) {
+		co_debug_error("monitor: transfer vec: off bounds: %p", (void*)vaddr);
+		return CO_RC(TRANSFER_OFF_BOUNDS);
+	}
+
+	if ((vaddr + size < CO_ARCH_KERNEL_OFFSET) || (vaddr + size > cmon->end_physical)) {
+		co_debug_error("monitor: transfer vec: end off bounds: %p", (void*)(vaddr + size));
+		return CO_RC(TRANSFER_OFF_BOUNDS);
+	}
+
+	return transfer_vec(cmon, host_data, host_func, vaddr, NULL, 0, size, dir);
+}
+
+co_rc_t co_monitor_host_linuxvm_transfer_pages(
+	co_monitor_t *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_func_t host_func,
+	unsigned long *pages,
+	unsigned long count,
+	unsigned long offset,
+	unsigned long size,
+	co_monitor_transfer_dir_t dir
+	)
+{
+	if (offset >= CO_ARCH_PAGE_SIZE) {
+		co_debug_error("monitor: transfer pages: bad offset: %ld", offset);
+		return CO_RC(TRANSFER_OFF_BOUNDS);
+	}
+
+	return transfer_vec(cmon, host_data, host_func, offset, pages, count, size, dir);
+}
+
 
 static co_rc_t co_monitor_transfer_memcpy(co_monitor_t *cmon, void *host_data, void *linuxvm,
 					  unsigned long size, co_monitor_transfer_dir_t dir)
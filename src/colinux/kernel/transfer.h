@@ -57,6 +57,59 @@ extern co_rc_t co_monitor_host_linuxvm_transfer(
 	co_monitor_transfer_dir_t dir
 	);
 
+/*
+ * Vectored transfer: The whole guest buffer is mapped page by page into
+ * an array of host chunks and handed over in one call, so the host can
+ * use a single scatter-gather I/O instead of one call per page. Chunks of
+ * neighbouring host mappings are merged. Large buffers are passed in
+ * batches of up to CO_MONITOR_TRANSFER_VEC_MAX chunks.
+ *
+ * offset - Byte offset of the batch from the start of the transfer
+ */
+
+#define CO_MONITOR_TRANSFER_VEC_MAX 32
+
+typedef struct {
+	void *ptr;
+	unsigned long size;
+} co_monitor_transfer_vec_t;
+
+typedef co_rc_t (*co_monitor_transfer_vec_func_t)(
+	struct co_monitor *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_t *vec,
+	unsigned long count,
+	unsigned long offset,
+	co_monitor_transfer_dir_t dir
+	);
+
+extern co_rc_t co_monitor_host_linuxvm_transfer_vec(
+	struct co_monitor *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_func_t host_func,
+	vm_ptr_t vaddr,
+	unsigned long size,
+	co_monitor_transfer_dir_t dir
+	);
+
+/*
+ * Page array transfer: The guest passes the frame numbers of the pages
+ * to transfer instead of one buffer, e.g. a run of its page cache. The
+ * data starts at 'offset' in the first page and continues at the start
+ * of each following page. Batches go to the host function like above.
+ */
+
+extern co_rc_t co_monitor_host_linuxvm_transfer_pages(
+	struct co_monitor *cmon,
+	void *host_data,
+	co_monitor_transfer_vec_func_t host_func,
+	unsigned long *pages,
+	unsigned long count,
+	unsigned long offset,
+	unsigned long size,
+	co_monitor_transfer_dir_t dir
+	);
+
 /*
  * map and unmap splitted
  */
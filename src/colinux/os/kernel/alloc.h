@@ -22,11 +22,15 @@ extern co_rc_t co_os_get_page(struct co_manager *manager, co_pfn_t *pfn);
 extern void *co_os_map(struct co_manager *manager, co_pfn_t pfn);
 extern void co_os_unmap(struct co_manager *manager, void *ptr, co_pfn_t pfn);
 extern void co_os_put_page(struct co_manager *manager, co_pfn_t pfn);
+extern co_rc_t co_os_get_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count);
+extern void co_os_put_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count);
 extern void *co_os_alloc_pages(unsigned int pages);
 extern void co_os_free_pages(void *ptr, unsigned int pages);
 
 /*
- * Interfaces for mapping physical memory in userspace.
+ * Interfaces for mapping physical memory in userspace. The pages are
+ * mapped into the calling process, and co_os_userspace_unmap() removes
+ * them from that process even when called from another one.
  */
 extern co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_address, void **handle);
 extern void co_os_userspace_unmap(void *user_address, void *handle, unsigned int pages);
@@ -12,6 +12,7 @@
 
 #include <colinux/common/common.h>
 #include <colinux/kernel/filesystem.h>
+#include <colinux/kernel/transfer.h>
 
 /*
  * OS-specific pathname helpers.
@@ -24,18 +25,42 @@ extern co_rc_t co_os_fs_dir_inode_to_path(co_filesystem_t *fs, co_inode_t *dir,
 					  char **out_name, char *name);
 
 /*
- * OS-specific operations on files.
+ * OS-specific open files, kept open by cofs between reads and writes.
+ * co_os_fs_file_transfer() is a co_monitor_transfer_vec_func_t with a
+ * co_filesystem_io_t as host data.
  */
-extern co_rc_t co_os_file_read_write(struct co_monitor *linuxvm, char *filename, unsigned long long offset,
-				     unsigned long size, vm_ptr_t src_buffer, bool_t read);
-extern co_rc_t co_os_file_set_attr(char *filename, unsigned long valid, struct fuse_attr *attr);
-extern co_rc_t co_os_file_get_attr(char *filename, struct fuse_attr *attr);
-extern co_rc_t co_os_file_unlink(char *filename);
-extern co_rc_t co_os_file_rmdir(char *filename);
-extern co_rc_t co_os_file_mkdir(char *dirname);
-extern co_rc_t co_os_file_rename(char *filename, char *dest_filename);
+extern co_rc_t co_os_fs_file_open(co_filesystem_t *filesystem, char *filename,
+				  bool_t write, struct co_os_fs_file **file);
+extern void co_os_fs_file_close(struct co_os_fs_file *file);
+extern co_rc_t co_os_fs_file_transfer(struct co_monitor *cmon, void *host_data,
+				      co_monitor_transfer_vec_t *vec, unsigned long count,
+				      unsigned long offset, co_monitor_transfer_dir_t dir);
+
+/*
+ * OS-specific operations on files, with pathnames from the helpers above.
+ * The host must not let them leave the base path of the filesystem.
+ */
+extern co_rc_t co_os_file_set_attr(co_filesystem_t *filesystem, char *filename,
+				   unsigned long valid, struct fuse_attr *attr);
+extern co_rc_t co_os_file_get_attr(co_filesystem_t *filesystem, char *filename, struct fuse_attr *attr);
+extern co_rc_t co_os_file_unlink(co_filesystem_t *filesystem, char *filename);
+extern co_rc_t co_os_file_rmdir(co_filesystem_t *filesystem, char *filename);
+extern co_rc_t co_os_file_mkdir(co_filesystem_t *filesystem, char *dirname);
+extern co_rc_t co_os_file_rename(co_filesystem_t *filesystem, char *filename, char *dest_filename);
 extern co_rc_t co_os_file_mknod(co_filesystem_t *filesystem, char *filename, unsigned long mode);
-extern co_rc_t co_os_file_getdir(char *dirname, co_filesystem_dir_names_t *names);
+extern co_rc_t co_os_file_getdir(co_filesystem_t *filesystem, char *dirname, co_filesystem_dir_names_t *names);
 extern co_rc_t co_os_file_fs_stat(co_filesystem_t *filesystem, struct fuse_statfs_out *statfs);
 
+/*
+ * OS-specific change notification, optional. A watched directory has a
+ * generation count that the host bumps whenever the directory itself or
+ * one of its entries changes. co_os_fs_watch_generation() returns PFALSE
+ * if the watch no longer reports changes.
+ */
+extern co_rc_t co_os_fs_notify_init(co_filesystem_t *filesystem);
+extern void co_os_fs_notify_free(co_filesystem_t *filesystem);
+extern co_rc_t co_os_fs_watch_dir(co_filesystem_t *filesystem, co_inode_t *dir);
+extern void co_os_fs_unwatch_dir(co_filesystem_t *filesystem, co_inode_t *dir);
+extern bool_t co_os_fs_watch_generation(struct co_os_fs_watch *watch, unsigned long *generation);
+
 #endif
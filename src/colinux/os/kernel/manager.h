@@ -10,6 +10,7 @@
 #ifndef __COLINUX_OS_KERNEL_MANAGER_H__
 #define __COLINUX_OS_KERNEL_MANAGER_H__
 
+#include <colinux/common/ioctl.h>
 #include <colinux/kernel/manager.h>
 
 extern co_rc_t co_os_manager_init(co_manager_t *manager, co_osdep_manager_t *osdep);
@@ -30,4 +31,9 @@ extern co_rc_t co_os_manager_userspace_eof(
 	co_manager_t *manager,
 	co_manager_open_desc_t opened);
 
+extern co_rc_t co_os_manager_userspace_message_ring(
+	co_manager_t *manager,
+	co_manager_open_desc_t opened,
+	co_manager_ioctl_message_ring_t *params);
+
 #endif
@@ -16,5 +16,7 @@
 extern unsigned long co_os_virt_to_phys(void *addr);
 extern co_rc_t co_os_physical_memory_pages(unsigned long *pages);
 extern co_id_t co_os_current_id(void);
+extern unsigned int co_os_current_cpu(void);
+extern unsigned int co_os_cpu_count(void);
 
 #endif
@@ -33,7 +33,7 @@ targets['colinux-daemon'] = Target(
         Input('../user/daemon/daemon.o'),
     ] + user_dep,
     tool = Compiler(),
-    mono_options = generate_options('gcc'),
+    mono_options = generate_options('gcc', libs=['pthread']),
 )
 
 targets['colinux-net-daemon'] = Target(
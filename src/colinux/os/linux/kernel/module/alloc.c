@@ -7,6 +7,7 @@
 #include <colinux/os/alloc.h>
 #include <colinux/os/kernel/misc.h>
 #include <asm/mman.h>
+#include <linux/sched.h>
 
 #ifdef DEBUG_CO_KMALLOC
 static int blocks = 0;
@@ -34,15 +35,34 @@ void co_os_free(void *ptr)
 #endif
 }
 
-co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_address_out, void **handle_out)
+/*
+ * The handle of a userspace mapping. It remembers the address space the
+ * pages were mapped into, so that they are unmapped from there even when
+ * the last reference to the file goes away in another process.
+ */
+typedef struct co_os_userspace_mapping {
+	struct file *filp;
+	struct mm_struct *mm;
+} co_os_userspace_mapping_t;
+
+static co_rc_t userspace_map(void *address, unsigned int pages, unsigned long flags,
+			     void **user_address_out, void **handle_out)
 {
+	co_os_userspace_mapping_t *mapping;
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
 	struct file *filp;
 	unsigned long pa;
 	void *result;
 
+	mapping = kmalloc(sizeof(*mapping), GFP_KERNEL);
+	if (!mapping)
+		return CO_RC(OUT_OF_MEMORY);
+
 	filp = filp_open("/dev/kmem", O_RDWR | O_LARGEFILE, 0);
 	if (!filp) {
 		co_debug("error: co_os_userspace_map: open /dev/kmem failed");
+		kfree(mapping);
 		return CO_RC(ERROR);
 	}
 
@@ -50,16 +70,14 @@ co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_addre
 	if (!pa) {
 		co_debug("error: co_os_userspace_map: co_os_virt_to_phys failed");
 		filp_close(filp, NULL);
+		kfree(mapping);
 		return CO_RC(ERROR);
 	}
 
+	down_write(&mm->mmap_sem);
 	result = (void *)do_mmap_pgoff(filp, 0, ((unsigned long)pages) << PAGE_SHIFT,
 					     PROT_EXEC | PROT_READ | PROT_WRITE,
-#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,12)
-					     MAP_SHARED,
-#else
-					     MAP_PRIVATE,
-#endif
+					     flags,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,13)
 					     ((unsigned)__va(pa)) >> PAGE_SHIFT
 #else
@@ -67,23 +85,71 @@ co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_addre
 #endif
 	);
 	if (IS_ERR(result)) {
+		up_write(&mm->mmap_sem);
 		co_debug("error: co_os_userspace_map: do_mmap_pgoff failed (errno %ld)", PTR_ERR(result));
 		filp_close(filp, NULL);
+		kfree(mapping);
 		return CO_RC(ERROR);
 	}
 
+	/*
+	 * The driver frees the pages once it unmapped them from this
+	 * process, so a forked child must not get a copy of the mapping.
+	 */
+	vma = find_vma(mm, (unsigned long)result);
+	if (vma)
+		vma->vm_flags |= VM_DONTCOPY;
+	up_write(&mm->mmap_sem);
+
+	/* Pin the mm_struct, not the address space, see co_os_userspace_unmap() */
+	atomic_inc(&mm->mm_count);
+	mapping->filp = filp;
+	mapping->mm = mm;
+
 	*user_address_out = result;
-	*handle_out = filp;
+	*handle_out = mapping;
 
 	return CO_RC(OK);
 }
 
-void co_os_userspace_unmap(void *user_address, void *handle, unsigned int pages)
+co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_address_out, void **handle_out)
 {
-	struct file *filp = (struct file *)handle;
+#if LINUX_VERSION_CODE == KERNEL_VERSION(2,6,12)
+	return userspace_map(address, pages, MAP_SHARED, user_address_out, handle_out);
+#else
+	return userspace_map(address, pages, MAP_PRIVATE, user_address_out, handle_out);
+#endif
+}
+
+/*
+ * Like co_os_userspace_map(), but userspace writes reach the kernel
+ * pages too. A private mapping of /dev/kmem copies a page on the first
+ * write to it, which is fine for views userspace only reads but not for
+ * rings.
+ */
+co_rc_t co_os_userspace_map_shared(void *address, unsigned int pages, void **user_address_out, void **handle_out)
+{
+	return userspace_map(address, pages, MAP_SHARED, user_address_out, handle_out);
+}
 
-	if (user_address)
-		do_munmap(current->mm, (unsigned long)user_address, ((unsigned long)pages) << PAGE_SHIFT);
+void co_os_userspace_unmap(void *user_address, void *handle, unsigned int pages)
+{
+	co_os_userspace_mapping_t *mapping = (co_os_userspace_mapping_t *)handle;
+	struct mm_struct *mm = mapping->mm;
+
+	/*
+	 * Unmap from the process that mapped the pages, whoever drops the
+	 * last reference. Once that process exited the mapping is gone
+	 * with its address space.
+	 */
+	if (user_address && atomic_inc_not_zero(&mm->mm_users)) {
+		down_write(&mm->mmap_sem);
+		do_munmap(mm, (unsigned long)user_address, ((unsigned long)pages) << PAGE_SHIFT);
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
 
-	filp_close(filp, NULL);
+	mmdrop(mm);
+	filp_close(mapping->filp, NULL);
+	kfree(mapping);
 }
@@ -11,64 +11,83 @@
 
 #include "linux_inc.h"
 
+#include <linux/workqueue.h>
+
+#include <colinux/common/libc.h>
 #include <colinux/kernel/transfer.h>
 #include <colinux/kernel/fileblock.h>
+#include <colinux/kernel/monitor.h>
+
+struct co_os_file_block_sysdep {
+	struct file *filp;
+	struct workqueue_struct *workqueue; /* NULL for sync operation */
+};
 
 typedef struct {
 	loff_t offset;
 	co_monitor_file_block_dev_t *fdev;
 } co_os_transfer_file_block_data_t;
 
+typedef struct {
+	co_message_t message;
+	co_linux_message_t linux_message;
+	co_block_intr_t intr[0];
+} callback_message_t;
+
+typedef struct {
+	struct work_struct work;
+	co_monitor_t *monitor;
+	co_monitor_file_block_dev_t *fdev;
+	callback_message_t *msg;
+	unsigned long count;
+	co_block_request_t descs[0];
+} callback_context_t;
+
+/*
+ * Read or write a whole batch of mapped guest pages with one vectored
+ * file operation.
+ */
 static
 co_rc_t co_os_transfer_file_block(struct co_monitor *cmon,
-				  void *host_data, void *linuxvm, unsigned long size,
+				  void *host_data,
+				  co_monitor_transfer_vec_t *vec,
+				  unsigned long count,
+				  unsigned long offset,
 				  co_monitor_transfer_dir_t dir)
 {
 	co_os_transfer_file_block_data_t *data;
-	co_rc_t rc = CO_RC_OK;
+	struct iovec iov[CO_MONITOR_TRANSFER_VEC_MAX];
+	unsigned long size = 0;
+	unsigned long i;
+	mm_segment_t fs;
+	ssize_t done;
 	struct file *filp;
 
 	data = (co_os_transfer_file_block_data_t *)host_data;
-	filp = (struct file *)(data->fdev->sysdep);
-
-	if (CO_MONITOR_TRANSFER_FROM_HOST == dir) {
-		mm_segment_t fs;
-		size_t size_read;
+	filp = data->fdev->sysdep->filp;
 
-		if (!filp->f_op->read)
-			return CO_RC(ERROR);
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = vec[i].ptr;
+		iov[i].iov_len = vec[i].size;
+		size += vec[i].size;
+	}
 
-		fs = get_fs();
-		set_fs(KERNEL_DS);
-		size_read = filp->f_op->read(filp, linuxvm, size, &data->offset);
-		set_fs(fs);
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (CO_MONITOR_TRANSFER_FROM_HOST == dir)
+		done = vfs_readv(filp, iov, count, &data->offset);
+	else
+		done = vfs_writev(filp, iov, count, &data->offset);
+	set_fs(fs);
 
-		if (size_read != size) {
-			co_debug("co_os_transfer_file_block: read error: %d != %ld",
-				 size_read, size);
-			rc = CO_RC(ERROR);
-		}
-	}
-	else {
-		mm_segment_t fs;
-		size_t size_written;
-
-		if (!filp->f_op->write)
-			return CO_RC(ERROR);
-
-		fs = get_fs();
-		set_fs(KERNEL_DS);
-		size_written = filp->f_op->write(filp, linuxvm, size, &data->offset);
-		set_fs(fs);
-
-		if (size_written != size) {
-			co_debug("co_os_transfer_file_block: write error: %d != %ld",
-				 size_written, size);
-			rc = CO_RC(ERROR);
-		}
+	if (done != size) {
+		co_debug("co_os_transfer_file_block: %s error: %ld != %ld",
+			 (CO_MONITOR_TRANSFER_FROM_HOST == dir) ? "read" : "write",
+			 (long)done, size);
+		return CO_RC(ERROR);
 	}
 
-	return rc;
+	return CO_RC(OK);
 }
 
 static
@@ -83,12 +102,12 @@ co_rc_t co_os_file_block_read(struct co_monitor *linuxvm,
 	data.offset = request->offset;
 	data.fdev = fdev;
 
-	rc = co_monitor_host_linuxvm_transfer(linuxvm,
-					      &data,
-					      co_os_transfer_file_block,
-					      request->address,
-					      (unsigned long)request->size,
-					      CO_MONITOR_TRANSFER_FROM_HOST);
+	rc = co_monitor_host_linuxvm_transfer_vec(linuxvm,
+						  &data,
+						  co_os_transfer_file_block,
+						  request->address,
+						  (unsigned long)request->size,
+						  CO_MONITOR_TRANSFER_FROM_HOST);
 
 	return rc;
 }
@@ -106,12 +125,146 @@ co_rc_t co_os_file_block_write(struct co_monitor *linuxvm,
 	data.offset = request->offset;
 	data.fdev = fdev;
 
-	rc = co_monitor_host_linuxvm_transfer(linuxvm,
-					      &data,
-					      co_os_transfer_file_block,
-					      request->address,
-					      (unsigned long)request->size,
-					      CO_MONITOR_TRANSFER_FROM_LINUX);
+	rc = co_monitor_host_linuxvm_transfer_vec(linuxvm,
+						  &data,
+						  co_os_transfer_file_block,
+						  request->address,
+						  (unsigned long)request->size,
+						  CO_MONITOR_TRANSFER_FROM_LINUX);
+	return rc;
+}
+
+/*
+ * Async operation: The requests are queued to the per device workqueue and
+ * the guest continues immediately. The worker does the host file I/O and
+ * completes all of them with one CO_DEVICE_BLOCK interrupt message, like
+ * the APC callback in the WinNT driver.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,20)
+static void transfer_file_block_work(struct work_struct *work)
+{
+	callback_context_t *context = container_of(work, callback_context_t, work);
+#else
+static void transfer_file_block_work(void *work_data)
+{
+	callback_context_t *context = (callback_context_t *)work_data;
+#endif
+	co_os_transfer_file_block_data_t data;
+	co_block_request_t *desc;
+	unsigned long i;
+	co_rc_t rc;
+
+	data.fdev = context->fdev;
+
+	for (i = 0; i < context->count; i++) {
+		desc = &context->descs[i];
+		data.offset = desc->offset;
+
+		rc = co_monitor_host_linuxvm_transfer_vec(context->monitor,
+							  &data,
+							  co_os_transfer_file_block,
+							  desc->address,
+							  (unsigned long)desc->size,
+							  (desc->type == CO_BLOCK_READ ?
+							   CO_MONITOR_TRANSFER_FROM_HOST :
+							   CO_MONITOR_TRANSFER_FROM_LINUX));
+
+		co_debug_lvl(filesystem, 10, "cobd%d work done size=%ld rc=%x",
+			     context->msg->linux_message.unit,
+			     (unsigned long)desc->size, (int)rc);
+
+		if (CO_OK(rc))
+			context->msg->intr[i].uptodate = 1;
+		else
+			co_debug("cobd%d async %s failed size=%ld rc=%x",
+				 context->msg->linux_message.unit,
+				 desc->type == CO_BLOCK_READ ? "read" : "write",
+				 (unsigned long)desc->size, (int)rc);
+	}
+
+	co_monitor_message_from_user_free(context->monitor, &context->msg->message);
+	co_os_free(context);
+}
+
+static co_rc_t co_os_file_block_async_queue(co_monitor_t *monitor,
+					    co_monitor_file_block_dev_t *fdev,
+					    int unit,
+					    co_block_request_t *descs,
+					    unsigned long count)
+{
+	callback_context_t *context;
+	callback_message_t *msg;
+	unsigned long intr_size = count * sizeof(co_block_intr_t);
+	unsigned long i;
+
+	context = co_os_malloc(sizeof(callback_context_t) + count * sizeof(co_block_request_t));
+	if (!context)
+		return CO_RC(OUT_OF_MEMORY);
+
+	msg = co_os_malloc(sizeof(callback_message_t) + intr_size);
+	if (!msg) {
+		co_os_free(context);
+		return CO_RC(OUT_OF_MEMORY);
+	}
+	co_memset(msg, 0, sizeof(callback_message_t) + intr_size);
+
+	context->monitor = monitor;
+	context->fdev = fdev;
+	context->msg = msg;
+	context->count = count;
+	co_memcpy(context->descs, descs, count * sizeof(co_block_request_t));
+
+	msg->message.from = CO_MODULE_COBD0 + unit;
+	msg->message.to = CO_MODULE_LINUX;
+	msg->message.priority = CO_PRIORITY_DISCARDABLE;
+	msg->message.type = CO_MESSAGE_TYPE_OTHER;
+	msg->message.size = sizeof(callback_message_t) - sizeof(msg->message) + intr_size;
+	msg->linux_message.device = CO_DEVICE_BLOCK;
+	msg->linux_message.unit = unit;
+	msg->linux_message.size = intr_size;
+	for (i = 0; i < count; i++)
+		msg->intr[i].irq_request = descs[i].irq_request;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,20)
+	INIT_WORK(&context->work, transfer_file_block_work);
+#else
+	INIT_WORK(&context->work, transfer_file_block_work, context);
+#endif
+	queue_work(fdev->sysdep->workqueue, &context->work);
+
+	return CO_RC(OK);
+}
+
+static
+co_rc_t co_os_file_block_async_read_write(struct co_monitor *linuxvm,
+					  co_block_dev_t *dev,
+					  co_monitor_file_block_dev_t *fdev,
+					  co_block_request_t *request)
+{
+	request->async = PTRUE;
+	return co_os_file_block_async_queue(linuxvm, fdev, dev->unit, request, 1);
+}
+
+static
+co_rc_t co_os_file_block_async_batch(struct co_monitor *linuxvm,
+				     co_block_dev_t *dev,
+				     co_monitor_file_block_dev_t *fdev,
+				     co_block_request_t *request,
+				     co_block_request_t *descs)
+{
+	co_rc_t rc;
+	unsigned long i;
+
+	rc = co_os_file_block_async_queue(linuxvm, fdev, dev->unit, descs, request->batch_count);
+	if (!CO_OK(rc))
+		return rc;
+
+	for (i = 0; i < request->batch_count; i++)
+		descs[i].rc = CO_BLOCK_REQUEST_RETCODE_OK;
+
+	request->batch_done = request->batch_count;
+	request->async = PTRUE;
+
 	return rc;
 }
 
@@ -148,15 +301,23 @@ co_rc_t co_os_file_block_get_size(co_monitor_file_block_dev_t *fdev, unsigned lo
 static
 co_rc_t co_os_file_block_open(struct co_monitor *linuxvm, co_monitor_file_block_dev_t *fdev)
 {
+	struct co_os_file_block_sysdep *sysdep;
 	struct file *filp;
 	struct inode *inode = NULL;
 	co_rc_t rc = CO_RC(OK);
 
 	co_debug("opening %s", fdev->pathname);
 
+	sysdep = co_os_malloc(sizeof(*sysdep));
+	if (!sysdep)
+		return CO_RC(OUT_OF_MEMORY);
+	co_memset(sysdep, 0, sizeof(*sysdep));
+
 	filp = filp_open(fdev->pathname, O_RDWR | O_LARGEFILE, 0);
-        if (IS_ERR(filp))
-		return CO_RC(ERROR);
+        if (IS_ERR(filp)) {
+		rc = CO_RC(ERROR);
+		goto out_free;
+	}
 
         if (filp->f_dentry)
                 inode = filp->f_dentry->d_inode;
@@ -171,33 +332,66 @@ co_rc_t co_os_file_block_open(struct co_monitor *linuxvm, co_monitor_file_block_
 		goto out;
         }
 
-	fdev->sysdep = (struct co_os_file_block_sysdep *)(filp);
+	sysdep->filp = filp;
+	fdev->sysdep = sysdep;
 	return rc;
 
 out:
 	filp_close(filp, current->files);
+out_free:
+	co_os_free(sysdep);
+	return rc;
+}
+
+static
+co_rc_t co_os_file_block_async_open(struct co_monitor *linuxvm, co_monitor_file_block_dev_t *fdev)
+{
+	co_rc_t rc;
+
+	rc = co_os_file_block_open(linuxvm, fdev);
+	if (!CO_OK(rc))
+		return rc;
+
+	/* Single threaded, keeps the request order per device */
+	fdev->sysdep->workqueue = create_singlethread_workqueue("cobd");
+	if (!fdev->sysdep->workqueue) {
+		co_debug_error("cobd: cannot create workqueue for %s", fdev->pathname);
+		filp_close(fdev->sysdep->filp, current->files);
+		co_os_free(fdev->sysdep);
+		fdev->sysdep = NULL;
+		return CO_RC(OUT_OF_MEMORY);
+	}
+
 	return rc;
 }
 
 static
 co_rc_t co_os_file_block_close(co_monitor_file_block_dev_t *fdev)
 {
-	struct file *filp;
+	struct co_os_file_block_sysdep *sysdep = fdev->sysdep;
 
 	co_debug("closing %s", fdev->pathname);
 
-	filp = (struct file *)(fdev->sysdep);
-	filp_close(filp, NULL);
+	if (sysdep->workqueue) {
+		/* Complete all pending requests before the file goes away */
+		flush_workqueue(sysdep->workqueue);
+		destroy_workqueue(sysdep->workqueue);
+	}
+
+	filp_close(sysdep->filp, NULL);
+	co_os_free(sysdep);
+	fdev->sysdep = NULL;
 
 	return CO_RC(OK);
 }
 
 co_monitor_file_block_operations_t co_os_file_block_async_operations = {
-	.open = co_os_file_block_open,
+	.open = co_os_file_block_async_open,
 	.close = co_os_file_block_close,
-	.read = co_os_file_block_read,
-	.write = co_os_file_block_write,
+	.read = co_os_file_block_async_read_write,
+	.write = co_os_file_block_async_read_write,
 	.get_size = co_os_file_block_get_size,
+	.batch = co_os_file_block_async_batch,
 };
 
 co_monitor_file_block_operations_t co_os_file_block_default_operations = {
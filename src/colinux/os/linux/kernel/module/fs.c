@@ -1,89 +1,1049 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+/*
+ * cofs backend for Linux hosts.
+ *
+ * Everything goes through the host VFS under KERNEL_DS. The pathnames
+ * built by the helpers below are relative to the configured host
+ * directory and are only resolved by fs_walk(), so the guest can't reach
+ * anything outside of it. File data is transferred with vectored reads
+ * and writes straight into the mapped guest pages, on files that cofs
+ * keeps open.
+ */
+
+#include "linux_inc.h"
+
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/statfs.h>
+#include <linux/file.h>
+
+#include <colinux/common/libc.h>
+#include <colinux/os/alloc.h>
+#include <colinux/kernel/transfer.h>
+#include <colinux/kernel/monitor.h>
 #include <colinux/os/kernel/filesystem.h>
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,25)
+#define CO_ND_DENTRY(nd)	((nd)->path.dentry)
+#define CO_ND_MNT(nd)		((nd)->path.mnt)
+#define co_nd_release(nd)	path_put(&(nd)->path)
+#else
+#define CO_ND_DENTRY(nd)	((nd)->dentry)
+#define CO_ND_MNT(nd)		((nd)->mnt)
+#define co_nd_release(nd)	path_release(nd)
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,26)
+#define mnt_want_write(mnt)	0
+#define mnt_drop_write(mnt)	do { } while (0)
+#endif
+
+static co_rc_t errno_to_rc(long err)
+{
+	switch (err) {
+	case 0:
+		return CO_RC(OK);
+	case -ENOENT:
+	case -ENOTDIR:
+		return CO_RC(NOT_FOUND);
+	case -EACCES:
+	case -EPERM:
+	case -EROFS:
+	case -EEXIST:
+	case -ENOTEMPTY:
+		return CO_RC(ACCESS_DENIED);
+	case -EINVAL:
+	case -ENAMETOOLONG:
+		return CO_RC(INVALID_PARAMETER);
+	case -ENOMEM:
+		return CO_RC(OUT_OF_MEMORY);
+	}
+
+	return CO_RC(ERROR);
+}
+
 co_rc_t co_os_fs_inode_to_path(co_filesystem_t *fs, co_inode_t *dir,
 				      char **out_name, int add)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	co_inode_t *dir_scan = dir;
+	const char *subpath;
+	int len;
+	int depth = 0;
+	const int max_depth = 256;
+	char *names[max_depth];
+	char *fullname, *adding;
+	int namelen = add;
+
+	while (dir_scan  &&  dir_scan->name  &&  depth < max_depth) {
+		if (!co_filesystem_name_valid(dir_scan->name))
+			return CO_RC(INVALID_PARAMETER);
+		names[depth++] = dir_scan->name;
+		namelen += co_strlen(dir_scan->name) + 1;
+		dir_scan = dir_scan->parent;
+	}
+
+	/* Don't silently resolve a shorter path */
+	if (dir_scan  &&  dir_scan->name)
+		return CO_RC(INVALID_PARAMETER);
+
+	/* Relative to the configured host directory, see fs_walk() */
+	subpath = fs->base_path + co_strlen(fs->desc->pathname);
+	while (*subpath == '/')
+		subpath++;
+
+	len = co_strlen(subpath);
+	fullname = co_os_malloc(len + namelen + 2);
+	if (!fullname)
+		return CO_RC(OUT_OF_MEMORY);
+
+	co_memcpy(fullname, subpath, len);
+	adding = fullname + len;
+
+	while (depth-- > 0) {
+		if (adding > fullname)
+			*adding++ = '/';
+		len = co_strlen(names[depth]);
+		co_memcpy(adding, names[depth], len);
+		adding += len;
+	}
+
+	/* impl. 'co_os_fs_add_last_component' directly here */
+	if (add > 0) {
+		if (adding > fullname) {
+			*adding++ = '/';
+		}
+	}
+
+	*adding = '\0';
+
+	*out_name = fullname;
+	return CO_RC(OK);
 }
 
 int co_os_fs_add_last_component(co_pathname_t *dirname)
 {
-	/* TODO */
-	return 0;
+	int len;
+
+	len = co_strlen(*dirname);
+	if (len > 0  &&  (*dirname)[len-1] != '/'  && (len + 2) < sizeof(*dirname)) {
+		(*dirname)[len] = '/';
+		(*dirname)[len + 1] = '\0';
+		len++;
+	}
+
+	return len;
 }
 
 co_rc_t co_os_fs_dir_inode_to_path(co_filesystem_t *fs, co_inode_t *dir,
 				   char **out_name, char *name)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	co_rc_t rc;
+	int len;
+
+	if (name && *name) {
+		if (!co_filesystem_name_valid(name))
+			return CO_RC(INVALID_PARAMETER);
+		len = 1+co_strlen(name);
+	} else
+		len = 0;
+
+	rc = co_os_fs_inode_to_path(fs, dir, out_name, len);
+	if (!CO_OK(rc))
+		return rc;
+
+	if (len)
+		co_memcpy(&(*out_name)[co_strlen(*out_name)], name, len);
+
+	return CO_RC(OK);
 }
 
-co_rc_t co_os_file_read_write(struct co_monitor *linuxvm, char *filename,
-			      unsigned long long offset, unsigned long size,
-			      vm_ptr_t src_buffer, bool_t read)
+co_rc_t co_os_fs_dir_join_unix_path(co_pathname_t *dirname, const char *addition)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	int len, total_len;
+
+	len = co_os_fs_add_last_component(dirname);
+	if (*addition == '/')
+		addition++;
+
+	co_snprintf(&(*dirname)[len], sizeof(*dirname) - len, "%s", addition);
+
+	total_len = co_strlen(*dirname);
+	if ((total_len > 1) && (*dirname)[total_len-1] == '/') {
+		(*dirname)[total_len-1] = '\0';
+	}
+
+	return CO_RC(OK);
 }
 
-co_rc_t co_os_file_set_attr(char *filename, unsigned long valid, struct fuse_attr *attr)
+/*
+ * Pathname resolution. The host directory in the configuration is looked
+ * up as usual. Below it, every component of the mount subpath and of the
+ * guest names is looked up with lookup_one_len() in the directory found
+ * so far, so neither "..", nor symbolic links, nor mount points are ever
+ * followed: the result is on the vfsmount of the host directory, under
+ * its dentry. A symbolic link as the last component is returned as is.
+ */
+typedef struct co_fs_path {
+	struct nameidata base;
+	struct dentry *dentry;	/* the result, or its parent for CO_FS_WALK_PARENT */
+	const char *last;	/* last component for CO_FS_WALK_PARENT */
+	int last_len;
+} co_fs_path_t;
+
+#define CO_FS_WALK_PARENT	1
+
+#define CO_FS_PATH_MNT(path)	CO_ND_MNT(&(path)->base)
+
+static int fs_dentry_under(struct dentry *dentry, struct dentry *base)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	struct dentry *scan;
+	unsigned seq;
+	int under;
+
+	/* Like is_subdir(), d_parent changes under a host rename */
+	do {
+		seq = read_seqbegin(&rename_lock);
+		rcu_read_lock();
+		for (scan = dentry; scan != base  &&  !IS_ROOT(scan); scan = scan->d_parent)
+			;
+		under = (scan == base);
+		rcu_read_unlock();
+	} while (read_seqretry(&rename_lock, seq));
+
+	return under;
 }
 
-co_rc_t co_os_file_get_attr(char *filename, struct fuse_attr *attr)
+static int fs_walk(co_filesystem_t *filesystem, const char *filename,
+		   int flags, co_fs_path_t *path)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	struct dentry *dentry, *child;
+	const char *name, *next;
+	int len, err;
+
+	err = path_lookup(filesystem->desc->pathname, LOOKUP_FOLLOW | LOOKUP_DIRECTORY, &path->base);
+	if (err)
+		return err;
+
+	dentry = dget(CO_ND_DENTRY(&path->base));
+	path->last = NULL;
+	path->last_len = 0;
+
+	for (name = filename; *name == '/'; name++)
+		;
+
+	while (*name) {
+		for (next = name; *next  &&  *next != '/'; next++)
+			;
+		len = next - name;
+		while (*next == '/')
+			next++;
+
+		err = -EINVAL;
+		if ((len == 1  &&  name[0] == '.')  ||
+		    (len == 2  &&  name[0] == '.'  &&  name[1] == '.'))
+			goto out_dput;
+
+		if ((flags & CO_FS_WALK_PARENT)  &&  !*next) {
+			path->last = name;
+			path->last_len = len;
+			break;
+		}
+
+		err = -ENOENT;
+		if (!dentry->d_inode)
+			goto out_dput;
+
+		err = -ENOTDIR;
+		if (!S_ISDIR(dentry->d_inode->i_mode))
+			goto out_dput;
+
+		mutex_lock(&dentry->d_inode->i_mutex);
+		child = lookup_one_len(name, dentry, len);
+		mutex_unlock(&dentry->d_inode->i_mutex);
+		dput(dentry);
+
+		if (IS_ERR(child)) {
+			err = PTR_ERR(child);
+			goto out_base;
+		}
+
+		dentry = child;
+		name = next;
+	}
+
+	/* The host directory itself has no parent to change */
+	err = -EINVAL;
+	if ((flags & CO_FS_WALK_PARENT)  &&  !path->last)
+		goto out_dput;
+
+	err = -ENOENT;
+	if (!dentry->d_inode)
+		goto out_dput;
+
+	err = -ENOTDIR;
+	if ((flags & CO_FS_WALK_PARENT)  &&  !S_ISDIR(dentry->d_inode->i_mode))
+		goto out_dput;
+
+	err = -ENOENT;
+	if (!fs_dentry_under(dentry, CO_ND_DENTRY(&path->base)))
+		goto out_dput;
+
+	path->dentry = dentry;
+	return 0;
+
+out_dput:
+	dput(dentry);
+out_base:
+	co_nd_release(&path->base);
+	return err;
 }
 
-co_rc_t co_os_file_unlink(char *filename)
+static void fs_walk_release(co_fs_path_t *path)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	dput(path->dentry);
+	co_nd_release(&path->base);
 }
 
-co_rc_t co_os_file_mkdir(char *dirname)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,29)
+#define co_dentry_open(dentry, mnt, flags)	dentry_open(dentry, mnt, flags, current_cred())
+#else
+#define co_dentry_open(dentry, mnt, flags)	dentry_open(dentry, mnt, flags)
+#endif
+
+/*
+ * Open a walked path. Without the checks of may_open() under our root
+ * credentials, keep at least symbolic links, writes to directories and
+ * immutable or append-only files out.
+ */
+static struct file *fs_open(co_filesystem_t *filesystem, const char *filename, int flags)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	struct inode *inode;
+	co_fs_path_t path;
+	struct file *filp;
+	int err;
+
+	err = fs_walk(filesystem, filename, 0, &path);
+	if (err)
+		return ERR_PTR(err);
+
+	inode = path.dentry->d_inode;
+
+	if (S_ISLNK(inode->i_mode))
+		err = -ELOOP;
+	else if ((flags & O_DIRECTORY)  &&  !S_ISDIR(inode->i_mode))
+		err = -ENOTDIR;
+	else if ((flags & O_ACCMODE) != O_RDONLY  &&  S_ISDIR(inode->i_mode))
+		err = -EISDIR;
+	else if ((flags & O_ACCMODE) != O_RDONLY  &&  (IS_IMMUTABLE(inode)  ||  IS_APPEND(inode)))
+		err = -EPERM;
+
+	if (err) {
+		fs_walk_release(&path);
+		return ERR_PTR(err);
+	}
+
+	/* dentry_open() consumes both references, also when it fails */
+	dget(path.dentry);
+	mntget(CO_FS_PATH_MNT(&path));
+	filp = co_dentry_open(path.dentry, CO_FS_PATH_MNT(&path), flags);
+	fs_walk_release(&path);
+
+	return filp;
 }
 
-co_rc_t co_os_file_rename(char *filename, char *dest_filename)
+struct co_os_fs_file {
+	struct file *filp;
+};
+
+co_rc_t co_os_fs_file_open(co_filesystem_t *filesystem, char *filename,
+			   bool_t write, struct co_os_fs_file **file)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	struct co_os_fs_file *fs_file;
+
+	fs_file = co_os_malloc(sizeof(*fs_file));
+	if (!fs_file)
+		return CO_RC(OUT_OF_MEMORY);
+
+	fs_file->filp = fs_open(filesystem, filename, (write ? O_RDWR : O_RDONLY) | O_LARGEFILE);
+	if (IS_ERR(fs_file->filp)) {
+		long err = PTR_ERR(fs_file->filp);
+
+		co_debug_lvl(filesystem, 5, "error %ld opening '%s'", err, filename);
+		co_os_free(fs_file);
+		return errno_to_rc(err);
+	}
+
+	*file = fs_file;
+	return CO_RC(OK);
+}
+
+void co_os_fs_file_close(struct co_os_fs_file *file)
+{
+	filp_close(file->filp, current->files);
+	co_os_free(file);
+}
+
+co_rc_t co_os_fs_file_transfer(struct co_monitor *cmon,
+			       void *host_data,
+			       co_monitor_transfer_vec_t *vec,
+			       unsigned long count,
+			       unsigned long offset,
+			       co_monitor_transfer_dir_t dir)
+{
+	co_filesystem_io_t *io = (co_filesystem_io_t *)host_data;
+	struct iovec iov[CO_MONITOR_TRANSFER_VEC_MAX];
+	unsigned long size = 0;
+	unsigned long i;
+	mm_segment_t fs;
+	loff_t pos;
+	ssize_t done;
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = vec[i].ptr;
+		iov[i].iov_len = vec[i].size;
+		size += vec[i].size;
+	}
+
+	pos = io->offset + offset;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (CO_MONITOR_TRANSFER_FROM_HOST == dir)
+		done = vfs_readv(io->file->filp, iov, count, &pos);
+	else
+		done = vfs_writev(io->file->filp, iov, count, &pos);
+	set_fs(fs);
+
+	if (done < 0)
+		return errno_to_rc(done);
+
+	io->done += done;
+
+	/* A short read is the end of the file, the guest knows the size */
+	if (CO_MONITOR_TRANSFER_FROM_LINUX == dir  &&  (unsigned long)done != size) {
+		co_debug_lvl(filesystem, 5, "short write: %ld != %ld", (long)done, size);
+		return CO_RC(ERROR);
+	}
+
+	return CO_RC(OK);
+}
+
+co_rc_t co_os_file_set_attr(co_filesystem_t *filesystem, char *filename,
+			    unsigned long valid, struct fuse_attr *attr)
+{
+	co_fs_path_t path;
+	struct inode *inode;
+	struct iattr iattr;
+	int err;
+
+	err = fs_walk(filesystem, filename, 0, &path);
+	if (err)
+		return errno_to_rc(err);
+
+	inode = path.dentry->d_inode;
+
+	co_memset(&iattr, 0, sizeof(iattr));
+	iattr.ia_valid = ATTR_CTIME;
+
+	if (valid & FATTR_MODE) {
+		iattr.ia_valid |= ATTR_MODE;
+		iattr.ia_mode = (attr->mode & S_IALLUGO) | (inode->i_mode & ~S_IALLUGO);
+	}
+
+	if (valid & FATTR_UID) {
+		iattr.ia_valid |= ATTR_UID;
+		iattr.ia_uid = attr->uid;
+	}
+
+	if (valid & FATTR_GID) {
+		iattr.ia_valid |= ATTR_GID;
+		iattr.ia_gid = attr->gid;
+	}
+
+	if (valid & FATTR_UTIME) {
+		iattr.ia_valid |= ATTR_ATIME | ATTR_ATIME_SET | ATTR_MTIME | ATTR_MTIME_SET;
+		iattr.ia_atime.tv_sec = attr->atime;
+		iattr.ia_mtime.tv_sec = attr->mtime;
+	}
+
+	if (valid & FATTR_SIZE) {
+		if (S_ISDIR(inode->i_mode)) {
+			err = -EISDIR;
+			goto out;
+		}
+		if (!S_ISREG(inode->i_mode)) {
+			err = -EINVAL;
+			goto out;
+		}
+		iattr.ia_valid |= ATTR_SIZE | ATTR_MTIME;
+		iattr.ia_size = attr->size;
+	}
+
+	err = mnt_want_write(CO_FS_PATH_MNT(&path));
+	if (err)
+		goto out;
+
+	if (valid & FATTR_SIZE) {
+		err = get_write_access(inode);
+		if (err)
+			goto out_drop;
+	}
+
+	mutex_lock(&inode->i_mutex);
+	err = notify_change(path.dentry, &iattr);
+	mutex_unlock(&inode->i_mutex);
+
+	if (valid & FATTR_SIZE)
+		put_write_access(inode);
+
+out_drop:
+	mnt_drop_write(CO_FS_PATH_MNT(&path));
+out:
+	fs_walk_release(&path);
+
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d setting attributes of '%s'", err, filename);
+
+	return errno_to_rc(err);
+}
+
+/* Like lstat(), a symbolic link at the end is not followed */
+co_rc_t co_os_file_get_attr(co_filesystem_t *filesystem, char *filename, struct fuse_attr *attr)
+{
+	co_fs_path_t path;
+	struct kstat stat;
+	int err;
+
+	err = fs_walk(filesystem, filename, 0, &path);
+	if (!err) {
+		err = vfs_getattr(CO_FS_PATH_MNT(&path), path.dentry, &stat);
+		fs_walk_release(&path);
+	}
+
+	if (err) {
+		co_debug_lvl(filesystem, 10, "error %d stat('%s')", err, filename);
+		return errno_to_rc(err);
+	}
+
+	attr->size = stat.size;
+	attr->mode = stat.mode;
+	attr->nlink = stat.nlink;
+	attr->uid = stat.uid;
+	attr->gid = stat.gid;
+	attr->rdev = 0;
+	attr->_dummy = 0;
+	attr->blocks = stat.blocks;
+	attr->atime = stat.atime.tv_sec;
+	attr->mtime = stat.mtime.tv_sec;
+	attr->ctime = stat.ctime.tv_sec;
+
+	return CO_RC(OK);
+}
+
+/*
+ * Look up the parent of 'filename' and its last component, with the
+ * parent directory locked. On success the caller owns a reference to
+ * the (maybe negative) child dentry and must call unlock_parent().
+ */
+static int lock_parent(co_filesystem_t *filesystem, char *filename,
+		       co_fs_path_t *path, struct dentry **dentry)
+{
+	struct dentry *parent;
+	int err;
+
+	err = fs_walk(filesystem, filename, CO_FS_WALK_PARENT, path);
+	if (err)
+		return err;
+
+	parent = path->dentry;
+	mutex_lock_nested(&parent->d_inode->i_mutex, I_MUTEX_PARENT);
+
+	*dentry = lookup_one_len(path->last, parent, path->last_len);
+	if (IS_ERR(*dentry)) {
+		err = PTR_ERR(*dentry);
+		mutex_unlock(&parent->d_inode->i_mutex);
+		fs_walk_release(path);
+		return err;
+	}
+
+	err = mnt_want_write(CO_FS_PATH_MNT(path));
+	if (err) {
+		dput(*dentry);
+		mutex_unlock(&parent->d_inode->i_mutex);
+		fs_walk_release(path);
+		return err;
+	}
+
+	return 0;
+}
+
+static void unlock_parent(co_fs_path_t *path, struct dentry *dentry)
+{
+	dput(dentry);
+	mnt_drop_write(CO_FS_PATH_MNT(path));
+	mutex_unlock(&path->dentry->d_inode->i_mutex);
+	fs_walk_release(path);
+}
+
+co_rc_t co_os_file_unlink(co_filesystem_t *filesystem, char *filename)
+{
+	co_fs_path_t path;
+	struct dentry *dentry;
+	int err;
+
+	err = lock_parent(filesystem, filename, &path, &dentry);
+	if (err)
+		return errno_to_rc(err);
+
+	if (!dentry->d_inode)
+		err = -ENOENT;
+	else if (S_ISDIR(dentry->d_inode->i_mode))
+		err = -EISDIR;
+	else
+		err = vfs_unlink(path.dentry->d_inode, dentry);
+
+	unlock_parent(&path, dentry);
+
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d unlink('%s')", err, filename);
+
+	return errno_to_rc(err);
+}
+
+co_rc_t co_os_file_rmdir(co_filesystem_t *filesystem, char *filename)
+{
+	co_fs_path_t path;
+	struct dentry *dentry;
+	int err;
+
+	err = lock_parent(filesystem, filename, &path, &dentry);
+	if (err)
+		return errno_to_rc(err);
+
+	if (!dentry->d_inode)
+		err = -ENOENT;
+	else
+		err = vfs_rmdir(path.dentry->d_inode, dentry);
+
+	unlock_parent(&path, dentry);
+
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d rmdir('%s')", err, filename);
+
+	return errno_to_rc(err);
+}
+
+co_rc_t co_os_file_mkdir(co_filesystem_t *filesystem, char *dirname)
+{
+	co_fs_path_t path;
+	struct dentry *dentry;
+	int err;
+
+	err = lock_parent(filesystem, dirname, &path, &dentry);
+	if (err)
+		return errno_to_rc(err);
+
+	if (dentry->d_inode)
+		err = -EEXIST;
+	else
+		err = vfs_mkdir(path.dentry->d_inode, dentry, 0777);
+
+	unlock_parent(&path, dentry);
+
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d mkdir('%s')", err, dirname);
+
+	return errno_to_rc(err);
+}
+
+co_rc_t co_os_file_rename(co_filesystem_t *filesystem, char *filename, char *dest_filename)
+{
+	co_fs_path_t old_path, new_path;
+	struct dentry *old_dir, *new_dir;
+	struct dentry *old_dentry, *new_dentry;
+	struct dentry *trap;
+	int err;
+
+	err = fs_walk(filesystem, filename, CO_FS_WALK_PARENT, &old_path);
+	if (err)
+		goto out;
+
+	err = fs_walk(filesystem, dest_filename, CO_FS_WALK_PARENT, &new_path);
+	if (err)
+		goto out_old;
+
+	err = -EXDEV;
+	if (CO_FS_PATH_MNT(&old_path) != CO_FS_PATH_MNT(&new_path))
+		goto out_new;
+
+	err = mnt_want_write(CO_FS_PATH_MNT(&old_path));
+	if (err)
+		goto out_new;
+
+	old_dir = old_path.dentry;
+	new_dir = new_path.dentry;
+	trap = lock_rename(new_dir, old_dir);
+
+	old_dentry = lookup_one_len(old_path.last, old_dir, old_path.last_len);
+	err = PTR_ERR(old_dentry);
+	if (IS_ERR(old_dentry))
+		goto out_unlock;
+
+	err = -ENOENT;
+	if (!old_dentry->d_inode)
+		goto out_dput_old;
+
+	/* The source must not be an ancestor of the target */
+	err = -EINVAL;
+	if (old_dentry == trap)
+		goto out_dput_old;
+
+	new_dentry = lookup_one_len(new_path.last, new_dir, new_path.last_len);
+	err = PTR_ERR(new_dentry);
+	if (IS_ERR(new_dentry))
+		goto out_dput_old;
+
+	/* The target must not be an ancestor of the source */
+	err = -ENOTEMPTY;
+	if (new_dentry == trap)
+		goto out_dput_new;
+
+	err = vfs_rename(old_dir->d_inode, old_dentry, new_dir->d_inode, new_dentry);
+
+out_dput_new:
+	dput(new_dentry);
+out_dput_old:
+	dput(old_dentry);
+out_unlock:
+	unlock_rename(new_dir, old_dir);
+	mnt_drop_write(CO_FS_PATH_MNT(&old_path));
+out_new:
+	fs_walk_release(&new_path);
+out_old:
+	fs_walk_release(&old_path);
+out:
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d rename('%s', '%s')", err, filename, dest_filename);
+
+	return errno_to_rc(err);
 }
 
 co_rc_t co_os_file_mknod(co_filesystem_t *filesystem, char *filename, unsigned long mode)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	co_fs_path_t path;
+	struct dentry *dentry;
+	int err;
+
+	if (filesystem->flags & COFS_MOUNT_NOATTRIB)
+		mode = 0666;
+
+	err = lock_parent(filesystem, filename, &path, &dentry);
+	if (err)
+		return errno_to_rc(err);
+
+	if (dentry->d_inode)
+		err = -EEXIST;
+	else
+		err = vfs_create(path.dentry->d_inode, dentry, mode & S_IALLUGO, NULL);
+
+	unlock_parent(&path, dentry);
+
+	if (err)
+		co_debug_lvl(filesystem, 5, "error %d creating '%s'", err, filename);
+
+	return errno_to_rc(err);
 }
 
-co_rc_t co_os_file_getdir(char *dirname, co_filesystem_dir_names_t *names)
+typedef struct {
+	co_filesystem_dir_names_t *names;
+	co_rc_t rc;
+} getdir_data_t;
+
+static unsigned char dt_to_fuse_type(unsigned int d_type)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	switch (d_type) {
+	case DT_FIFO: return FUSE_DT_FIFO;
+	case DT_CHR:  return FUSE_DT_CHR;
+	case DT_DIR:  return FUSE_DT_DIR;
+	case DT_BLK:  return FUSE_DT_BLK;
+	case DT_REG:  return FUSE_DT_REG;
+	case DT_LNK:  return FUSE_DT_LNK;
+	case DT_SOCK: return FUSE_DT_SOCK;
+	}
+
+	return FUSE_DT_UNKNOWN;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,19)
+static int getdir_filldir(void *buf, const char *name, int namelen,
+			  loff_t offset, u64 ino, unsigned int d_type)
+#else
+static int getdir_filldir(void *buf, const char *name, int namelen,
+			  loff_t offset, ino_t ino, unsigned int d_type)
+#endif
+{
+	getdir_data_t *data = (getdir_data_t *)buf;
+	co_filesystem_name_t *new_name;
+
+	new_name = co_os_malloc(namelen + sizeof(co_filesystem_name_t) + 1);
+	if (!new_name) {
+		data->rc = CO_RC(OUT_OF_MEMORY);
+		return -ENOMEM;
+	}
+
+	new_name->type = dt_to_fuse_type(d_type);
+	co_memcpy(new_name->name, name, namelen);
+	new_name->name[namelen] = '\0';
+
+	co_list_add_tail(&new_name->node, &data->names->list);
+
+	return 0;
+}
+
+co_rc_t co_os_file_getdir(co_filesystem_t *filesystem, char *dirname, co_filesystem_dir_names_t *names)
+{
+	struct file *filp;
+	getdir_data_t data;
+	int err;
+
+	co_list_init(&names->list);
+
+	co_debug_lvl(filesystem, 10, "listing of '%s'", dirname);
+
+	filp = fs_open(filesystem, dirname, O_RDONLY | O_DIRECTORY | O_LARGEFILE);
+	if (IS_ERR(filp)) {
+		co_debug_lvl(filesystem, 5, "error %ld opening directory '%s'", PTR_ERR(filp), dirname);
+		return errno_to_rc(PTR_ERR(filp));
+	}
+
+	data.names = names;
+	data.rc = CO_RC(OK);
+
+	/* vfs_readdir() returns after each buffer full, go on until EOF */
+	do {
+		loff_t pos = filp->f_pos;
+
+		err = vfs_readdir(filp, getdir_filldir, &data);
+		if (err < 0  ||  !CO_OK(data.rc))
+			break;
+		if (filp->f_pos == pos)
+			break;
+	} while (1);
+
+	filp_close(filp, current->files);
+
+	if (CO_OK(data.rc)  &&  err < 0)
+		data.rc = errno_to_rc(err);
+
+	if (!CO_OK(data.rc))
+		co_filesystem_getdir_free(names);
+
+	return data.rc;
 }
 
 co_rc_t co_os_file_fs_stat(co_filesystem_t *filesystem, struct fuse_statfs_out *statfs)
 {
-	/* TODO */
-	return CO_RC(ERROR);
+	struct nameidata nd;
+	struct kstatfs st;
+	int err;
+
+	err = path_lookup(filesystem->base_path, LOOKUP_FOLLOW, &nd);
+	if (err)
+		return errno_to_rc(err);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+	err = vfs_statfs(&nd.path, &st);
+#else
+	err = vfs_statfs(CO_ND_DENTRY(&nd), &st);
+#endif
+	co_nd_release(&nd);
+
+	if (err)
+		return errno_to_rc(err);
+
+	statfs->st.block_size = st.f_bsize;
+	statfs->st.blocks = st.f_blocks;
+	statfs->st.blocks_free = st.f_bavail;
+	statfs->st.files = st.f_files;
+	statfs->st.files_free = st.f_ffree;
+	statfs->st.namelen = st.f_namelen;
+
+	return CO_RC(OK);
+}
+
+/*
+ * Change notification for the attribute cache, with the in-kernel
+ * inotify interface. The event handler runs in the context of whoever
+ * changed the file, so it only bumps the generation count of the watch.
+ */
+#if defined(CONFIG_INOTIFY) && LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,18)
+
+#include <linux/inotify.h>
+
+#define CO_FS_WATCH_MASK (IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE | \
+			  IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)
+
+struct co_os_fs_notify {
+	struct inotify_handle *handle;
+};
+
+struct co_os_fs_watch {
+	struct inotify_watch iwatch;
+	atomic_t generation;
+	int dead;
+};
+
+static void co_fs_watch_event(struct inotify_watch *iwatch, u32 wd, u32 mask,
+			      u32 cookie, const char *name, struct inode *inode)
+{
+	struct co_os_fs_watch *watch = container_of(iwatch, struct co_os_fs_watch, iwatch);
+
+	if (mask & IN_IGNORED)
+		watch->dead = 1;
+
+	atomic_inc(&watch->generation);
 }
 
-co_rc_t co_os_file_rmdir(char *filename)
+static void co_fs_watch_destroy(struct inotify_watch *iwatch)
+{
+	co_os_free(container_of(iwatch, struct co_os_fs_watch, iwatch));
+}
+
+static const struct inotify_operations co_fs_watch_ops = {
+	.handle_event	= co_fs_watch_event,
+	.destroy_watch	= co_fs_watch_destroy,
+};
+
+co_rc_t co_os_fs_notify_init(co_filesystem_t *filesystem)
+{
+	struct co_os_fs_notify *notify;
+
+	notify = co_os_malloc(sizeof(*notify));
+	if (!notify)
+		return CO_RC(OUT_OF_MEMORY);
+
+	notify->handle = inotify_init(&co_fs_watch_ops);
+	if (IS_ERR(notify->handle)) {
+		co_debug("cofs: no change notification (%ld)", PTR_ERR(notify->handle));
+		co_os_free(notify);
+		return CO_RC(ERROR);
+	}
+
+	filesystem->notify = notify;
+
+	return CO_RC(OK);
+}
+
+/* All directories must be unwatched by now */
+void co_os_fs_notify_free(co_filesystem_t *filesystem)
+{
+	inotify_destroy(filesystem->notify->handle);
+	co_os_free(filesystem->notify);
+	filesystem->notify = NULL;
+}
+
+co_rc_t co_os_fs_watch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
+{
+	struct co_os_fs_watch *watch;
+	co_fs_path_t path;
+	char *dirname;
+	co_rc_t rc;
+	s32 wd;
+	int err;
+
+	rc = co_os_fs_inode_to_path(filesystem, dir, &dirname, 0);
+	if (!CO_OK(rc))
+		return rc;
+
+	err = fs_walk(filesystem, dirname, 0, &path);
+	co_os_free(dirname);
+	if (err)
+		return errno_to_rc(err);
+
+	if (!S_ISDIR(path.dentry->d_inode->i_mode)) {
+		fs_walk_release(&path);
+		return CO_RC(NOT_FOUND);
+	}
+
+	watch = co_os_malloc(sizeof(*watch));
+	if (!watch) {
+		fs_walk_release(&path);
+		return CO_RC(OUT_OF_MEMORY);
+	}
+
+	inotify_init_watch(&watch->iwatch);
+	atomic_set(&watch->generation, 0);
+	watch->dead = 0;
+
+	wd = inotify_add_watch(filesystem->notify->handle, &watch->iwatch,
+			       path.dentry->d_inode, CO_FS_WATCH_MASK);
+	fs_walk_release(&path);
+
+	if (wd < 0) {
+		/* Also fails if the host directory is watched already */
+		co_os_free(watch);
+		return errno_to_rc(wd);
+	}
+
+	/* Our own reference, the watch outlives its removal by inotify */
+	get_inotify_watch(&watch->iwatch);
+	dir->watch = watch;
+
+	return CO_RC(OK);
+}
+
+void co_os_fs_unwatch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
+{
+	struct co_os_fs_watch *watch = dir->watch;
+
+	/* Does nothing if inotify removed the watch already */
+	inotify_rm_watch(filesystem->notify->handle, &watch->iwatch);
+
+	put_inotify_watch(&watch->iwatch);
+	dir->watch = NULL;
+}
+
+bool_t co_os_fs_watch_generation(struct co_os_fs_watch *watch, unsigned long *generation)
+{
+	if (watch->dead)
+		return PFALSE;
+
+	*generation = atomic_read(&watch->generation);
+
+	return PTRUE;
+}
+
+#else
+
+co_rc_t co_os_fs_notify_init(co_filesystem_t *filesystem)
 {
-	/* TODO */
 	return CO_RC(ERROR);
 }
 
-co_rc_t co_os_fs_dir_join_unix_path(co_pathname_t *dirname, const char *addition)
+void co_os_fs_notify_free(co_filesystem_t *filesystem)
+{
+}
+
+co_rc_t co_os_fs_watch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
 {
-	/* TODO */
 	return CO_RC(ERROR);
 }
+
+void co_os_fs_unwatch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
+{
+	dir->watch = NULL;
+}
+
+bool_t co_os_fs_watch_generation(struct co_os_fs_watch *watch, unsigned long *generation)
+{
+	return PFALSE;
+}
+
+#endif
@@ -158,12 +158,10 @@ ssize_t co_os_manager_read(struct file *file, char __user *buffer, size_t size,
 		if (!CO_OK(rc))
 			break;
 
-		co_queue_free(queue, message_item);
-
 		ret = copy_to_user(io_buffer, message, size);
+		co_message_queue_item_free(queue, message_item);
 		if (ret) {
 			ret = -EFAULT;
-			co_os_free(message);
 			break;
 		} else {
 			ret = 0 ;
@@ -171,9 +169,9 @@ ssize_t co_os_manager_read(struct file *file, char __user *buffer, size_t size,
 
 		copied += size;
 		io_buffer += size;
-		co_os_free(message);
 	}
 
+	co_manager_reader_drained(opened);
 
 	co_os_mutex_release(opened->lock);
 
@@ -185,6 +183,34 @@ ssize_t co_os_manager_read(struct file *file, char __user *buffer, size_t size,
 	return ret;
 }
 
+/*
+ * Hand everything the daemon has put into its tx ring over to the
+ * monitor. Messages are copied out before they are validated any
+ * further, since userspace can keep writing to the ring meanwhile.
+ */
+static
+void co_os_manager_drain_tx_ring(co_manager_open_desc_t opened)
+{
+	co_message_ring_t *ring = opened->os->tx_ring;
+	co_message_t *message;
+	unsigned long size;
+
+	co_os_mutex_acquire(opened->os->tx_lock);
+
+	while ((message = co_message_ring_peek(ring, &size)) != NULL) {
+		co_message_t *kblock = kmalloc(size, GFP_KERNEL);
+		if (kblock) {
+			memcpy(kblock, message, size);
+			kblock->size = size - sizeof(*kblock);
+			co_monitor_message_from_user_free(opened->monitor, kblock);
+		}
+
+		co_message_ring_pop(ring, message, size);
+	}
+
+	co_os_mutex_release(opened->os->tx_lock);
+}
+
 static
 ssize_t co_os_manager_write(struct file *file, const char __user *buffer, size_t size, loff_t *poffset)
 {
@@ -205,6 +231,12 @@ ssize_t co_os_manager_write(struct file *file, const char __user *buffer, size_t
 	if (!opened->monitor)
 		return -EIO;
 
+	/* An empty write kicks the tx ring, see co_os_reactor_monitor_create() */
+	if (size == 0  &&  opened->os->tx_ring) {
+		co_os_manager_drain_tx_ring(opened);
+		return 0;
+	}
+
 	scan_buffer = buffer;
 	size_left = size;
 	position = 0;
@@ -254,7 +286,7 @@ unsigned int co_os_manager_poll(struct file *file, struct poll_table_struct *pol
 
         poll_wait(file, &opened->os->waitq, pollts);
 
-        if (size)
+        if (size || (opened->os->rx_ring && !co_message_ring_empty(opened->os->rx_ring)))
                 mask |= POLLIN | POLLRDNORM;
 
 	if (!opened->active)
@@ -270,6 +302,8 @@ int co_os_manager_release(struct inode *inode, struct file *file)
 	co_manager_open_desc_t opened = (typeof(opened))(file->private_data);
 
 	if (opened) {
+		struct co_manager_open_desc_os *os = opened->os;
+
 		co_manager_open_desc_deactive_and_close(co_global_manager, opened);
 		file->private_data = NULL;
 	}
@@ -347,18 +381,97 @@ co_rc_t co_os_manager_userspace_open(co_manager_open_desc_t opened)
 
 void co_os_manager_userspace_close(co_manager_open_desc_t opened)
 {
-	wake_up_interruptible(&opened->os->waitq);
+	struct co_manager_open_desc_os *os = opened->os;
+
+	wake_up_interruptible(&os->waitq);
+
+	/*
+	 * The rings are mapped in the process that asked for them only,
+	 * forks don't inherit the mapping. Once it is gone from there no
+	 * one can reach the pages from userspace anymore.
+	 */
+	if (os->rx_ring) {
+		co_os_userspace_unmap(os->ring_user_address, os->ring_handle,
+				      CO_MESSAGE_RING_MAP_PAGES);
+		co_os_mutex_destroy(os->tx_lock);
+		co_os_free_pages(os->rx_ring, CO_MESSAGE_RING_MAP_PAGES);
+		os->rx_ring = NULL;
+		os->tx_ring = NULL;
+	}
 }
 
+/*
+ * Called with opened->lock held. Messages go into the rx ring only
+ * while nothing older is waiting in out_queue, so that the daemon,
+ * which drains the ring before read()ing, sees them in order.
+ */
 bool_t co_os_manager_userspace_try_send_direct(
 	co_manager_t *manager,
 	co_manager_open_desc_t opened,
 	co_message_t *message)
 {
+	co_message_ring_t *ring = opened->os->rx_ring;
+
+	if (ring  &&  co_queue_size(&opened->out_queue) == 0) {
+		unsigned long size = message->size + sizeof(*message);
+		co_message_t *slot;
+
+		slot = co_message_ring_reserve(ring, size);
+		if (slot) {
+			memcpy(slot, message, size);
+			if (co_message_ring_commit(ring, slot))
+				wake_up_interruptible(&opened->os->waitq);
+			return PTRUE;
+		}
+	}
+
 	wake_up_interruptible(&opened->os->waitq);
 	return PFALSE;
 }
 
+co_rc_t co_os_manager_userspace_message_ring(co_manager_t *manager,
+					     co_manager_open_desc_t opened,
+					     co_manager_ioctl_message_ring_t *params)
+{
+	struct co_manager_open_desc_os *os = opened->os;
+	unsigned char *pages;
+	co_rc_t rc;
+
+	if (os->rx_ring)
+		return CO_RC(ERROR);
+
+	pages = co_os_alloc_pages(CO_MESSAGE_RING_MAP_PAGES);
+	if (!pages)
+		return CO_RC(OUT_OF_MEMORY);
+
+	co_message_ring_init((co_message_ring_t *)pages);
+	co_message_ring_init((co_message_ring_t *)(pages + CO_MESSAGE_RING_BYTES));
+
+	rc = co_os_mutex_create(&os->tx_lock);
+	if (!CO_OK(rc)) {
+		co_os_free_pages(pages, CO_MESSAGE_RING_MAP_PAGES);
+		return rc;
+	}
+
+	rc = co_os_userspace_map_shared(pages, CO_MESSAGE_RING_MAP_PAGES,
+					&os->ring_user_address, &os->ring_handle);
+	if (!CO_OK(rc)) {
+		co_os_mutex_destroy(os->tx_lock);
+		co_os_free_pages(pages, CO_MESSAGE_RING_MAP_PAGES);
+		return rc;
+	}
+
+	params->rx_user_address = os->ring_user_address;
+	params->tx_user_address = (unsigned char *)os->ring_user_address + CO_MESSAGE_RING_BYTES;
+
+	co_os_mutex_acquire(opened->lock);
+	os->tx_ring = (co_message_ring_t *)(pages + CO_MESSAGE_RING_BYTES);
+	os->rx_ring = (co_message_ring_t *)pages;
+	co_os_mutex_release(opened->lock);
+
+	return CO_RC(OK);
+}
+
 co_rc_t co_os_manager_userspace_eof(co_manager_t *manager, co_manager_open_desc_t opened)
 {
 	wake_up_interruptible(&opened->os->waitq);
@@ -13,7 +13,9 @@
 
 #include <linux/proc_fs.h>
 #include <colinux/os/alloc.h>
+#include <colinux/os/kernel/alloc.h>
 #include <colinux/common/messages.h>
+#include <colinux/common/ring.h>
 #include <colinux/kernel/manager.h>
 #include <colinux/kernel/monitor.h>
 
@@ -26,6 +28,17 @@ extern co_manager_t *global_manager;
 
 struct co_manager_open_desc_os {
         wait_queue_head_t waitq;
+
+	/* CO_MANAGER_IOCTL_MESSAGE_RING, both rings in one mapping */
+	co_message_ring_t *rx_ring;
+	co_message_ring_t *tx_ring;
+	co_os_mutex_t tx_lock;
+	void *ring_user_address;
+	void *ring_handle;
 };
 
+#define CO_MESSAGE_RING_MAP_PAGES ((2 * CO_MESSAGE_RING_BYTES) >> PAGE_SHIFT)
+
+extern co_rc_t co_os_userspace_map_shared(void *address, unsigned int pages, void **user_address, void **handle);
+
 #endif
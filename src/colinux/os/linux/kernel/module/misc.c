@@ -17,6 +17,17 @@ unsigned long co_os_virt_to_phys(void *addr)
 	return virt_to_phys(addr);
 }
 
+/* A hint only, the caller may be moved to another CPU right after */
+unsigned int co_os_current_cpu(void)
+{
+	return raw_smp_processor_id();
+}
+
+unsigned int co_os_cpu_count(void)
+{
+	return num_possible_cpus();
+}
+
 co_rc_t co_os_physical_memory_pages(unsigned long *pages)
 {
 	*pages = num_physpages;
@@ -19,7 +19,7 @@ co_rc_t co_os_get_page(struct co_manager *manager, co_pfn_t *pfn)
 {
         struct page *page;
 
-	/* alloc and zero the page */
+	/* alloc and zero the page, lowmem is always below CO_HOST_PFN_LIMIT */
         page = alloc_pages(GFP_KERNEL | __GFP_REPEAT | __GFP_ZERO, 0);
         if (!page)
                 return CO_RC(ERROR);
@@ -44,6 +44,30 @@ void co_os_put_page(struct co_manager *manager, co_pfn_t pfn)
 	__free_page(pfn_to_page(pfn));
 }
 
+co_rc_t co_os_get_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count)
+{
+	unsigned long i;
+	co_rc_t rc;
+
+	for (i = 0; i < count; i++) {
+		rc = co_os_get_page(manager, &pfns[i]);
+		if (!CO_OK(rc)) {
+			co_os_put_pages(manager, pfns, i);
+			return rc;
+		}
+	}
+
+	return CO_RC(OK);
+}
+
+void co_os_put_pages(struct co_manager *manager, co_pfn_t *pfns, unsigned long count)
+{
+	unsigned long i;
+
+	for (i = 0; i < count; i++)
+		__free_page(pfn_to_page(pfns[i]));
+}
+
 void *co_os_alloc_pages(unsigned int pages)
 {
 	return (void *)__get_free_pages(GFP_KERNEL, get_order(pages << PAGE_SHIFT));
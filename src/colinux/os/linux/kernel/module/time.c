@@ -37,6 +37,23 @@ void co_os_get_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq)
 		freq->quad = 1000000;
 }
 
+void co_os_get_monotonic_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq)
+{
+	struct timespec ts;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,39)
+	get_monotonic_boottime(&ts); /* counts host suspend too */
+#else
+	ktime_get_ts(&ts);
+#endif
+
+	dts->quad = ts.tv_sec;
+	dts->quad *= 1000000000;
+	dts->quad += ts.tv_nsec;
+	if (freq)
+		freq->quad = 1000000000;
+}
+
 unsigned long co_os_get_cpu_khz(void)
 {
 	return cpu_khz;
@@ -16,6 +16,7 @@
 struct co_os_timer {
 	struct timer_list timer;
 	long msec;
+	int oneshot;
 	co_os_func_t func;
 	void *data;
 };
@@ -24,8 +25,8 @@ static void os_timer(unsigned long data)
 {
 	struct co_os_timer *t = (struct co_os_timer *)data;
 	t->func(t->data);
-	t->timer.expires = jiffies + (t->msec+HZ-1)/HZ;
-	add_timer((struct timer_list *)&t->timer);
+	if (!t->oneshot)
+		mod_timer(&t->timer, jiffies + msecs_to_jiffies(t->msec));
 }
 
 co_rc_t co_os_timer_create(co_os_func_t func, void *data,
@@ -40,9 +41,10 @@ co_rc_t co_os_timer_create(co_os_func_t func, void *data,
 	init_timer(&t->timer);
 
 	t->timer.data = (unsigned long)t;
-	t->timer.expires = jiffies + (msec+HZ-1)/HZ;
+	t->timer.expires = jiffies + msecs_to_jiffies(msec);
 	t->timer.function = os_timer;
 	t->msec = msec;
+	t->oneshot = 0;
 	t->func = func;
 	t->data = data;
 
@@ -53,7 +55,15 @@ co_rc_t co_os_timer_create(co_os_func_t func, void *data,
 
 co_rc_t co_os_timer_activate(co_os_timer_t timer)
 {
-	add_timer((struct timer_list *)timer);
+	timer->oneshot = 0;
+	mod_timer(&timer->timer, jiffies + msecs_to_jiffies(timer->msec));
+	return CO_RC(OK);
+}
+
+co_rc_t co_os_timer_oneshot(co_os_timer_t timer, long msec)
+{
+	timer->oneshot = 1;
+	mod_timer(&timer->timer, jiffies + msecs_to_jiffies(msec));
 	return CO_RC(OK);
 }
 
@@ -15,6 +15,7 @@
 
 struct co_os_wait {
 	wait_queue_head_t head;
+	int pending;
 };
 
 co_rc_t co_os_wait_create(co_os_wait_t *wait_out)
@@ -29,6 +30,7 @@ co_rc_t co_os_wait_create(co_os_wait_t *wait_out)
 		return CO_RC(OUT_OF_MEMORY);
 
 	init_waitqueue_head(&wait->head);
+	wait->pending = 0;
 
 	*wait_out = wait;
 
@@ -40,12 +42,16 @@ void co_os_wait_sleep(co_os_wait_t wait)
 	DEFINE_WAIT(wait_one);
 
 	prepare_to_wait(&wait->head, &wait_one, TASK_INTERRUPTIBLE);
-	schedule();
+	if (!wait->pending)
+		schedule();
 	finish_wait(&wait->head, &wait_one);
+	wait->pending = 0;
 }
 
+/* Like a Windows event, a wakeup without a sleeper is kept for the next sleep */
 void co_os_wait_wakeup(co_os_wait_t wait)
 {
+	wait->pending = 1;
 	wake_up_interruptible_all(&wait->head);
 }
 
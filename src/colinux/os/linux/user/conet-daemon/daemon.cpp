@@ -14,11 +14,14 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 
 #include "daemon.h"
 
 extern "C" {
+#include <colinux/common/messages.h>
 #include "tap.h"
 }
 
@@ -26,16 +29,28 @@ COLINUX_DEFINE_MODULE("colinux-net-daemon");
 
 user_network_tap_daemon_t::user_network_tap_daemon_t()
 {
-	tap_handle = NULL;
+	unsigned int queue;
+
+	for (queue = 0; queue < CO_CONET_TAP_MAX_QUEUES; queue++)
+		tap_handles[queue] = NULL;
+
 	tap_name_specified = PFALSE;
+	tap_queues_specified = PFALSE;
+	tap_queues = 1;
+	tap_vnet_hdr = PFALSE;
+	guest_offload = PFALSE;
+	frames_dropped = 0;
+	frames_unsent = 0;
 }
 
 user_network_tap_daemon_t::~user_network_tap_daemon_t()
 {
-	if (!tap_handle)
-		return;
+	unsigned int queue;
 
-	co_linux_reactor_packet_user_destroy(tap_handle);
+	for (queue = 0; queue < CO_CONET_TAP_MAX_QUEUES; queue++) {
+		if (tap_handles[queue])
+			co_linux_reactor_packet_user_destroy(tap_handles[queue]);
+	}
 }
 
 co_module_t user_network_tap_daemon_t::get_base_module()
@@ -58,7 +73,7 @@ const char *user_network_tap_daemon_t::get_daemon_title()
 	return "Cooperative Linux TAP network daemon";
 }
 
-int tap_alloc(char *dev)
+int tap_alloc(char *dev, int flags)
 {
 	int fd;
 	int ret;
@@ -66,7 +81,7 @@ int tap_alloc(char *dev)
 	if ((fd = open("/dev/net/tun", O_RDWR)) < 0)
 		return -1;
 
-	ret = tap_set_name(fd, dev);
+	ret = tap_set_name(fd, dev, flags);
 	if (ret < 0) {
 		close(fd);
 		return ret;
@@ -83,9 +98,15 @@ static co_rc_t tap_receive(co_reactor_user_t user, unsigned char *buffer, unsign
 	return CO_RC(OK);
 }
 
+static co_rc_t tap_read(co_reactor_user_t user)
+{
+	return tap_daemon->read_from_tap((co_linux_reactor_packet_user_t)user);
+}
+
 void user_network_tap_daemon_t::prepare_for_loop()
 {
-	int tap_fd;
+	unsigned int queue;
+	int tap_fd, flags;
 	co_rc_t rc;
 
 	tap_daemon = this;
@@ -96,19 +117,106 @@ void user_network_tap_daemon_t::prepare_for_loop()
 
 	log("creating network %s\n", tap_name);
 
-	tap_fd = tap_alloc(tap_name);
-	if (tap_fd < 0) {
-		log("error opening TAP\n");
-		throw user_daemon_exception_t(CO_RC(ERROR));
+	flags = TAP_FLAG_VNET_HDR;
+	if (tap_queues > 1)
+		flags |= TAP_FLAG_MULTI_QUEUE;
+
+	for (queue = 0; queue < tap_queues; queue++) {
+		tap_fd = tap_alloc(tap_name, flags);
+		if (tap_fd < 0  &&  queue == 0  &&  tap_queues == 1) {
+			/* Hosts without vnet headers get plain frames */
+			flags &= ~TAP_FLAG_VNET_HDR;
+			tap_fd = tap_alloc(tap_name, flags);
+		}
+
+		if (tap_fd < 0) {
+			log("error opening TAP queue %d\n", queue);
+			throw user_daemon_exception_t(CO_RC(ERROR));
+		}
+
+		rc = co_linux_reactor_packet_user_create(reactor, tap_fd, tap_receive,
+							 &tap_handles[queue]);
+		if (!CO_OK(rc)) {
+			close(tap_fd);
+			throw user_daemon_exception_t(CO_RC(ERROR));
+		}
+
+		/* Frames are read in place into messages, see read_from_tap() */
+		tap_handles[queue]->os_user.read = tap_read;
 	}
 
-	log("TAP interface %s created\n", tap_name);
+	tap_vnet_hdr = (flags & TAP_FLAG_VNET_HDR) ? PTRUE : PFALSE;
 
-	rc = co_linux_reactor_packet_user_create(reactor, tap_fd, tap_receive, &tap_handle);
-	if (!CO_OK(rc)) {
-		close(tap_fd);
-		throw user_daemon_exception_t(CO_RC(ERROR));
+	log("TAP interface %s created (%d queues%s)\n", tap_name, tap_queues,
+	    tap_vnet_hdr ? ", vnet headers" : "");
+}
+
+/*
+ * Read every pending frame straight behind its message headers in the
+ * daemon's send batch, and pass them all to the monitor with one send.
+ *
+ * Once the guest takes offloaded frames, the vnet header is read along
+ * and passed as the start of a CO_MESSAGE_TYPE_NETWORK_OFFLOAD message.
+ * Before that the host sends complete frames, and the header is dropped.
+ */
+co_rc_t user_network_tap_daemon_t::read_from_tap(co_linux_reactor_packet_user_t tap_handle)
+{
+	co_network_hdr_t hdr;
+	struct iovec iov[2];
+	unsigned char *data;
+	int size;
+	co_rc_t rc = CO_RC(OK);
+
+	while (1) {
+		if (guest_offload) {
+			data = get_send_slot(CO_DEVICE_NETWORK, CO_CONET_TAP_MAX_FRAME + sizeof(hdr),
+					     CO_MESSAGE_TYPE_NETWORK_OFFLOAD);
+			if (!data) {
+				rc = CO_RC(ERROR);
+				break;
+			}
+
+			size = read(tap_handle->os_user.fd, data, CO_CONET_TAP_MAX_FRAME + sizeof(hdr));
+		} else {
+			data = get_send_slot(CO_DEVICE_NETWORK, CO_CONET_TAP_MAX_FRAME);
+			if (!data) {
+				rc = CO_RC(ERROR);
+				break;
+			}
+
+			iov[0].iov_base = &hdr;
+			iov[0].iov_len = tap_vnet_hdr ? sizeof(hdr) : 0;
+			iov[1].iov_base = data;
+			iov[1].iov_len = CO_CONET_TAP_MAX_FRAME;
+
+			size = readv(tap_handle->os_user.fd, iov, 2);
+			if (size > 0)
+				size -= iov[0].iov_len;
+		}
+
+		if (size > 0) {
+			/* Must fit the guest's I/O buffer, or it would stall the queue */
+			if (size > CO_LINUX_MESSAGE_MAX_SIZE - sizeof(user_daemon_message_t)) {
+				if (frames_dropped++ == 0)
+					log("dropping frames too large for the guest (%d bytes)\n", size);
+				continue;
+			}
+
+			commit_send_slot(size);
+			continue;
+		}
+
+		if (size < 0  &&  errno == EINTR)
+			continue;
+
+		if (size == 0  ||  errno != EAGAIN)
+			rc = CO_RC(ERROR);
+		break;
 	}
+
+	flush_send_slots();
+
+	return rc;
 }
 
 void user_network_tap_daemon_t::received_from_tap(unsigned char *buffer, unsigned long size)
@@ -116,9 +224,108 @@ void user_network_tap_daemon_t::received_from_tap(unsigned char *buffer, unsigne
 	send_to_monitor_raw(CO_DEVICE_NETWORK, buffer, size);
 }
 
+/*
+ * Frames of one flow go out on the same TAP queue, so that the host
+ * sees them in order. IPv4 frames are hashed by their addresses and
+ * ports, anything else by its MAC addresses.
+ */
+static unsigned int frame_flow_hash(unsigned char *buffer, unsigned long size)
+{
+	unsigned long start = 0, end = 12, i;
+	unsigned int hash = 0;
+
+	if (size >= 38  &&  buffer[12] == 0x08  &&  buffer[13] == 0x00) {
+		start = 26;
+		end = 38;
+	} else if (size < end) {
+		return 0;
+	}
+
+	for (i = start; i < end; i++)
+		hash = hash * 31 + buffer[i];
+
+	return hash;
+}
+
+/*
+ * The guest's frames are always complete, so a vnet header in front of
+ * them is all zeros. Frames for a full TAP are dropped, like on a wire.
+ */
+void user_network_tap_daemon_t::write_to_tap(unsigned char *buffer, unsigned long size)
+{
+	co_linux_reactor_packet_user_t tap_handle;
+	co_network_hdr_t hdr;
+	struct iovec iov[2];
+	co_rc_t rc;
+	int written;
+
+	tap_handle = tap_handles[frame_flow_hash(buffer, size) % tap_queues];
+
+	if (!tap_vnet_hdr) {
+		rc = tap_handle->user.send(&tap_handle->user, buffer, size);
+		if (!CO_OK(rc)  &&  frames_unsent++ == 0)
+			log("dropping frames the TAP has no room for\n");
+		return;
+	}
+
+	co_memset(&hdr, 0, sizeof(hdr));
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = buffer;
+	iov[1].iov_len = size;
+
+	do {
+		written = writev(tap_handle->os_user.fd, iov, 2);
+	} while (written < 0  &&  errno == EINTR);
+
+	if (written == (int)(sizeof(hdr) + size))
+		return;
+
+	if (written < 0  &&  errno == EAGAIN) {
+		if (frames_unsent++ == 0)
+			log("dropping frames the TAP has no room for\n");
+		return;
+	}
+
+	frames_unsent++;
+	if (written < 0)
+		log("TAP write failed (errno %d)\n", errno);
+	else
+		log("TAP wrote %d of %lu bytes\n", written, sizeof(hdr) + size);
+}
+
+void user_network_tap_daemon_t::received_features(co_network_features_t *features)
+{
+	if (!tap_vnet_hdr  ||  guest_offload)
+		return;
+
+	if (!(features->features & CO_NETWORK_FEATURE_RX_OFFLOAD))
+		return;
+
+	if (tap_set_offload(tap_handles[0]->os_user.fd) < 0) {
+		log("TAP interface %s has no offloads\n", tap_name);
+		return;
+	}
+
+	/* Applies to every queue; frames read from now on may be offloaded */
+	guest_offload = PTRUE;
+
+	log("checksum and segmentation offload enabled on %s\n", tap_name);
+}
+
 void user_network_tap_daemon_t::received_from_monitor(co_message_t *message)
 {
-	tap_handle->user.send(&tap_handle->user, (unsigned char *)message->data, message->size);
+	switch (message->type) {
+	case CO_MESSAGE_TYPE_STRING:
+		if (message->size >= sizeof(co_network_features_t))
+			received_features((co_network_features_t *)message->data);
+		break;
+	case CO_MESSAGE_TYPE_OTHER:
+		write_to_tap(message->data, message->size);
+		break;
+	default:
+		break;
+	}
 }
 
 void user_network_tap_daemon_t::handle_extended_parameters(co_command_line_params_t cmdline)
@@ -132,12 +339,21 @@ void user_network_tap_daemon_t::handle_extended_parameters(co_command_line_param
 		log("invalid -n paramter\n");
 		throw user_daemon_exception_t(CO_RC(ERROR));
 	}
+
+	rc = co_cmdline_params_one_arugment_int_parameter(
+		cmdline, "-q", &tap_queues_specified, &tap_queues);
+
+	if (!CO_OK(rc)  ||  tap_queues < 1  ||  tap_queues > CO_CONET_TAP_MAX_QUEUES) {
+		log("invalid -q paramter\n");
+		throw user_daemon_exception_t(CO_RC(ERROR));
+	}
 }
 
 void user_network_tap_daemon_t::syntax()
 {
 	user_daemon_t::syntax();
 	co_terminal_print("    -n name   Name to create for the network device\n");
+	co_terminal_print("    -q num    Number of TAP queues to read (1-%d)\n", CO_CONET_TAP_MAX_QUEUES);
 }
 
 
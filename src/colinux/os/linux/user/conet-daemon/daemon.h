@@ -8,6 +8,9 @@ extern "C" {
 #include <colinux/os/current/user/reactor.h>
 }
 
+#define CO_CONET_TAP_MAX_QUEUES	8
+#define CO_CONET_TAP_MAX_FRAME	(0x10000 + 0x100) /* offloaded TCP frames */
+
 class user_network_tap_daemon_t : public user_daemon_t {
 public:
 	user_network_tap_daemon_t();
@@ -18,6 +21,9 @@ public:
 	virtual const char *get_daemon_title();
 	virtual void received_from_monitor(co_message_t *message);
 	virtual void received_from_tap(unsigned char *buffer, unsigned long size);
+	virtual co_rc_t read_from_tap(co_linux_reactor_packet_user_t tap_handle);
+	virtual void write_to_tap(unsigned char *buffer, unsigned long size);
+	virtual void received_features(co_network_features_t *features);
 	virtual void handle_extended_parameters(co_command_line_params_t cmdline);
 	virtual void prepare_for_loop();
 	virtual void syntax();
@@ -25,7 +31,13 @@ public:
 protected:
 	bool_t tap_name_specified;
 	char tap_name[0x30];
-	co_linux_reactor_packet_user_t tap_handle;
+	bool_t tap_queues_specified;
+	unsigned int tap_queues;
+	bool_t tap_vnet_hdr;	/* TAP frames start with a co_network_hdr_t */
+	bool_t guest_offload;	/* and are passed to Linux that way */
+	unsigned long frames_dropped;
+	unsigned long frames_unsent;
+	co_linux_reactor_packet_user_t tap_handles[CO_CONET_TAP_MAX_QUEUES];
 };
 
 
@@ -17,7 +17,22 @@
 
 #include "tap.h"
 
-int tap_set_name(int fd, char *dev)
+/* Older headers than the running kernel */
+#ifndef IFF_VNET_HDR
+#define IFF_VNET_HDR	0x4000
+#endif
+#ifndef IFF_MULTI_QUEUE
+#define IFF_MULTI_QUEUE	0x0100
+#endif
+#ifndef TUNSETOFFLOAD
+#define TUNSETOFFLOAD	_IOW('T', 208, unsigned int)
+#define TUN_F_CSUM	0x01
+#define TUN_F_TSO4	0x02
+#define TUN_F_TSO6	0x04
+#define TUN_F_TSO_ECN	0x08
+#endif
+
+int tap_set_name(int fd, char *dev, int flags)
 {
 	struct ifreq ifr;
 	int err;
@@ -25,6 +40,10 @@ int tap_set_name(int fd, char *dev)
 	memset(&ifr, 0, sizeof(ifr));
 
 	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	if (flags & TAP_FLAG_VNET_HDR)
+		ifr.ifr_flags |= IFF_VNET_HDR;
+	if (flags & TAP_FLAG_MULTI_QUEUE)
+		ifr.ifr_flags |= IFF_MULTI_QUEUE;
 	strncpy(ifr.ifr_name, dev, IFNAMSIZ);
 
 	if ((err = ioctl(fd, TUNSETIFF, (void *)&ifr)) < 0)
@@ -34,3 +53,12 @@ int tap_set_name(int fd, char *dev)
 
 	return 0;
 }
+
+/*
+ * Let the host hand us frames with partial checksums and TCP frames of
+ * up to 64K, described by the vnet header. Only for TAP_FLAG_VNET_HDR.
+ */
+int tap_set_offload(int fd)
+{
+	return ioctl(fd, TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN);
+}
@@ -11,6 +11,10 @@
 #ifndef __COLINUX_LINUX_USER_CONET_DAEMON_TAP_H__
 #define __COLINUX_LINUX_USER_CONET_DAEMON_TAP_H__
 
-extern int tap_set_name(int fd, char *dev);
+#define TAP_FLAG_VNET_HDR	0x01 /* frames start with a co_network_hdr_t */
+#define TAP_FLAG_MULTI_QUEUE	0x02 /* fd is one of several queues of dev */
+
+extern int tap_set_name(int fd, char *dev, int flags);
+extern int tap_set_offload(int fd);
 
 #endif
@@ -14,6 +14,7 @@
 #include <colinux/user/monitor.h>
 #include <colinux/user/slirp/co_main.h>
 #include <colinux/os/user/misc.h>
+#include <colinux/os/current/user/reactor.h>
 
 COLINUX_DEFINE_MODULE("colinux-slirp-net-daemon");
 
@@ -43,6 +44,11 @@ void co_slirp_mutex_unlock (void)
 	pthread_mutex_unlock(&slirp_mutex);
 }
 
+int co_slirp_reactor_fd (co_reactor_t reactor)
+{
+	return co_linux_reactor_fd(reactor);
+}
+
 int main(int argc, char *argv[])
 {
 	co_rc_t rc;
@@ -59,6 +59,16 @@ static int daemon_main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (start_parameters.balloon_specified) {
+		rc = co_daemon_balloon(&start_parameters);
+		return CO_OK(rc) ? 0 : -1;
+	}
+
+	if (start_parameters.counters_specified) {
+		rc = co_daemon_counters(&start_parameters);
+		return CO_OK(rc) ? 0 : -1;
+	}
+
 	if (!start_parameters.config_specified || start_parameters.show_help) {
 		co_daemon_syntax();
 		return 0;
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -17,7 +18,10 @@
 
 #include <colinux/os/alloc.h>
 #include <colinux/os/user/manager.h>
+#include <colinux/common/libc.h>
+#include <colinux/common/ring.h>
 
+#include "unix.h"
 #include "reactor.h"
 
 #include "../ioctl.h"
@@ -91,20 +95,203 @@ co_rc_t co_os_manager_is_installed(bool_t *installed)
 	return CO_RC(OK);
 }
 
+/*
+ * Monitor connection over the shared message rings: incoming messages
+ * are handed to the receive callback where they lie in the rx ring, and
+ * outgoing ones are queued in the tx ring and pushed to the kernel with
+ * one empty write() per batch, right before the reactor goes to sleep.
+ * Messages that did not fit in the rx ring are still read() as usual.
+ */
+struct co_linux_reactor_monitor_user {
+	struct co_linux_reactor_packet_user packet; /* must be first */
+
+	co_message_ring_t *rx_ring;
+	co_message_ring_t *tx_ring;
+	bool_t kick_pending;
+};
+
+typedef struct co_linux_reactor_monitor_user *co_linux_reactor_monitor_user_t;
+
+/*
+ * The reactor is edge triggered, so take everything the manager has
+ * queued. Its read() returns 0 rather than blocking once it is empty.
+ */
+static co_rc_t monitor_read_queue(co_linux_reactor_packet_user_t handle)
+{
+	int read_size;
+
+	while (1) {
+		read_size = read(handle->os_user.fd, handle->buffer, sizeof(handle->buffer));
+		if (read_size > 0) {
+			handle->user.received(&handle->user, handle->buffer, read_size);
+			continue;
+		}
+
+		if (read_size == 0  ||  errno == EAGAIN)
+			return CO_RC(OK);
+
+		if (errno != EINTR)
+			return CO_RC(ERROR);
+	}
+}
+
+static co_rc_t monitor_packet_read(co_reactor_user_t user)
+{
+	return monitor_read_queue((co_linux_reactor_packet_user_t)user);
+}
+
+static co_rc_t monitor_ring_read(co_reactor_user_t user)
+{
+	co_linux_reactor_monitor_user_t handle = (co_linux_reactor_monitor_user_t)user;
+	co_message_t *message;
+	unsigned long size;
+
+	while ((message = co_message_ring_peek(handle->rx_ring, &size)) != NULL) {
+		user->received(user, (unsigned char *)message, size);
+		co_message_ring_pop(handle->rx_ring, message, size);
+	}
+
+	return monitor_read_queue(&handle->packet);
+}
+
+static void monitor_ring_kick(co_linux_reactor_monitor_user_t handle)
+{
+	handle->kick_pending = PFALSE;
+	write(handle->packet.os_user.fd, NULL, 0);
+}
+
+static co_rc_t monitor_ring_send_one(co_linux_reactor_monitor_user_t handle, co_message_t *message)
+{
+	unsigned long size = message->size + sizeof(*message);
+	co_message_t *slot;
+
+	slot = co_message_ring_reserve(handle->tx_ring, size);
+	if (!slot) {
+		/* The kernel empties the whole ring before write() returns */
+		monitor_ring_kick(handle);
+
+		slot = co_message_ring_reserve(handle->tx_ring, size);
+		if (!slot) {
+			if (write(handle->packet.os_user.fd, message, size) != size)
+				return CO_RC(ERROR);
+			return CO_RC(OK);
+		}
+	}
+
+	co_memcpy(slot, message, size);
+	if (co_message_ring_commit(handle->tx_ring, slot))
+		handle->kick_pending = PTRUE;
+
+	return CO_RC(OK);
+}
+
+static co_rc_t monitor_ring_send(co_reactor_user_t user, unsigned char *buffer, unsigned long size)
+{
+	co_linux_reactor_monitor_user_t handle = (co_linux_reactor_monitor_user_t)user;
+	co_message_t *message;
+	unsigned long message_size;
+	co_rc_t rc = CO_RC(OK);
+
+	while (size >= sizeof(*message)) {
+		message = (co_message_t *)buffer;
+		message_size = message->size + sizeof(*message);
+		if (message_size > size)
+			return CO_RC(ERROR);
+
+		rc = monitor_ring_send_one(handle, message);
+		if (!CO_OK(rc))
+			break;
+
+		buffer += message_size;
+		size -= message_size;
+	}
+
+	return rc;
+}
+
+static void monitor_ring_write(co_reactor_user_t user)
+{
+}
+
+static void monitor_ring_flush(co_reactor_user_t user)
+{
+	co_linux_reactor_monitor_user_t handle = (co_linux_reactor_monitor_user_t)user;
+
+	if (handle->kick_pending)
+		monitor_ring_kick(handle);
+}
+
+static co_rc_t monitor_ring_user_create(
+	co_reactor_t reactor, int fd,
+	co_manager_ioctl_message_ring_t *params,
+	co_reactor_user_receive_func_t receive,
+	co_reactor_user_t *handle_out)
+{
+	co_linux_reactor_monitor_user_t user;
+
+	user = co_os_malloc(sizeof(*user));
+	if (!user)
+		return CO_RC(OUT_OF_MEMORY);
+
+	co_memset(user, 0, sizeof(*user));
+
+	user->rx_ring = params->rx_user_address;
+	user->tx_ring = params->tx_user_address;
+	user->packet.os_user.fd = fd;
+
+	co_os_set_blocking(fd, PFALSE);
+
+	user->packet.user.os_data = &user->packet.os_user;
+	user->packet.user.reactor = reactor;
+	user->packet.user.received = receive;
+	user->packet.os_user.read = monitor_ring_read;
+	user->packet.os_user.write = monitor_ring_write;
+	user->packet.os_user.flush = monitor_ring_flush;
+	user->packet.user.send = monitor_ring_send;
+
+	co_reactor_add(reactor, &user->packet.user);
+
+	*handle_out = &user->packet.user;
+
+	return CO_RC(OK);
+}
+
 co_rc_t co_os_reactor_monitor_create(
 	co_reactor_t reactor, co_manager_handle_t whandle,
 	co_reactor_user_receive_func_t receive,
 	co_reactor_user_t *handle_out)
 {
+	co_manager_ioctl_message_ring_t params;
+	co_rc_t rc;
+
 	*handle_out = NULL;
 
-	return co_linux_reactor_packet_user_create(
+	/* Fall back to plain read()/write() on hosts without message rings */
+	co_memset(&params, 0, sizeof(params));
+	rc = co_os_manager_ioctl(whandle, CO_MANAGER_IOCTL_MESSAGE_RING,
+				 &params, sizeof(params), &params, sizeof(params), NULL);
+	if (CO_OK(rc) && CO_OK(params.rc))
+		return monitor_ring_user_create(reactor, (int)whandle, &params,
+						receive, handle_out);
+
+	rc = co_linux_reactor_packet_user_create(
 		reactor, (int)whandle, receive,
 		(co_linux_reactor_packet_user_t *)handle_out);
+	if (!CO_OK(rc))
+		return rc;
 
+	(*handle_out)->os_data->read = monitor_packet_read;
+
+	return CO_RC(OK);
 }
 
 void co_os_reactor_monitor_destroy(co_reactor_user_t handle)
 {
-	co_linux_reactor_packet_user_destroy((co_linux_reactor_packet_user_t)handle);
+	co_linux_reactor_monitor_user_t user = (co_linux_reactor_monitor_user_t)handle;
+
+	if (user->packet.os_user.flush)
+		monitor_ring_flush(handle);
+
+	/* The kernel unmaps the rings when the descriptor is closed */
+	co_linux_reactor_packet_user_destroy(&user->packet);
 }
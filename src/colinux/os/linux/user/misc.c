@@ -93,6 +93,13 @@ void co_terminal_print_color(co_terminal_color_t color, const char *format, ...)
 	va_end(ap);
 }
 
+void co_terminal_clear(void)
+{
+	/* VT100: cursor home, erase display */
+	printf("\033[H\033[2J");
+	fflush(stdout);
+}
+
 void co_os_get_timestamp(co_timestamp_t *dts)
 {
 	struct timeval tv;
@@ -103,6 +110,11 @@ void co_os_get_timestamp(co_timestamp_t *dts)
         dts->low = tv.tv_usec;
 }
 
+void co_os_msleep(unsigned int msecs)
+{
+	usleep(msecs * 1000);
+}
+
 int co_udp_socket_connect(const char *addr, unsigned short int port)
 {
 	struct sockaddr_in server;
@@ -5,53 +5,170 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <sys/poll.h>
+#include <errno.h>
 
 #include "unix.h"
 #include "reactor.h"
 
+co_rc_t co_os_reactor_create(co_reactor_t handle)
+{
+	co_reactor_os_t os;
+
+	os = co_os_malloc(sizeof(*os));
+	if (!os)
+		return CO_RC(OUT_OF_MEMORY);
+
+	co_memset(os, 0, sizeof(*os));
+
+	os->epoll_fd = epoll_create(CO_LINUX_REACTOR_MAX_EVENTS);
+	if (os->epoll_fd < 0) {
+		co_os_free(os);
+		return CO_RC(ERROR);
+	}
+
+	handle->os_data = os;
+
+	return CO_RC(OK);
+}
+
+void co_os_reactor_add(co_reactor_t handle, co_reactor_user_t user)
+{
+	struct epoll_event event;
+
+	co_memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+	event.data.ptr = user;
+
+	if (epoll_ctl(handle->os_data->epoll_fd, EPOLL_CTL_ADD, user->os_data->fd, &event) == 0) {
+		user->os_data->watched = PTRUE;
+		return;
+	}
+
+	if (errno != EPERM)
+		co_debug("epoll_ctl(%d) failed (errno=%d)", user->os_data->fd, errno);
+
+	user->os_data->watched = PFALSE;
+	handle->os_data->num_unwatched += 1;
+}
+
+void co_os_reactor_remove(co_reactor_t handle, co_reactor_user_t user)
+{
+	struct epoll_event event;
+	int index;
+
+	/* The user may be freed once we return, don't call it for its events */
+	for (index = 0; index < handle->os_data->num_events; index++)
+		if (handle->os_data->events[index].data.ptr == user)
+			handle->os_data->events[index].data.ptr = NULL;
+	handle->os_data->removed++;
+
+	if (!user->os_data->watched) {
+		handle->os_data->num_unwatched -= 1;
+		return;
+	}
+
+	/* Kernels before 2.6.9 want an event even though it's ignored */
+	co_memset(&event, 0, sizeof(event));
+	epoll_ctl(handle->os_data->epoll_fd, EPOLL_CTL_DEL, user->os_data->fd, &event);
+	user->os_data->watched = PFALSE;
+}
+
+void co_os_reactor_destroy(co_reactor_t handle)
+{
+	close(handle->os_data->epoll_fd);
+	co_os_free(handle->os_data);
+	handle->os_data = NULL;
+}
+
+int co_linux_reactor_fd(co_reactor_t handle)
+{
+	return handle->os_data->epoll_fd;
+}
+
 co_rc_t co_os_reactor_select(co_reactor_t handle, int miliseconds)
 {
-	struct pollfd wait_list[handle->num_users];
-	co_reactor_user_t users[handle->num_users];
+	struct epoll_event *events = handle->os_data->events;
 	co_reactor_user_t user;
 	int wait_time, ret;
-	int index = 0, count = 0;
+	int index;
 	co_rc_t rc = CO_RC(OK);
 
 	co_list_each_entry(user, &handle->users, node) {
-		wait_list[index].fd = user->os_data->fd;
-		wait_list[index].events = POLLIN | POLLHUP | POLLERR;
-		wait_list[index].revents = 0;
-		users[index] = user;
-		index += 1;
+		if (user->os_data->flush)
+			user->os_data->flush(user);
 	}
 
-	count = handle->num_users;
-
 	wait_time = -1;
 	if (miliseconds >= 0)
 		wait_time = miliseconds;
 
-	ret = poll(wait_list, count, wait_time);
-	if (ret == 0)
-		return CO_RC(OK);
+	if (handle->os_data->num_unwatched)
+		wait_time = 0;
 
-	if (ret < 0)
+	ret = epoll_wait(handle->os_data->epoll_fd, events,
+			 CO_LINUX_REACTOR_MAX_EVENTS, wait_time);
+	if (ret < 0) {
+		if (errno == EINTR)
+			return CO_RC(OK);
 		return CO_RC(ERROR);
+	}
 
-	for (index=0; index < count; index++) {
-		user = users[index];
-		if (wait_list[index].revents & POLLIN) {
-			rc = user->last_read_rc = user->os_data->read(user);
-			if (!CO_OK(rc))
-				break;
+	/*
+	 * The events are edge triggered and won't be reported again, so all
+	 * of them are handled before the first error is returned. Callbacks
+	 * may remove users, co_os_reactor_remove() clears their events.
+	 */
+	handle->os_data->num_events = ret;
+	for (index=0; index < ret; index++) {
+		co_rc_t user_rc = CO_RC(OK);
+
+		user = (co_reactor_user_t)events[index].data.ptr;
+		if (!user)
+			continue;
+
+		/* Take in what is left before reporting a hangup */
+		if (events[index].events & (EPOLLIN | EPOLLHUP)) {
+			user_rc = user->os_data->read(user);
+			if (events[index].data.ptr)
+				user->last_read_rc = user_rc;
 		}
-		if (wait_list[index].revents & POLLERR) {
-			return CO_RC(ERROR); /* TODO */
+		if (CO_OK(user_rc)  &&  (events[index].events & EPOLLERR))
+			user_rc = CO_RC(ERROR);
+		if (CO_OK(user_rc)  &&  (events[index].events & EPOLLHUP))
+			user_rc = CO_RC(BROKEN_PIPE);
+
+		if (!CO_OK(user_rc)) {
+			if (CO_OK(rc))
+				rc = user_rc;
+			continue;
 		}
-		if (wait_list[index].revents & POLLHUP) {
-			return CO_RC(BROKEN_PIPE);
+
+		if ((events[index].events & EPOLLOUT)  &&  events[index].data.ptr)
+			user->os_data->write(user);
+	}
+	handle->os_data->num_events = 0;
+
+	/*
+	 * After a callback removed a user, the list can't be trusted any
+	 * more. The rest is read on the next select, which doesn't block
+	 * while there are unwatched users.
+	 */
+	if (handle->os_data->num_unwatched) {
+		co_list_each_entry(user, &handle->users, node) {
+			unsigned long removed = handle->os_data->removed;
+			co_rc_t user_rc;
+
+			if (user->os_data->watched)
+				continue;
+
+			user_rc = user->os_data->read(user);
+			if (!CO_OK(user_rc)  &&  CO_OK(rc))
+				rc = user_rc;
+
+			if (removed != handle->os_data->removed)
+				break;
+
+			user->last_read_rc = user_rc;
 		}
 	}
 
@@ -62,12 +179,25 @@ static co_rc_t packet_read_complete(co_linux_reactor_packet_user_t handle)
 {
 	int size;
 
+	/* A read that finds nothing at the start of a wakeup is end of file */
 	size = read(handle->os_user.fd, handle->buffer, sizeof(handle->buffer));
-	if (size <= 0)
-		return CO_RC(ERROR);
+	if (size < 0  &&  (errno == EAGAIN  ||  errno == EINTR))
+		return CO_RC(OK);
 
-	handle->user.received(&handle->user, handle->buffer, size);
-	return CO_RC(OK);
+	while (size > 0) {
+		handle->user.received(&handle->user, handle->buffer, size);
+
+		if (!handle->os_user.watched)
+			return CO_RC(OK);
+
+		size = read(handle->os_user.fd, handle->buffer, sizeof(handle->buffer));
+		if (size < 0  &&  errno == EINTR)
+			continue;
+		if (size <= 0)
+			return CO_RC(OK);
+	}
+
+	return CO_RC(ERROR);
 }
 
 static co_rc_t packet_send_whole(co_linux_reactor_packet_user_t handle,
@@ -75,10 +205,24 @@ static co_rc_t packet_send_whole(co_linux_reactor_packet_user_t handle,
 {
 	int written;
 
+	/* Keep packets in order behind one that is waiting for room */
+	if (handle->pending_size) {
+		handle->os_user.write(&handle->user);
+		if (handle->pending_size)
+			return CO_RC(ERROR);
+	}
+
 	written = write(handle->os_user.fd, buffer, size);
-	if (written != size)
-		return CO_RC(ERROR);
-	return CO_RC(OK);
+	if (written == size)
+		return CO_RC(OK);
+
+	if (written < 0  &&  errno == EAGAIN  &&  size <= sizeof(handle->pending)) {
+		co_memcpy(handle->pending, buffer, size);
+		handle->pending_size = size;
+		return CO_RC(OK);
+	}
+
+	return CO_RC(ERROR);
 }
 
 static co_rc_t packet_read(co_reactor_user_t user)
@@ -93,6 +237,17 @@ static co_rc_t packet_send(co_reactor_user_t user, unsigned char *buffer, unsign
 
 static void packet_write(co_reactor_user_t user)
 {
+	co_linux_reactor_packet_user_t handle = (co_linux_reactor_packet_user_t)user;
+	int written;
+
+	if (!handle->pending_size)
+		return;
+
+	written = write(handle->os_user.fd, handle->pending, handle->pending_size);
+	if (written < 0  &&  errno == EAGAIN)
+		return;
+
+	handle->pending_size = 0;
 }
 
 extern co_rc_t co_linux_reactor_packet_user_create(
@@ -128,7 +283,7 @@ extern co_rc_t co_linux_reactor_packet_user_create(
 
 void co_linux_reactor_packet_user_destroy(co_linux_reactor_packet_user_t user)
 {
-	close(user->os_user.fd);
 	co_reactor_remove(&user->user);
+	close(user->os_user.fd);
 	co_os_free(user);
 }
@@ -13,11 +13,36 @@
 
 #include <colinux/user/reactor.h>
 
+#include <sys/epoll.h>
+
+#define CO_LINUX_REACTOR_MAX_EVENTS 16
+
+struct co_reactor_os {
+	int epoll_fd;
+	unsigned long num_unwatched; /* users epoll refused, see below */
+
+	/* Events being handled, a user removed meanwhile is taken out */
+	struct epoll_event events[CO_LINUX_REACTOR_MAX_EVENTS];
+	int num_events;
+	unsigned long removed; /* count of co_os_reactor_remove() calls */
+};
+
+/*
+ * Users are registered once with the reactor's epoll set, edge triggered
+ * for both directions. Since a ready fd is reported only once per
+ * transition, read() must consume everything until the fd would block,
+ * and write() is called when a fd that had been full can take more.
+ *
+ * Regular files can't be watched by epoll; they are always ready, as
+ * poll() would report, and read on every select.
+ */
 struct co_reactor_os_user {
 	int fd;
+	bool_t watched;
 
 	co_rc_t (*read)(co_reactor_user_t user);
 	void (*write)(co_reactor_user_t user);
+	void (*flush)(co_reactor_user_t user); /* optional, before blocking */
 };
 
 struct co_linux_reactor_packet_user {
@@ -26,6 +51,10 @@ struct co_linux_reactor_packet_user {
 
 	unsigned char buffer[0x10000];
 	unsigned long size;
+
+	/* A packet that found the fd full, sent from write() */
+	unsigned char pending[0x10000];
+	unsigned long pending_size;
 };
 
 typedef struct co_linux_reactor_packet_user *co_linux_reactor_packet_user_t;
@@ -38,4 +67,6 @@ extern co_rc_t co_linux_reactor_packet_user_create(
 extern void co_linux_reactor_packet_user_destroy(
 	co_linux_reactor_packet_user_t user);
 
+extern int co_linux_reactor_fd(co_reactor_t reactor);
+
 #endif
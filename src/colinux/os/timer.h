@@ -20,6 +20,8 @@ extern co_rc_t co_os_timer_create(co_os_func_t func, void *data,
 				  long msec, co_os_timer_t *timer_out);
 extern co_rc_t co_os_timer_activate(co_os_timer_t timer);
 extern void co_os_timer_deactivate(co_os_timer_t timer);
+/* Fire once, msec from now, instead of periodically until co_os_timer_activate() */
+extern co_rc_t co_os_timer_oneshot(co_os_timer_t timer, long msec);
 extern void co_os_timer_destroy(co_os_timer_t timer);
 extern void co_os_msleep(unsigned int msecs);
 
@@ -35,6 +37,8 @@ typedef struct {
 
 extern void co_os_get_timestamp(co_timestamp_t *dts);
 extern void co_os_get_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq);
+/* Like co_os_get_timestamp_freq(), but never stepped by host clock changes */
+extern void co_os_get_monotonic_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq);
 extern unsigned long co_os_get_cpu_khz(void);
 
 #endif
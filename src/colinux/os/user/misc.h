@@ -29,6 +29,7 @@ extern void co_terminal_print(const char* format, ...)
 extern void co_terminal_print_color(co_terminal_color_t color, const char* format, ...)
 	__attribute__ ((format (printf, 2, 3)));
 extern void co_set_terminal_print_hook(co_terminal_print_hook_func_t func);
+extern void co_terminal_clear(void);
 extern void co_process_high_priority_set(void);
 extern int co_udp_socket_connect(const char* addr, unsigned short int port);
 extern int co_udp_socket_send(int sock, const char* buffer, unsigned long size);
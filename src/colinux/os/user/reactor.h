@@ -13,6 +13,10 @@
 
 #include <colinux/user/reactor.h>
 
+extern co_rc_t co_os_reactor_create(co_reactor_t handle);
 extern co_rc_t co_os_reactor_select(co_reactor_t handle, int miliseconds);
+extern void co_os_reactor_add(co_reactor_t handle, co_reactor_user_t user);
+extern void co_os_reactor_remove(co_reactor_t handle, co_reactor_user_t user);
+extern void co_os_reactor_destroy(co_reactor_t handle);
 
 #endif
@@ -0,0 +1,22 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * Dan Aloni <da-x@colinux.org>, 2003 (c)
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#ifndef __COLINUX_OS_USER_THREAD_H__
+#define __COLINUX_OS_USER_THREAD_H__
+
+#include <colinux/common/common.h>
+
+typedef struct co_os_thread *co_os_thread_t;
+typedef void (*co_os_thread_func_t)(void *data);
+
+extern co_rc_t co_os_thread_create(co_os_thread_func_t func, void *data, co_os_thread_t *thread_out);
+extern void co_os_thread_join(co_os_thread_t thread);
+
+#endif
@@ -179,35 +179,27 @@ void co_winnt_free_all_pages(co_osdep_manager_t osdep)
 	osdep->pages_allocated = 0;
 }
 
-co_rc_t co_os_get_page(struct co_manager* manager, co_pfn_t* pfn)
+static co_rc_t co_winnt_get_page(co_osdep_manager_t osdep, co_pfn_t* pfn)
 {
-	co_osdep_manager_t osdep = manager->osdep;
-	co_rc_t            rc    = CO_RC(OK);
-
-	co_os_mutex_acquire(osdep->mutex);
+	co_rc_t rc;
 
 	if (!co_list_empty(&osdep->pages_unused)) {
 		co_os_get_unused_mdl_page(osdep, pfn);
-	} else {
+		return CO_RC(OK);
+	}
 
-		rc = co_winnt_new_mdl_bucket(osdep);
-		if (CO_OK(rc)) {
-			co_os_get_unused_mdl_page(osdep, pfn);
-		} else {
-			rc = co_winnt_new_mapped_allocated_page(osdep, pfn);
-		}
+	rc = co_winnt_new_mdl_bucket(osdep);
+	if (CO_OK(rc)) {
+		co_os_get_unused_mdl_page(osdep, pfn);
+	} else {
+		rc = co_winnt_new_mapped_allocated_page(osdep, pfn);
 	}
 
-	co_os_mutex_release(osdep->mutex);
 	return rc;
 }
 
-void co_os_put_page(struct co_manager* manager, co_pfn_t pfn)
+static void co_winnt_put_page(co_osdep_manager_t osdep, co_pfn_t pfn)
 {
-	co_osdep_manager_t osdep = manager->osdep;
-
-	co_os_mutex_acquire(osdep->mutex);
-
 	co_list_t*       list = &osdep->pages_hash[PFN_HASH(pfn)];
 	co_os_pfn_ptr_t* pfn_ptr;
 
@@ -222,6 +214,49 @@ void co_os_put_page(struct co_manager* manager, co_pfn_t pfn)
 
 		break;
 	}
+}
+
+co_rc_t co_os_get_page(struct co_manager* manager, co_pfn_t* pfn)
+{
+	return co_os_get_pages(manager, pfn, 1);
+}
+
+void co_os_put_page(struct co_manager* manager, co_pfn_t pfn)
+{
+	co_os_put_pages(manager, &pfn, 1);
+}
+
+/* Like co_os_get_page(), @count times under one acquisition of the mutex */
+co_rc_t co_os_get_pages(struct co_manager* manager, co_pfn_t* pfns, unsigned long count)
+{
+	co_osdep_manager_t osdep = manager->osdep;
+	co_rc_t            rc    = CO_RC(OK);
+	unsigned long      i;
+
+	co_os_mutex_acquire(osdep->mutex);
+
+	for (i = 0; i < count; i++) {
+		rc = co_winnt_get_page(osdep, &pfns[i]);
+		if (!CO_OK(rc)) {
+			while (i--)
+				co_winnt_put_page(osdep, pfns[i]);
+			break;
+		}
+	}
+
+	co_os_mutex_release(osdep->mutex);
+	return rc;
+}
+
+void co_os_put_pages(struct co_manager* manager, co_pfn_t* pfns, unsigned long count)
+{
+	co_osdep_manager_t osdep = manager->osdep;
+	unsigned long      i;
+
+	co_os_mutex_acquire(osdep->mutex);
+
+	for (i = 0; i < count; i++)
+		co_winnt_put_page(osdep, pfns[i]);
 
 	co_os_mutex_release(osdep->mutex);
 }
@@ -70,9 +70,9 @@ co_rc_t co_status_convert(NTSTATUS status)
 	}
 }
 
-co_rc_t co_os_file_create(char *pathname, PHANDLE FileHandle, unsigned long open_flags,
-			  unsigned long file_attribute, unsigned long create_disposition,
-			  unsigned long options)
+static co_rc_t co_os_file_create_share(char *pathname, PHANDLE FileHandle, unsigned long open_flags,
+				       unsigned long file_attribute, unsigned long create_disposition,
+				       unsigned long options, unsigned long share)
 {
 	NTSTATUS status;
 	OBJECT_ATTRIBUTES ObjectAttributes;
@@ -96,8 +96,7 @@ co_rc_t co_os_file_create(char *pathname, PHANDLE FileHandle, unsigned long open
 			      &IoStatusBlock,
 			      NULL,
 			      file_attribute,
-			      (open_flags == (FILE_LIST_DIRECTORY | SYNCHRONIZE)) ?
-				 FILE_SHARE_DIRECTORY : 0,
+			      share,
 			      create_disposition,
 			      options,
 			      NULL,
@@ -111,6 +110,16 @@ co_rc_t co_os_file_create(char *pathname, PHANDLE FileHandle, unsigned long open
 	return co_status_convert(status);
 }
 
+co_rc_t co_os_file_create(char *pathname, PHANDLE FileHandle, unsigned long open_flags,
+			  unsigned long file_attribute, unsigned long create_disposition,
+			  unsigned long options)
+{
+	return co_os_file_create_share(pathname, FileHandle, open_flags, file_attribute,
+				       create_disposition, options,
+				       (open_flags == (FILE_LIST_DIRECTORY | SYNCHRONIZE)) ?
+					  FILE_SHARE_DIRECTORY : 0);
+}
+
 co_rc_t co_os_file_open(char *pathname, PHANDLE FileHandle, unsigned long open_flags)
 {
 	return co_os_file_create(pathname, FileHandle, open_flags | SYNCHRONIZE, 0, FILE_OPEN, FILE_SYNCHRONOUS_IO_NONALERT);
@@ -177,27 +186,83 @@ co_rc_t co_os_set_file_information(char *filename,
 	return co_status_convert(status);
 }
 
-co_rc_t co_os_file_read_write(co_monitor_t *linuxvm, char *filename,
-			      unsigned long long offset, unsigned long size,
-			      vm_ptr_t src_buffer, bool_t read)
+struct co_os_fs_file {
+	HANDLE handle;
+};
+
+co_rc_t co_os_fs_file_open(co_filesystem_t *filesystem, char *filename,
+			   bool_t write, struct co_os_fs_file **file)
 {
+	struct co_os_fs_file *fs_file;
 	co_rc_t rc;
-	HANDLE handle;
 
-	rc = co_os_file_open(filename, &handle, read ? FILE_READ_DATA : FILE_WRITE_DATA);
-	if (!CO_OK(rc))
+	fs_file = co_os_malloc(sizeof(*fs_file));
+	if (!fs_file)
+		return CO_RC(OUT_OF_MEMORY);
+
+	/* The file stays open, so it must not lock out the host */
+	rc = co_os_file_create_share(filename, &fs_file->handle,
+				     (write ? FILE_READ_DATA | FILE_WRITE_DATA : FILE_READ_DATA) | SYNCHRONIZE,
+				     0, FILE_OPEN, FILE_SYNCHRONOUS_IO_NONALERT,
+				     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE);
+	if (!CO_OK(rc)) {
+		co_os_free(fs_file);
 		return rc;
+	}
 
-	rc = co_os_file_block_read_write(linuxvm,
-					 handle,
-					 offset,
-					 src_buffer,
-					 size,
-					 read);
+	*file = fs_file;
+	return CO_RC(OK);
+}
 
-	co_os_file_close(handle);
+void co_os_fs_file_close(struct co_os_fs_file *file)
+{
+	co_os_file_close(file->handle);
+	co_os_free(file);
+}
 
-	return rc;
+co_rc_t co_os_fs_file_transfer(co_monitor_t *cmon,
+			       void *host_data,
+			       co_monitor_transfer_vec_t *vec,
+			       unsigned long count,
+			       unsigned long offset,
+			       co_monitor_transfer_dir_t dir)
+{
+	co_filesystem_io_t *io = (co_filesystem_io_t *)host_data;
+	IO_STATUS_BLOCK isb;
+	LARGE_INTEGER pos;
+	NTSTATUS status;
+	unsigned long i;
+
+	pos.QuadPart = io->offset + offset;
+
+	for (i = 0; i < count; i++) {
+		if (CO_MONITOR_TRANSFER_FROM_HOST == dir)
+			status = ZwReadFile(io->file->handle, NULL, NULL, NULL, &isb,
+					    vec[i].ptr, vec[i].size, &pos, NULL);
+		else
+			status = ZwWriteFile(io->file->handle, NULL, NULL, NULL, &isb,
+					     vec[i].ptr, vec[i].size, &pos, NULL);
+
+		/* A short read is the end of the file, the guest knows the size */
+		if (status == STATUS_END_OF_FILE)
+			break;
+
+		if (status != STATUS_SUCCESS)
+			return co_status_convert(status);
+
+		io->done += isb.Information;
+		pos.QuadPart += isb.Information;
+
+		if (isb.Information != vec[i].size) {
+			if (CO_MONITOR_TRANSFER_FROM_HOST == dir)
+				break;
+			co_debug_lvl(filesystem, 5, "short write: %ld != %ld",
+				     (long)isb.Information, vec[i].size);
+			return CO_RC(ERROR);
+		}
+	}
+
+	return CO_RC(OK);
 }
 
 static void change_file_mode_func(void *data, VOID *buffer, ULONG len)
@@ -237,7 +302,8 @@ static void change_file_info_func(void *data, VOID *buffer, ULONG len)
 	KeQuerySystemTime(&fbi->ChangeTime);
 }
 
-co_rc_t co_os_file_set_attr(char *filename, unsigned long valid, struct fuse_attr *attr)
+co_rc_t co_os_file_set_attr(co_filesystem_t *filesystem, char *filename,
+			    unsigned long valid, struct fuse_attr *attr)
 {
 	IO_STATUS_BLOCK io_status;
 	co_rc_t rc = CO_RC(OK);
@@ -281,7 +347,7 @@ co_rc_t co_os_file_set_attr(char *filename, unsigned long valid, struct fuse_att
 	return rc;
 }
 
-co_rc_t co_os_file_get_attr(char *fullname, struct fuse_attr *attr)
+co_rc_t co_os_file_get_attr(co_filesystem_t *filesystem, char *fullname, struct fuse_attr *attr)
 {
 	char * dirname;
 	char * filename;
@@ -454,7 +520,7 @@ static void remove_read_only_func(void *data, VOID *buffer, ULONG len)
 	*((int*)data) = 1; /* Attrib changed */
 }
 
-co_rc_t co_os_file_unlink(char *filename)
+co_rc_t co_os_file_unlink(co_filesystem_t *filesystem, char *filename)
 {
 	OBJECT_ATTRIBUTES ObjectAttributes;
 	UNICODE_STRING unipath;
@@ -499,12 +565,12 @@ co_rc_t co_os_file_unlink(char *filename)
 	return co_status_convert(status);
 }
 
-co_rc_t co_os_file_rmdir(char *filename)
+co_rc_t co_os_file_rmdir(co_filesystem_t *filesystem, char *filename)
 {
-	return co_os_file_unlink(filename);
+	return co_os_file_unlink(filesystem, filename);
 }
 
-co_rc_t co_os_file_mkdir(char *dirname)
+co_rc_t co_os_file_mkdir(co_filesystem_t *filesystem, char *dirname)
 {
 	HANDLE handle;
 	co_rc_t rc;
@@ -518,7 +584,7 @@ co_rc_t co_os_file_mkdir(char *dirname)
 	return rc;
 }
 
-co_rc_t co_os_file_rename(char *filename, char *dest_filename)
+co_rc_t co_os_file_rename(co_filesystem_t *filesystem, char *filename, char *dest_filename)
 {
 	NTSTATUS status;
 	IO_STATUS_BLOCK io_status;
@@ -618,7 +684,7 @@ co_rc_t co_os_file_mknod(co_filesystem_t *filesystem, char *filename, unsigned l
 	return rc;
 }
 
-co_rc_t co_os_file_getdir(char *dirname, co_filesystem_dir_names_t *names)
+co_rc_t co_os_file_getdir(co_filesystem_t *filesystem, char *dirname, co_filesystem_dir_names_t *names)
 {
 	UNICODE_STRING dirname_unicode;
 	OBJECT_ATTRIBUTES attributes;
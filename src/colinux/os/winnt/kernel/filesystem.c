@@ -107,3 +107,28 @@ co_rc_t co_os_fs_dir_join_unix_path(co_pathname_t *dirname, const char *addition
 
 	return CO_RC(OK);
 }
+
+/* No change notification yet, the attribute cache relies on its timeout */
+co_rc_t co_os_fs_notify_init(co_filesystem_t *filesystem)
+{
+	return CO_RC(ERROR);
+}
+
+void co_os_fs_notify_free(co_filesystem_t *filesystem)
+{
+}
+
+co_rc_t co_os_fs_watch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
+{
+	return CO_RC(ERROR);
+}
+
+void co_os_fs_unwatch_dir(co_filesystem_t *filesystem, co_inode_t *dir)
+{
+	dir->watch = NULL;
+}
+
+bool_t co_os_fs_watch_generation(struct co_os_fs_watch *watch, unsigned long *generation)
+{
+	return PFALSE;
+}
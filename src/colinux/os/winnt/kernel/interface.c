@@ -93,12 +93,13 @@ static NTSTATUS manager_read(co_manager_t *manager, co_manager_open_desc_t opene
 			if (!CO_OK(rc))
 				break;
 
-			co_queue_free(queue, message_item);
 			co_memcpy(io_buffer, message, size);
 			io_buffer += size;
-			co_os_free(message);
+			co_message_queue_item_free(queue, message_item);
 		}
 
+		co_manager_reader_drained(opened);
+
 		Irp->IoStatus.Information = io_buffer - io_buffer_start;
 		if (Irp->IoStatus.Information == 0)
 			Irp->IoStatus.Status = STATUS_BUFFER_OVERFLOW;
@@ -98,24 +98,46 @@ void co_os_free(void *ptr)
 	ExFreePoolWithTag(ptr, CO_OS_POOL_TAG);
 }
 
+/*
+ * The handle of a userspace mapping. It remembers the process the pages
+ * were mapped into, so that they are unmapped from there even when the
+ * last handle to the driver is closed in another process.
+ */
+typedef struct co_os_userspace_mapping {
+	PMDL mdl;
+	PEPROCESS process;
+} co_os_userspace_mapping_t;
+
 co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_address_out, void **handle_out)
 {
+	co_os_userspace_mapping_t *mapping;
 	void *user_address;
 	unsigned long memory_size = ((unsigned long)pages) << CO_ARCH_PAGE_SHIFT;
 	PMDL mdl;
 
+	mapping = co_os_malloc(sizeof(*mapping));
+	if (!mapping)
+		return CO_RC(OUT_OF_MEMORY);
+
 	mdl = IoAllocateMdl(address, memory_size, FALSE, FALSE, NULL);
-	if (!mdl)
+	if (!mdl) {
+		co_os_free(mapping);
 		return CO_RC(ERROR);
+	}
 
 	MmBuildMdlForNonPagedPool(mdl);
 	user_address = MmMapLockedPagesSpecifyCache(mdl, UserMode, MmCached, NULL, FALSE, HighPagePriority);
 	if (!user_address) {
 		IoFreeMdl(mdl);
+		co_os_free(mapping);
 		return CO_RC(ERROR);
 	}
 
-	*handle_out = (void *)mdl;
+	mapping->mdl = mdl;
+	mapping->process = PsGetCurrentProcess();
+	ObReferenceObject(mapping->process);
+
+	*handle_out = (void *)mapping;
 	*user_address_out = PAGE_ALIGN(user_address) + MmGetMdlByteOffset(mdl);
 
 	return CO_RC(OK);
@@ -123,10 +145,20 @@ co_rc_t co_os_userspace_map(void *address, unsigned int pages, void **user_addre
 
 void co_os_userspace_unmap(void *user_address, void *handle, unsigned int pages)
 {
-	PMDL mdl = (PMDL)handle;
-
-	if (user_address)
-		MmUnmapLockedPages(user_address, mdl);
+	co_os_userspace_mapping_t *mapping = (co_os_userspace_mapping_t *)handle;
+	KAPC_STATE apc_state;
+
+	if (user_address) {
+		if (mapping->process == PsGetCurrentProcess()) {
+			MmUnmapLockedPages(user_address, mapping->mdl);
+		} else {
+			KeStackAttachProcess((PRKPROCESS)mapping->process, &apc_state);
+			MmUnmapLockedPages(user_address, mapping->mdl);
+			KeUnstackDetachProcess(&apc_state);
+		}
+	}
 
-	IoFreeMdl(mdl);
+	ObDereferenceObject(mapping->process);
+	IoFreeMdl(mapping->mdl);
+	co_os_free(mapping);
 }
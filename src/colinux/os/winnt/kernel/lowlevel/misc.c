@@ -21,6 +21,25 @@ unsigned long co_os_virt_to_phys(void *addr)
 	return pa.QuadPart;
 }
 
+/* A hint only, the caller may be moved to another CPU right after */
+unsigned int co_os_current_cpu(void)
+{
+	return KeGetCurrentProcessorNumber();
+}
+
+unsigned int co_os_cpu_count(void)
+{
+	KAFFINITY active = KeQueryActiveProcessors();
+	unsigned int count = 0;
+
+	while (active) {
+		count += active & 1;
+		active >>= 1;
+	}
+
+	return count;
+}
+
 co_rc_t co_os_physical_memory_pages(unsigned long *pages)
 {
 	SYSTEM_BASIC_INFORMATION sbi;
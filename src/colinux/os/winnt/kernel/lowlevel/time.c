@@ -44,6 +44,12 @@ void co_os_get_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq)
 	}
 }
 
+/* The performance counter is never stepped */
+void co_os_get_monotonic_timestamp_freq(co_timestamp_t *dts, co_timestamp_t *freq)
+{
+	co_os_get_timestamp_freq(dts, freq);
+}
+
 unsigned long co_os_get_cpu_khz(void)
 {
 	NTSTATUS status;
@@ -51,6 +51,9 @@ co_rc_t co_os_timer_create(co_os_func_t func, void *data,
 	timer->data = data;
 	timer->msec = msec;
 
+	KeInitializeDpc(&timer->dpc, &co_os_timer_routine, (PVOID)timer);
+	KeInitializeTimerEx(&timer->ktimer, SynchronizationTimer);
+
 	*timer_out = timer;
 
 	return CO_RC(OK);
@@ -60,15 +63,25 @@ co_rc_t co_os_timer_activate(co_os_timer_t timer)
 {
 	LARGE_INTEGER li;
 
-	li.QuadPart = 0;
+	li.QuadPart = (long long)timer->msec * 10000 * (-1);
 
-	KeInitializeDpc(&timer->dpc, &co_os_timer_routine, (PVOID)timer);
-	KeInitializeTimerEx(&timer->ktimer, SynchronizationTimer);
 	KeSetTimerEx(&timer->ktimer, li, timer->msec, &timer->dpc);
 
 	return CO_RC(OK);
 }
 
+co_rc_t co_os_timer_oneshot(co_os_timer_t timer, long msec)
+{
+	LARGE_INTEGER li;
+
+	li.QuadPart = (long long)msec * 10000 * (-1);
+
+	/* Replaces the periodic timer, if set */
+	KeSetTimerEx(&timer->ktimer, li, 0, &timer->dpc);
+
+	return CO_RC(OK);
+}
+
 void co_os_timer_deactivate(co_os_timer_t timer)
 {
 	KeCancelTimer(&timer->ktimer);
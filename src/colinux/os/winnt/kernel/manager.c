@@ -15,12 +15,9 @@
 
 static void setup_host_memory_range(co_manager_t *manager, co_osdep_manager_t osdep)
 {
+	/* Only below CO_HOST_PFN_LIMIT, the guest doesn't use PAE */
 	osdep->hostmem_max_physical_address =
-		(long long) (manager->hostmem_pages - 1) << CO_ARCH_PAGE_SHIFT;
-
-	/* We don't support PGE yet */
-	if (osdep->hostmem_max_physical_address >= 0x100000000LL)
-		osdep->hostmem_max_physical_address = 0x100000000LL-1;
+		((long long) manager->hostmem_pfn_limit << CO_ARCH_PAGE_SHIFT) - 1;
 }
 
 co_rc_t co_os_manager_init(co_manager_t *manager, co_osdep_manager_t *osdep)
@@ -159,6 +156,14 @@ co_rc_t co_os_manager_userspace_eof(co_manager_t *manager, co_manager_open_desc_
 	return CO_RC(OK);
 }
 
+co_rc_t co_os_manager_userspace_message_ring(co_manager_t *manager,
+					     co_manager_open_desc_t opened,
+					     co_manager_ioctl_message_ring_t *params)
+{
+	/* Pending read IRPs are completed directly, see above */
+	return CO_RC(ERROR);
+}
+
 co_id_t co_os_current_id(void)
 {
 	return (co_id_t)(PsGetCurrentProcessId());
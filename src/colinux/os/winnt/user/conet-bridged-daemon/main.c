@@ -80,7 +80,8 @@ static co_rc_t monitor_receive(co_reactor_user_t user, unsigned char *buffer, un
 		message = (typeof(message))(&buffer[position]);
 		message_size = message->size + sizeof(*message);
 		size_left -= message_size;
-		if (size_left >= 0) {
+		/* Skip the guest's offload announcement, we take plain frames */
+		if (size_left >= 0  &&  message->type == CO_MESSAGE_TYPE_OTHER) {
 			pcap_rc = pcap_sendpacket(pcap_packet.adhandle,
 						  message->data, message->size);
 			/* TODO */
@@ -125,6 +125,10 @@ void user_network_tap_daemon_t::received_from_tap(unsigned char *buffer, unsigne
 
 void user_network_tap_daemon_t::received_from_monitor(co_message_t *message)
 {
+	/* Skip the guest's offload announcement, we take plain frames */
+	if (message->type != CO_MESSAGE_TYPE_OTHER)
+		return;
+
 	tap_handle->user.send(&tap_handle->user, (unsigned char *)message->data, message->size);
 }
 
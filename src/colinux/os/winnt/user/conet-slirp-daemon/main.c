@@ -46,6 +46,12 @@ void co_slirp_mutex_unlock (void)
 	ReleaseMutex(slirp_mutex);
 }
 
+int co_slirp_reactor_fd (co_reactor_t reactor)
+{
+	/* Waitable handles don't mix with select() on sockets */
+	return -1;
+}
+
 int main(int argc, char *argv[])
 {
 	co_rc_t rc;
@@ -198,6 +198,12 @@ static co_rc_t co_winnt_main(int argc, char *args[])
 		return CO_RC(ERROR);
 	}
 
+	if (start_parameters.balloon_specified)
+		return co_daemon_balloon(&start_parameters);
+
+	if (start_parameters.counters_specified)
+		return co_daemon_counters(&start_parameters);
+
 	if (winnt_parameters.status_driver) {
 		return co_winnt_status_driver(1); // arg 1 = View all driver details
 	}
@@ -92,6 +92,23 @@ void co_set_terminal_print_hook(co_terminal_print_hook_func_t func)
 	terminal_print_hook = func;
 }
 
+void co_terminal_clear(void)
+{
+	HANDLE output;
+	CONSOLE_SCREEN_BUFFER_INFO info;
+	COORD home = {0, 0};
+	DWORD written, cells;
+
+	output = GetStdHandle(STD_OUTPUT_HANDLE);
+	if (output == INVALID_HANDLE_VALUE  ||  !GetConsoleScreenBufferInfo(output, &info))
+		return;
+
+	cells = info.dwSize.X * info.dwSize.Y;
+	FillConsoleOutputCharacter(output, ' ', cells, home, &written);
+	FillConsoleOutputAttribute(output, info.wAttributes, cells, home, &written);
+	SetConsoleCursorPosition(output, home);
+}
+
 bool_t co_winnt_get_last_error(char *error_message, int buf_size)
 {
 	DWORD dwLastError = GetLastError();
@@ -6,6 +6,25 @@
 
 #include "reactor.h"
 
+/* Users' events are collected on each select, nothing to register */
+
+co_rc_t co_os_reactor_create(co_reactor_t handle)
+{
+	return CO_RC(OK);
+}
+
+void co_os_reactor_add(co_reactor_t handle, co_reactor_user_t user)
+{
+}
+
+void co_os_reactor_remove(co_reactor_t handle, co_reactor_user_t user)
+{
+}
+
+void co_os_reactor_destroy(co_reactor_t handle)
+{
+}
+
 co_rc_t co_os_reactor_select(co_reactor_t handle, int miliseconds)
 {
 	HANDLE wait_list[handle->num_users*2];
@@ -0,0 +1,59 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * Dan Aloni <da-x@colinux.org>, 2003 (c)
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#include <windows.h>
+
+#include <colinux/os/alloc.h>
+#include <colinux/os/user/thread.h>
+
+struct co_os_thread {
+	HANDLE handle;
+	co_os_thread_func_t func;
+	void *data;
+};
+
+static DWORD WINAPI thread_start(LPVOID param)
+{
+	co_os_thread_t thread = (co_os_thread_t)param;
+
+	thread->func(thread->data);
+
+	return 0;
+}
+
+co_rc_t co_os_thread_create(co_os_thread_func_t func, void *data, co_os_thread_t *thread_out)
+{
+	co_os_thread_t thread;
+	DWORD thread_id;
+
+	thread = co_os_malloc(sizeof(*thread));
+	if (!thread)
+		return CO_RC(OUT_OF_MEMORY);
+
+	thread->func = func;
+	thread->data = data;
+
+	thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, &thread_id);
+	if (!thread->handle) {
+		co_os_free(thread);
+		return CO_RC(ERROR);
+	}
+
+	*thread_out = thread;
+
+	return CO_RC(OK);
+}
+
+void co_os_thread_join(co_os_thread_t thread)
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	co_os_free(thread);
+}
@@ -88,3 +88,8 @@ void co_os_get_timestamp(co_timestamp_t *dts)
 	dts->high = PerformanceCounter.HighPart;
 	dts->low = PerformanceCounter.LowPart;
 }
+
+void co_os_msleep(unsigned int msecs)
+{
+	Sleep(msecs);
+}
@@ -1208,22 +1208,57 @@ static co_rc_t parse_args_config_color(co_command_line_params_t cmdline,
 	return CO_RC(OK);
 }
 
+/* mem=<size in MB>, mem=lazy or mem=<size in MB>,lazy */
+static co_rc_t parse_args_config_mem(co_command_line_params_t cmdline, co_config_t* conf)
+{
+	bool_t exists;
+	char   buf[32];
+	char*  param;
+	co_rc_t rc;
+
+	rc = co_cmdline_get_next_equality(cmdline, "mem", 0, NULL, 0,
+					  buf, sizeof(buf), &exists);
+	if (!CO_OK(rc))
+		return rc;
+
+	if (!exists)
+		return CO_RC(OK);
+
+	param = buf;
+	if (co_strncmp(param, "lazy", 4) != 0) {
+		conf->ram_size = strtoul(buf, &param, 10);
+		if (param == buf) {
+			co_terminal_print("error: invalid memory size '%s'\n", buf);
+			return CO_RC(INVALID_PARAMETER);
+		}
+		co_debug_info("configuring %u MB of virtual RAM", conf->ram_size);
+
+		if (*param == ',')
+			param++;
+	}
+
+	if (strcmp(param, "lazy") == 0) {
+		conf->ram_lazy = PTRUE;
+		co_debug_info("virtual RAM is allocated lazily");
+	} else if (*param) {
+		co_terminal_print("error: mem option only allows a size in MB"
+				  " and 'lazy'\n");
+		return CO_RC(INVALID_PARAMETER);
+	}
+
+	return CO_RC(OK);
+}
+
 /* Parse config file specific parameters */
 static co_rc_t parse_config_args(co_command_line_params_t cmdline, co_config_t* conf)
 {
 	co_rc_t rc;
 	bool_t  exists;
 
-	rc = co_cmdline_get_next_equality_int_value(cmdline,
-						    "mem",
-						    &conf->ram_size,
-						    &exists);
+	rc = parse_args_config_mem(cmdline, conf);
 	if (!CO_OK(rc))
 		return rc;
 
-	if (exists)
-		co_debug_info("configuring %u MB of virtual RAM", conf->ram_size);
-
 #ifdef CONFIG_COOPERATIVE_VIDEO
 	rc = parse_args_config_video(cmdline, conf);
 	if (!CO_OK(rc))
@@ -10,9 +10,16 @@ user_daemon_t::user_daemon_t()
 	monitor_handle = 0;
 	param_index = 0;
 	param_instance = 0;
+	send_batch_used = 0;
+
+	send_batch = (unsigned char *)co_os_malloc(CO_DAEMON_SEND_BATCH_SIZE);
+	if (!send_batch) {
+		throw user_daemon_exception_t(CO_RC(OUT_OF_MEMORY));
+	}
 
 	rc = co_reactor_create(&reactor);
 	if (!CO_OK(rc)) {
+		co_os_free(send_batch);
 		throw user_daemon_exception_t(rc);
 	}
 }
@@ -138,7 +145,7 @@ void user_daemon_t::run(int argc, char *argv[])
 
 	while (1) {
 		co_rc_t rc;
-		rc = co_reactor_select(reactor, 10);
+		rc = co_reactor_select(reactor, -1);
 		if (!CO_OK(rc))
 			break;
 	}
@@ -155,29 +162,66 @@ void user_daemon_t::send_to_monitor(co_message_t *message)
 
 void user_daemon_t::send_to_monitor_raw(co_device_t device, unsigned char *buffer, unsigned long size)
 {
-	struct {
-		co_message_t message;
-		co_linux_message_t msg_linux;
-		char data[];
-	} *message;
+	unsigned char *data;
 
-	message = (typeof(message))co_os_malloc(sizeof(*message) + size);
-	if (!message)
+	data = get_send_slot(device, size);
+	if (!data)
 		return;
 
+	co_memcpy(data, buffer, size);
+	commit_send_slot(size);
+	flush_send_slots();
+}
+
+/*
+ * Return where up to max_size bytes of payload for 'device' can be put,
+ * e.g. directly by read(), with the message headers already in front.
+ * Nothing is sent before commit_send_slot() and flush_send_slots(), so
+ * several messages can be collected and go to the monitor together.
+ */
+unsigned char *user_daemon_t::get_send_slot(co_device_t device, unsigned long max_size,
+					    co_message_type_t type)
+{
+	user_daemon_message_t *message;
+
+	if (sizeof(*message) + max_size > CO_DAEMON_SEND_BATCH_SIZE)
+		return NULL;
+
+	if (send_batch_used + sizeof(*message) + max_size > CO_DAEMON_SEND_BATCH_SIZE)
+		flush_send_slots();
+
+	message = (user_daemon_message_t *)&send_batch[send_batch_used];
 	message->message.from = (co_module_t)(get_base_module() + param_index);
 	message->message.to = CO_MODULE_LINUX;
 	message->message.priority = CO_PRIORITY_DISCARDABLE;
-	message->message.type = CO_MESSAGE_TYPE_OTHER;
-	message->message.size = sizeof(message->msg_linux) + size;
+	message->message.type = type;
 	message->msg_linux.device = device;
 	message->msg_linux.unit = (int)param_index;
+
+	return message->data;
+}
+
+void user_daemon_t::commit_send_slot(unsigned long size)
+{
+	user_daemon_message_t *message;
+
+	message = (user_daemon_message_t *)&send_batch[send_batch_used];
+	message->message.size = sizeof(message->msg_linux) + size;
 	message->msg_linux.size = size;
-	co_memcpy(message->data, buffer, size);
 
-	send_to_monitor(&message->message);
+	send_batch_used += sizeof(*message) + size;
+}
+
+void user_daemon_t::flush_send_slots()
+{
+	if (send_batch_used == 0)
+		return;
+
+	if (monitor_handle)
+		monitor_handle->reactor_user->send(monitor_handle->reactor_user,
+						   send_batch, send_batch_used);
 
-	co_os_free(message);
+	send_batch_used = 0;
 }
 
 void user_daemon_t::prepare_for_loop()
@@ -218,4 +262,5 @@ void user_daemon_t::log(const char *format, ...)
 user_daemon_t::~user_daemon_t()
 {
 	co_reactor_destroy(reactor);
+	co_os_free(send_batch);
 }
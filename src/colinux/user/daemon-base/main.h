@@ -24,6 +24,18 @@ extern "C" {
 #include <colinux/common/libc.h>
 }
 
+/*
+ * Messages to the monitor can be laid out back to back in this buffer,
+ * to go out with a single send(), see get_send_slot().
+ */
+#define CO_DAEMON_SEND_BATCH_SIZE	0x40000
+
+typedef struct {
+	co_message_t message;
+	co_linux_message_t msg_linux;
+	unsigned char data[];
+} user_daemon_message_t;
+
 class user_daemon_exception_t {
 public:
 	co_rc_t rc;
@@ -51,6 +63,10 @@ public:
 	virtual void syntax();
 	virtual void prepare_for_loop();
 	virtual void send_to_monitor_raw(co_device_t device, unsigned char *buffer, unsigned long size);
+	virtual unsigned char *get_send_slot(co_device_t device, unsigned long max_size,
+					     co_message_type_t type = CO_MESSAGE_TYPE_OTHER);
+	virtual void commit_send_slot(unsigned long size);
+	virtual void flush_send_slots();
 
 protected:
 	co_reactor_t reactor;
@@ -58,6 +74,9 @@ protected:
 	unsigned int param_index;
 	co_id_t param_instance;
 
+	unsigned char *send_batch;
+	unsigned long send_batch_used;
+
 };
 
 #endif
@@ -19,6 +19,7 @@
 #include <colinux/os/timer.h>
 #include <colinux/user/macaddress.h>
 #include <colinux/user/debug.h>
+#include <colinux/user/names.h>
 
 #include <memory.h>
 #include <stdarg.h>
@@ -71,11 +72,17 @@ void co_daemon_syntax(void)
 	co_terminal_print("syntax: \n");
 	co_terminal_print("\n");
 	co_terminal_print("    colinux-daemon [-d] [-h] [k] [-t name] [-v level] [configuration and boot parameter] @params.txt\n");
+	co_terminal_print("    colinux-daemon -b [id:]size\n");
+	co_terminal_print("    colinux-daemon -s [id:]seconds\n");
 	co_terminal_print("\n");
+	co_terminal_print("  -b [id:]size   Have a running coLinux give size MB of its RAM back to\n");
+	co_terminal_print("                 the host, 0 takes it all back (default id: first running)\n");
 	co_terminal_print("  -d             Don't launch and attach a coLinux console on startup\n");
 	co_terminal_print("  -h             Show this help text\n");
 	co_terminal_print("  -k             Suppress kernel messages\n");
 	co_terminal_print("  -p pidfile     Write pid to file.\n");
+	co_terminal_print("  -s [id:]secs   Show the counters of a running coLinux, refreshed every\n");
+	co_terminal_print("                 secs seconds (default id: first running)\n");
 	co_terminal_print("  -t name        When spawning a console, this is the type of console\n");
 	co_terminal_print("                 (e.g, nt, fltk, etc...)\n");
 	co_terminal_print("  -v level       Verbose messages, level 1 prints booting details, 2 or\n");
@@ -135,6 +142,20 @@ co_rc_t co_daemon_parse_args(co_command_line_params_t cmdline, co_start_paramete
 	if (!CO_OK(rc))
 		return rc;
 
+	rc = co_cmdline_params_one_arugment_parameter(cmdline, "-b",
+						      &start_parameters->balloon_specified,
+						      start_parameters->balloon,
+						      sizeof(start_parameters->balloon));
+	if (!CO_OK(rc))
+		return rc;
+
+	rc = co_cmdline_params_one_arugment_parameter(cmdline, "-s",
+						      &start_parameters->counters_specified,
+						      start_parameters->counters,
+						      sizeof(start_parameters->counters));
+	if (!CO_OK(rc))
+		return rc;
+
 	rc = co_cmdline_params_argumentless_parameter(cmdline, "-d", &dont_launch_console);
 
 	if (!CO_OK(rc))
@@ -173,6 +194,235 @@ co_rc_t co_daemon_parse_args(co_command_line_params_t cmdline, co_start_paramete
 	return CO_RC(OK);
 }
 
+co_rc_t co_daemon_balloon(co_start_parameters_t* start_parameters)
+{
+	co_manager_ioctl_attach_t  attach = {0, };
+	co_monitor_ioctl_balloon_t balloon;
+	co_manager_handle_t	   handle;
+	char*			   size_str = start_parameters->balloon;
+	char*			   colon;
+	char*			   end;
+	co_rc_t			   rc;
+
+	colon = strchr(size_str, ':');
+	if (colon) {
+		attach.id = strtoul(size_str, &end, 10);
+		if (end != colon) {
+			co_terminal_print("daemon: invalid balloon id '%s'\n", size_str);
+			return CO_RC(INVALID_PARAMETER);
+		}
+		size_str = colon + 1;
+	} else {
+		attach.id = find_first_monitor();
+		if (attach.id == CO_INVALID_ID) {
+			co_terminal_print("daemon: no running coLinux found\n");
+			return CO_RC(ERROR);
+		}
+	}
+
+	balloon.target_mb = strtoul(size_str, &end, 10);
+	if (end == size_str  ||  *end != '\0') {
+		co_terminal_print("daemon: invalid balloon size '%s'\n", size_str);
+		return CO_RC(INVALID_PARAMETER);
+	}
+
+	handle = co_os_manager_open();
+	if (!handle)
+		return CO_RC(ERROR_ACCESSING_DRIVER);
+
+	rc = co_manager_attach(handle, &attach);
+	if (CO_OK(rc))
+		rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_BALLOON,
+						   &balloon.pc, sizeof(balloon));
+	co_os_manager_close(handle);
+
+	if (CO_RC_GET_CODE(rc) == CO_RC_HOSTMEM_USE_LIMIT_REACHED) {
+		co_terminal_print("daemon: not enough host memory to shrink the balloon\n");
+		return rc;
+	}
+
+	if (!CO_OK(rc)) {
+		co_terminal_print("daemon: error setting balloon of coLinux %d (rc %x)\n",
+				  (int)attach.id, (int)rc);
+		return rc;
+	}
+
+	co_terminal_print("daemon: coLinux %d balloon set to %ld MB (holds %ld MB)\n",
+			  (int)attach.id, balloon.target_mb, balloon.size_mb);
+
+	return CO_RC(OK);
+}
+
+/* Per second rate of a counter between two samples */
+static unsigned long long counter_rate(unsigned long long now, unsigned long long before,
+				       unsigned long long ticks, unsigned long long freq)
+{
+	if (ticks == 0)
+		return 0;
+
+	return (now - before) * freq / ticks;
+}
+
+static void print_counters(co_id_t id, unsigned long interval,
+			   co_monitor_ioctl_status_t* status,
+			   co_monitor_ioctl_counters_t* now,
+			   co_monitor_ioctl_counters_t* before)
+{
+	co_monitor_counters_t* c = &now->counters;
+	co_monitor_counters_t* p = &before->counters;
+	unsigned long long     ticks = now->timestamp - before->timestamp;
+	unsigned long long     freq = now->freq;
+	char		       name[0x20];
+	int		       i;
+
+	co_terminal_clear();
+	co_terminal_print("coLinux %d, every %ld seconds (Ctrl-C quits)\n\n",
+			  (int)id, interval);
+
+	co_terminal_print("RAM:      %ld MB, %ld pages resident, peak %ld, balloon %ld pages\n",
+			  status->memory_size >> 20, status->resident_pages,
+			  status->resident_pages_peak, status->balloon_pages);
+	co_terminal_print("Queue:    %ld messages waiting for Linux, peak %ld, at most %ld per switch\n",
+			  now->linux_queue_size, c->linux_queue_peak, c->io_buffer_peak);
+	co_terminal_print("Failed:   %ld page, %ld message, %ld host allocations\n\n",
+			  status->pages_alloc_failed, c->message_alloc_failed, c->malloc_failed);
+
+	co_terminal_print("%-24s %14s %10s\n", "Switches", "total", "per sec");
+	for (i = 0; i < CO_OPERATION_MAX; i++) {
+		if (!c->switches[i])
+			continue;
+		co_terminal_print("  %-22s %14llu %10llu\n", co_operation_name(i), c->switches[i],
+				  counter_rate(c->switches[i], p->switches[i], ticks, freq));
+	}
+	for (i = 0; i < CO_DEVICES_TOTAL; i++) {
+		if (!c->device_requests[i])
+			continue;
+		co_terminal_print("  DEVICE %-15s %14llu %10llu\n", co_device_name(i), c->device_requests[i],
+				  counter_rate(c->device_requests[i], p->device_requests[i], ticks, freq));
+	}
+	co_terminal_print("  %-22s %14llu %10llu\n", "interrupts to Linux", c->linux_interrupts,
+			  counter_rate(c->linux_interrupts, p->linux_interrupts, ticks, freq));
+
+	co_terminal_print("\n%-24s %14s %10s %14s %10s\n", "Messages", "to Linux", "per sec",
+			  "from Linux", "per sec");
+	for (i = 0; i < CO_MODULES_MAX; i++) {
+		if (!c->messages_to_linux[i]  &&  !c->messages_from_linux[i])
+			continue;
+		co_module_name(i, name, sizeof(name));
+		co_terminal_print("  %-22s %14llu %10llu %14llu %10llu\n", name,
+				  c->messages_to_linux[i],
+				  counter_rate(c->messages_to_linux[i], p->messages_to_linux[i], ticks, freq),
+				  c->messages_from_linux[i],
+				  counter_rate(c->messages_from_linux[i], p->messages_from_linux[i], ticks, freq));
+	}
+
+	co_terminal_print("\n%-24s %14s %10s %14s %10s\n", "Block devices", "read MB", "KB/sec",
+			  "written MB", "KB/sec");
+	for (i = 0; i < CO_MODULE_MAX_COBD; i++) {
+		if (!c->block_read_bytes[i]  &&  !c->block_write_bytes[i])
+			continue;
+		co_terminal_print("  cobd%-18d %14llu %10llu %14llu %10llu\n", i,
+				  c->block_read_bytes[i] >> 20,
+				  counter_rate(c->block_read_bytes[i], p->block_read_bytes[i], ticks, freq) >> 10,
+				  c->block_write_bytes[i] >> 20,
+				  counter_rate(c->block_write_bytes[i], p->block_write_bytes[i], ticks, freq) >> 10);
+	}
+}
+
+co_rc_t co_daemon_counters(co_start_parameters_t* start_parameters)
+{
+	co_manager_ioctl_attach_t    attach = {0, };
+	co_monitor_ioctl_status_t    status;
+	co_monitor_ioctl_counters_t* now;
+	co_monitor_ioctl_counters_t* before;
+	co_manager_handle_t	     handle;
+	char*			     seconds_str = start_parameters->counters;
+	char*			     colon;
+	char*			     end;
+	unsigned long		     seconds;
+	co_rc_t			     rc;
+
+	colon = strchr(seconds_str, ':');
+	if (colon) {
+		attach.id = strtoul(seconds_str, &end, 10);
+		if (end != colon) {
+			co_terminal_print("daemon: invalid monitor id '%s'\n", seconds_str);
+			return CO_RC(INVALID_PARAMETER);
+		}
+		seconds_str = colon + 1;
+	} else {
+		attach.id = find_first_monitor();
+		if (attach.id == CO_INVALID_ID) {
+			co_terminal_print("daemon: no running coLinux found\n");
+			return CO_RC(ERROR);
+		}
+	}
+
+	seconds = strtoul(seconds_str, &end, 10);
+	if (end == seconds_str  ||  *end != '\0'  ||  seconds == 0) {
+		co_terminal_print("daemon: invalid refresh time '%s'\n", seconds_str);
+		return CO_RC(INVALID_PARAMETER);
+	}
+
+	now    = co_os_malloc(sizeof(*now));
+	before = co_os_malloc(sizeof(*before));
+	if (!now  ||  !before) {
+		rc = CO_RC(OUT_OF_MEMORY);
+		goto out_free;
+	}
+
+	handle = co_os_manager_open();
+	if (!handle) {
+		rc = CO_RC(ERROR_ACCESSING_DRIVER);
+		goto out_free;
+	}
+
+	rc = co_manager_attach(handle, &attach);
+	if (!CO_OK(rc)) {
+		co_terminal_print("daemon: error attaching to coLinux %d (rc %x)\n",
+				  (int)attach.id, (int)rc);
+		goto out_close;
+	}
+
+	rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_COUNTERS,
+					   &before->pc, sizeof(*before));
+
+	/* Until the monitor goes away */
+	while (CO_OK(rc)) {
+		co_monitor_ioctl_counters_t* swap;
+
+		co_os_msleep(seconds * 1000);
+
+		rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_STATUS,
+						   &status.pc, sizeof(status));
+		if (!CO_OK(rc))
+			break;
+
+		rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_COUNTERS,
+						   &now->pc, sizeof(*now));
+		if (!CO_OK(rc))
+			break;
+
+		print_counters(attach.id, seconds, &status, now, before);
+
+		swap   = before;
+		before = now;
+		now    = swap;
+	}
+
+	co_terminal_print("daemon: coLinux %d is gone\n", (int)attach.id);
+	rc = CO_RC(OK);
+
+out_close:
+	co_os_manager_close(handle);
+out_free:
+	if (before)
+		co_os_free(before);
+	if (now)
+		co_os_free(now);
+	return rc;
+}
+
 static void init_srand(void)
 {
 	co_timestamp_t t;
@@ -831,6 +1081,48 @@ static co_rc_t co_daemon_restart(co_daemon_t* daemon)
 	return rc;
 }
 
+/*
+ * Longest a blocked reactor thread takes to notice it should stop.
+ */
+#define CO_DAEMON_REACTOR_TIMEOUT 500
+
+/*
+ * reactor_running is cleared by the main thread while the reactor thread
+ * polls it; both sides go through these so the store is seen.
+ */
+#define co_daemon_reactor_running(daemon) \
+	__sync_fetch_and_add(&(daemon)->reactor_running, 0)
+#define co_daemon_reactor_stop(daemon) \
+	__sync_bool_compare_and_swap(&(daemon)->reactor_running, PTRUE, PFALSE)
+
+/*
+ * Services printk and control messages while the main thread stays in
+ * the monitor run ioctl, so that neither waits for the other.
+ */
+static void co_daemon_reactor_thread(void *data)
+{
+	co_daemon_t* daemon = (co_daemon_t*)data;
+	co_rc_t      rc;
+
+	while (co_daemon_reactor_running(daemon)) {
+		rc = co_reactor_select(daemon->reactor, CO_DAEMON_REACTOR_TIMEOUT);
+		if (!CO_OK(rc)) {
+			co_debug("reactor thread stopped (rc=%x)", (int)rc);
+			break;
+		}
+	}
+}
+
+static void co_daemon_stop_reactor_thread(co_daemon_t* daemon)
+{
+	if (!daemon->reactor_thread)
+		return;
+
+	co_daemon_reactor_stop(daemon);
+	co_os_thread_join(daemon->reactor_thread);
+	daemon->reactor_thread = NULL;
+}
+
 co_rc_t co_daemon_run(co_daemon_t* daemon)
 {
 	co_rc_t			rc;
@@ -843,6 +1135,8 @@ co_rc_t co_daemon_run(co_daemon_t* daemon)
 	if (!CO_OK(rc))
 		return rc;
 
+	daemon->reactor = reactor;
+
 	co_terminal_print("PID: %d\n", (int)daemon->id);
 
 	rc = co_user_monitor_open(reactor,
@@ -896,6 +1190,15 @@ co_rc_t co_daemon_run(co_daemon_t* daemon)
 	if (!CO_OK(rc))
 		goto out;
 
+	/* Without a reactor thread, poll between monitor runs as before */
+	daemon->reactor_running = PTRUE;
+	rc = co_os_thread_create(co_daemon_reactor_thread, daemon, &daemon->reactor_thread);
+	if (!CO_OK(rc)) {
+		co_debug("no reactor thread, polling from the run loop");
+		daemon->reactor_running = PFALSE;
+		daemon->reactor_thread = NULL;
+	}
+
 	co_terminal_print("colinux: booting\n");
 
 	daemon->next_reboot_will_shutdown = PFALSE;
@@ -912,7 +1215,8 @@ co_rc_t co_daemon_run(co_daemon_t* daemon)
 			rc = co_user_monitor_run(daemon->monitor, &params);
 			if (!CO_OK(rc))
 				break;
-			co_reactor_select(reactor, 0);
+			if (!daemon->reactor_thread)
+				co_reactor_select(reactor, 0);
 		}
 
 		if (CO_RC_GET_CODE(rc) == CO_RC_INSTANCE_TERMINATED) {
@@ -985,11 +1289,15 @@ co_rc_t co_daemon_run(co_daemon_t* daemon)
 		}
 	} while (restarting);
 
+	co_daemon_stop_reactor_thread(daemon);
+
 	co_daemon_kill_executes(daemon);
 
 	co_user_monitor_close(daemon->message_monitor);
 
 out:
+	co_daemon_stop_reactor_thread(daemon);
+
 	if (start_parameters->pidfile_specified) {
 		co_rc_t rc1;
 
@@ -14,6 +14,7 @@
 #include <colinux/common/config.h>
 #include <colinux/common/messages.h>
 #include <colinux/common/console.h>
+#include <colinux/os/user/thread.h>
 
 #include "elf_load.h"
 #include "monitor.h"
@@ -33,6 +34,10 @@ typedef struct co_daemon_start_parameters {
 	bool_t pidfile_specified;
 	co_pathname_t pidfile;
 	int network_types;
+	bool_t balloon_specified;
+	char balloon[0x20];
+	bool_t counters_specified;
+	char counters[0x20];
 } co_start_parameters_t;
 
 typedef struct co_daemon {
@@ -42,6 +47,9 @@ typedef struct co_daemon {
 	co_elf_data_t *elf_data;
 	co_user_monitor_t *monitor;
 	co_user_monitor_t *message_monitor;
+	co_reactor_t reactor;
+	co_os_thread_t reactor_thread;
+	bool_t reactor_running; /* shared with reactor_thread, see daemon.c */
 	bool_t running;
 	bool_t idle;
 	char *buf;
@@ -66,5 +74,7 @@ extern void co_daemon_end_monitor(co_daemon_t *daemon);
 extern void co_daemon_destroy(co_daemon_t *daemon);
 extern void co_daemon_send_shutdown(co_daemon_t *daemon);
 extern co_rc_t co_daemon_parse_args(co_command_line_params_t cmdline, co_start_parameters_t *start_parameters);
+extern co_rc_t co_daemon_balloon(co_start_parameters_t *start_parameters);
+extern co_rc_t co_daemon_counters(co_start_parameters_t *start_parameters);
 
 #endif
@@ -12,14 +12,18 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <time.h>
 
 #include <colinux/os/alloc.h>
 #include <colinux/os/timer.h>
 #include <colinux/os/user/misc.h>
 #include <colinux/user/manager.h>
 #include <colinux/user/cmdline.h>
+#include <colinux/user/monitor.h>
+#include <colinux/user/names.h>
 #include <colinux/common/libc.h>
 
 #define BUFFER_SIZE   (0x100000)
@@ -35,6 +39,9 @@ typedef struct co_debug_parameters {
 	char network_server[0x100];
 	bool_t rc_specified;
 	char rc_str[20];
+	bool_t memory_mode;
+	bool_t trace_specified;
+	char trace[0x20];
 } co_debug_parameters_t;
 
 static co_debug_parameters_t parameters;
@@ -43,57 +50,59 @@ static FILE *output_file;
 
 static void sig_handle(int signo);	/* Forward declaration */
 
-static void co_debug_download(void)
+typedef void (*log_func_t)(void *data, char *block, unsigned long size);
+
+/* Read the log right from the rings of the driver, mapped into us */
+static co_rc_t read_log_rings(co_manager_handle_t handle, log_func_t func, void *data)
 {
-	co_manager_handle_t handle;
+	co_manager_ioctl_debug_rings_t rings;
 	co_rc_t rc;
+	int i;
 
-	handle = co_os_manager_open();
-	if (handle) {
-		char *buffer = co_os_malloc(BUFFER_SIZE);
-		if (buffer) {
-			co_manager_ioctl_debug_reader_t debug_reader;
-			debug_reader.user_buffer = buffer;
-			debug_reader.user_buffer_size = BUFFER_SIZE;
-			while (1) {
-				debug_reader.filled = 0;
-				rc = co_manager_debug_reader(handle, &debug_reader);
-				if (!CO_OK(rc)) {
-					fprintf(stderr, "log ended: %x\n", (int)rc);
-					break;
-				}
-
-				fwrite(buffer, 1, debug_reader.filled, output_file);
+	co_memset(&rings, 0, sizeof(rings));
+	rings.map = PTRUE;
+	rc = co_manager_debug_rings(handle, &rings);
+	if (!CO_OK(rc))
+		return rc;
+
+	rings.map = PFALSE;
+	do {
+		for (i = 0; i < rings.count; i++) {
+			co_debug_ring_record_t *record;
+			unsigned long size;
+
+			while ((record = co_debug_ring_peek(rings.user_address[i], rings.tail[i],
+							    rings.head[i], &size)) != NULL) {
+				if (!(record->size & CO_DEBUG_RING_PAD))
+					func(data, record->data, size - sizeof(*record));
+				rings.tail[i] += CO_DEBUG_RING_ALIGN(size);
 			}
-			co_os_free(buffer);
 		}
-		co_os_manager_close(handle);
-	}
 
-}
+		/* Flush every block, if stdout not redirected */
+		if (output_file != stdout)
+			fflush (output_file);
 
-static void co_debug_download_to_network(void)
-{
-	co_manager_handle_t handle;
-	co_rc_t rc;
-	int sock;
-	int port = 63000;
+		/* Gives the records back and waits for more */
+		rc = co_manager_debug_rings(handle, &rings);
+	} while (CO_OK(rc));
 
-	fprintf(stderr, "sending UDP packets to %s:%d\n", parameters.network_server, port);
+	fprintf(stderr, "log ended: %x\n", (int)rc);
 
-	sock = co_udp_socket_connect(parameters.network_server, port);
-	if (sock == -1)
-		return;
+	return CO_RC(OK);
+}
 
-	handle = co_os_manager_open();
-	if (!handle)
-		goto error_out1;
+/* Drivers that can't map the rings copy the log out */
+static void read_log_copied(co_manager_handle_t handle, log_func_t func, void *data)
+{
+	co_manager_ioctl_debug_reader_t debug_reader;
+	char *buffer;
+	co_rc_t rc;
 
-	char *buffer = co_os_malloc(BUFFER_SIZE);
+	buffer = co_os_malloc(BUFFER_SIZE);
 	if (!buffer)
-		goto error_out2;
+		return;
 
-	co_manager_ioctl_debug_reader_t debug_reader;
 	debug_reader.user_buffer = buffer;
 	debug_reader.user_buffer_size = BUFFER_SIZE;
 	while (1) {
@@ -104,26 +113,72 @@ static void co_debug_download_to_network(void)
 			break;
 		}
 
-		co_debug_tlv_t *tlv;
-		unsigned long size = debug_reader.filled;
-		char *block = debug_reader.user_buffer;
-
-		while (size > 0) {
-			tlv = (co_debug_tlv_t *)block;
-			if (size < sizeof(*tlv))
-				goto error_out3;
+		func(data, buffer, debug_reader.filled);
 
-			co_udp_socket_send(sock, (char *)tlv, tlv->length + sizeof(*tlv));
-
-			block += sizeof(*tlv) + tlv->length;
-			size -= sizeof(*tlv) + tlv->length;
-		}
+		/* Flush every block, if stdout not redirected */
+		if (output_file != stdout)
+			fflush (output_file);
 	}
-error_out3:
+
 	co_os_free(buffer);
-error_out2:
+}
+
+static void read_log(log_func_t func, void *data)
+{
+	co_manager_handle_t handle;
+	co_rc_t rc;
+
+	handle = co_os_manager_open();
+	if (!handle)
+		return;
+
+	rc = read_log_rings(handle, func, data);
+	if (!CO_OK(rc))
+		read_log_copied(handle, func, data);
+
 	co_os_manager_close(handle);
-error_out1:
+}
+
+static void write_block(void *data, char *block, unsigned long size)
+{
+	fwrite(block, 1, size, output_file);
+}
+
+static void co_debug_download(void)
+{
+	read_log(write_block, NULL);
+}
+
+static void send_block(void *data, char *block, unsigned long size)
+{
+	int sock = *(int *)data;
+	co_debug_tlv_t *tlv;
+
+	while (size >= sizeof(*tlv)) {
+		tlv = (co_debug_tlv_t *)block;
+		if (size < sizeof(*tlv) + tlv->length)
+			return;
+
+		co_udp_socket_send(sock, (char *)tlv, tlv->length + sizeof(*tlv));
+
+		block += sizeof(*tlv) + tlv->length;
+		size -= sizeof(*tlv) + tlv->length;
+	}
+}
+
+static void co_debug_download_to_network(void)
+{
+	int sock;
+	int port = 63000;
+
+	fprintf(stderr, "sending UDP packets to %s:%d\n", parameters.network_server, port);
+
+	sock = co_udp_socket_connect(parameters.network_server, port);
+	if (sock == -1)
+		return;
+
+	read_log(send_block, &sock);
+
 	co_udp_socket_close(sock);
 }
 
@@ -286,38 +341,279 @@ static void co_debug_parse(int fd)
 	xml_end();
 }
 
+static void parse_block(void *data, char *block, unsigned long size)
+{
+	parse_tlv_buffer(block, size);
+}
+
 void co_debug_download_and_parse(void)
 {
-	co_manager_handle_t handle;
 	xml_start();
+	read_log(parse_block, NULL);
+	xml_end();
+}
+
+/* Pseudo physical RAM counters of every running monitor, in pages */
+static void co_debug_memory(void)
+{
+	co_manager_handle_t		handle;
+	co_manager_ioctl_monitor_list_t	list;
+	co_manager_ioctl_info_t		info;
+	co_rc_t				rc;
+	int				i;
 
 	handle = co_os_manager_open();
-	if (handle) {
-		char *buffer = co_os_malloc(BUFFER_SIZE);
-		if (buffer) {
-			co_manager_ioctl_debug_reader_t debug_reader;
-			debug_reader.user_buffer = buffer;
-			debug_reader.user_buffer_size = BUFFER_SIZE;
-			while (1) {
-				debug_reader.filled = 0;
-				co_rc_t rc = co_manager_debug_reader(handle, &debug_reader);
-				if (!CO_OK(rc)) {
-					fprintf(stderr, "log ended: %x\n", (int)rc);
-					return;
-				}
-
-				parse_tlv_buffer(buffer, debug_reader.filled);
-
-				/* Flush, if stdout not redirected */
-				if (output_file != stdout)
-					fflush (output_file);
-			}
-			co_os_free(buffer);
-		}
+	if (!handle) {
+		fprintf(stderr, "error opening manager\n");
+		return;
+	}
+
+	rc = co_manager_monitor_list(handle, &list);
+	if (CO_OK(rc))
+		rc = co_manager_info(handle, &info);
+	co_os_manager_close(handle);
+	if (!CO_OK(rc)) {
+		fprintf(stderr, "error listing monitors: %x\n", (int)rc);
+		return;
+	}
+
+	fprintf(output_file, "reversed PFN map: %ld pages\n\n", info.reversed_pages_used);
+
+	fprintf(output_file, "%-6s %-5s %7s %9s %9s %10s %10s %6s %9s\n",
+		"id", "mode", "MB", "resident", "peak",
+		"allocated", "freed", "failed", "balloon");
+
+	for (i = 0; i < list.count; i++) {
+		co_manager_ioctl_attach_t attach = {0, };
+		co_monitor_ioctl_status_t status;
+
+		handle = co_os_manager_open();
+		if (!handle)
+			return;
+
+		attach.id = list.ids[i];
+		rc = co_manager_attach(handle, &attach);
+		if (CO_OK(rc))
+			rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_STATUS,
+							   &status.pc, sizeof(status));
 		co_os_manager_close(handle);
+		if (!CO_OK(rc))
+			continue;
+
+		fprintf(output_file, "%-6d %-5s %7ld %9ld %9ld %10ld %10ld %6ld %9ld\n",
+			(int)list.ids[i],
+			status.memory_lazy ? "lazy" : "fixed",
+			status.memory_size >> 20,
+			status.resident_pages,
+			status.resident_pages_peak,
+			status.pages_allocated,
+			status.pages_freed,
+			status.pages_alloc_failed,
+			status.balloon_pages);
 	}
+}
 
-	xml_end();
+/*
+ * World switch trace: the host time spent serving each operation Linux
+ * switched back with, as histograms of power of two microseconds.
+ */
+#define TRACE_BUCKETS 22 /* up to 2^21 us, about 2s, and longer */
+#define TRACE_ROWS    (CO_OPERATION_MAX + CO_DEVICES_TOTAL)
+
+typedef struct {
+	unsigned long	   count;
+	unsigned long long total_us;
+	unsigned long long max_us;
+	unsigned long	   buckets[TRACE_BUCKETS];
+} trace_histogram_t;
+
+static void trace_print_histogram(const char *name, trace_histogram_t *h)
+{
+	unsigned long peak = 0;
+	int first = -1, last = 0;
+	int i;
+
+	for (i = 0; i < TRACE_BUCKETS; i++) {
+		if (!h->buckets[i])
+			continue;
+		if (first < 0)
+			first = i;
+		last = i;
+		if (h->buckets[i] > peak)
+			peak = h->buckets[i];
+	}
+
+	fprintf(output_file, "%s: %ld switches, avg %llu us, max %llu us\n",
+		name, h->count, h->total_us / h->count, h->max_us);
+
+	for (i = first; i <= last; i++) {
+		int bar = (int)((h->buckets[i] * 50 + peak - 1) / peak);
+
+		if (i == TRACE_BUCKETS - 1)
+			fprintf(output_file, "  >= %7lu us %9ld ", 1UL << (i - 1), h->buckets[i]);
+		else
+			fprintf(output_file, "  <  %7lu us %9ld ", 1UL << i, h->buckets[i]);
+		while (bar--)
+			fputc('#', output_file);
+		fputc('\n', output_file);
+	}
+	fputc('\n', output_file);
+}
+
+static void trace_account(trace_histogram_t *rows, co_monitor_trace_record_t *record,
+			  unsigned long long freq, unsigned long long *linux_us)
+{
+	trace_histogram_t *h;
+	unsigned long long us;
+	int bucket;
+
+	if (record->operation >= CO_OPERATION_MAX)
+		return;
+
+	if (record->operation == CO_OPERATION_DEVICE  &&  record->device < CO_DEVICES_TOTAL)
+		h = &rows[CO_OPERATION_MAX + record->device];
+	else
+		h = &rows[record->operation];
+
+	*linux_us += (record->switch_end - record->switch_start) * 1000000 / freq;
+
+	us = record->service_time * 1000000 / freq;
+	for (bucket = 0; bucket < TRACE_BUCKETS - 1; bucket++)
+		if (us < (1ULL << bucket))
+			break;
+
+	h->count++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+	h->buckets[bucket]++;
+}
+
+/* Trace the world switches of a monitor for some seconds */
+static void co_debug_trace(void)
+{
+	co_manager_ioctl_attach_t	attach = {0, };
+	co_monitor_ioctl_trace_t*	trace;
+	co_manager_handle_t		handle;
+	trace_histogram_t*		rows;
+	unsigned long long		linux_us = 0, service_us = 0;
+	unsigned long			next, lost = 0, seconds;
+	time_t				end;
+	char*				seconds_str = parameters.trace;
+	char*				colon;
+	char*				tail;
+	co_rc_t				rc;
+	int				i;
+
+	colon = strchr(seconds_str, ':');
+	if (colon) {
+		attach.id = strtoul(seconds_str, &tail, 10);
+		if (tail != colon) {
+			fprintf(stderr, "invalid monitor id '%s'\n", seconds_str);
+			return;
+		}
+		seconds_str = colon + 1;
+	} else {
+		attach.id = find_first_monitor();
+		if (attach.id == CO_INVALID_ID) {
+			fprintf(stderr, "no running coLinux found\n");
+			return;
+		}
+	}
+
+	seconds = strtoul(seconds_str, &tail, 10);
+	if (tail == seconds_str  ||  *tail != '\0'  ||  seconds == 0) {
+		fprintf(stderr, "invalid trace time '%s'\n", seconds_str);
+		return;
+	}
+
+	trace = co_os_malloc(sizeof(*trace));
+	rows = co_os_malloc(sizeof(*rows) * TRACE_ROWS);
+	if (!trace  ||  !rows)
+		goto out_free;
+	co_memset(rows, 0, sizeof(*rows) * TRACE_ROWS);
+
+	handle = co_os_manager_open();
+	if (!handle) {
+		fprintf(stderr, "error opening manager\n");
+		goto out_free;
+	}
+
+	rc = co_manager_attach(handle, &attach);
+	if (!CO_OK(rc)) {
+		fprintf(stderr, "error attaching to monitor %d: %x\n", (int)attach.id, (int)rc);
+		goto out_close;
+	}
+
+	/* Start tracing, from the records that come after now */
+	co_memset(trace, 0, sizeof(*trace));
+	trace->enable = 1;
+	trace->start  = 0;
+	rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_TRACE,
+					   &trace->pc, sizeof(*trace));
+	if (!CO_OK(rc)) {
+		fprintf(stderr, "error starting the trace: %x\n", (int)rc);
+		goto out_close;
+	}
+
+	next = trace->head;
+	end  = time(NULL) + seconds;
+
+	do {
+		trace->enable = -1;
+		trace->start  = next;
+		rc = co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_TRACE,
+						   &trace->pc, sizeof(*trace));
+		if (!CO_OK(rc))
+			break;
+
+		/* The driver wrapped around before we read them */
+		lost += trace->first - next;
+
+		for (i = 0; i < trace->count; i++)
+			trace_account(rows, &trace->records[i], trace->freq, &linux_us);
+		next = trace->first + trace->count;
+
+		/* Catch up without sleeping while the driver has more */
+		if (trace->count < CO_MONITOR_TRACE_CHUNK)
+			co_os_msleep(10);
+	} while (time(NULL) < end);
+
+	trace->enable = 0;
+	co_manager_io_monitor_unisize(handle, CO_MONITOR_IOCTL_TRACE,
+				      &trace->pc, sizeof(*trace));
+
+	for (i = 0; i < TRACE_ROWS; i++)
+		service_us += rows[i].total_us;
+
+	fprintf(output_file, "monitor %d, %ld seconds: %llu ms in Linux, %llu ms serving it",
+		(int)attach.id, seconds, linux_us / 1000, service_us / 1000);
+	if (lost)
+		fprintf(output_file, ", %ld switches not traced", lost);
+	fprintf(output_file, "\n\n");
+
+	for (i = 0; i < TRACE_ROWS; i++) {
+		char name[0x40];
+
+		if (!rows[i].count)
+			continue;
+
+		if (i < CO_OPERATION_MAX)
+			snprintf(name, sizeof(name), "%s", co_operation_name(i));
+		else
+			snprintf(name, sizeof(name), "DEVICE %s",
+				 co_device_name(i - CO_OPERATION_MAX));
+
+		trace_print_histogram(name, &rows[i]);
+	}
+
+out_close:
+	co_os_manager_close(handle);
+out_free:
+	if (rows)
+		co_os_free(rows);
+	if (trace)
+		co_os_free(trace);
 }
 
 typedef struct {
@@ -427,6 +723,15 @@ static co_rc_t co_debug_parse_args(co_command_line_params_t cmdline, co_debug_pa
 	if (!CO_OK(rc))
 		return rc;
 
+	rc = co_cmdline_params_argumentless_parameter(cmdline, "-m", &parameters->memory_mode);
+	if (!CO_OK(rc))
+		return rc;
+
+	rc = co_cmdline_params_one_arugment_parameter(cmdline, "-t", &parameters->trace_specified,
+						      parameters->trace, sizeof(parameters->trace));
+	if (!CO_OK(rc))
+		return rc;
+
 	return CO_RC(OK);
 }
 
@@ -435,7 +740,7 @@ static void syntax(void)
 	printf("colinux-debug-daemon\n");
 	printf("syntax: \n");
 	printf("\n");
-	printf("    colinux-debug-daemon [-d] [-f filename | -n ipaddress] [-p] [-s levels] | -e exitcode | -h\n");
+	printf("    colinux-debug-daemon [-d] [-f filename | -n ipaddress] [-p] [-s levels] | -e exitcode | -m | -t [id:]seconds | -h\n");
 	printf("\n");
 	printf("      -d              Download debug information on the fly from driver.\n");
 	printf("                      Without -d, uses standard input.\n");
@@ -447,6 +752,10 @@ static void syntax(void)
 	printf("      -n ipaddress    Send logs as UDP packets to ipaddress:63000\n");
 	printf("                      (requires -d)\n");
 	printf("      -e exitcode     Translate exitcode into human readable format.\n");
+	printf("      -m              Show the RAM usage of the running monitors.\n");
+	printf("      -t [id:]seconds Trace the world switches of a monitor (default the\n");
+	printf("                      first one) and show how long the host took to serve\n");
+	printf("                      each operation, as latency histograms.\n");
 	printf("      -h              This help text\n");
 	printf("\n");
 }
@@ -495,7 +804,11 @@ co_rc_t co_debug_main(int argc, char *argv[])
 	if (parameters.settings_change_specified)
 		co_update_settings();
 
-	if (parameters.download_mode  &&  parameters.network_server_specified) {
+	if (parameters.memory_mode) {
+		co_debug_memory();
+	} else if (parameters.trace_specified) {
+		co_debug_trace();
+	} else if (parameters.download_mode  &&  parameters.network_server_specified) {
 		co_debug_download_to_network();
 	} else if (parameters.download_mode  &&  parameters.parse_mode) {
 		co_debug_download_and_parse();
@@ -127,6 +127,20 @@ co_rc_t co_manager_debug_reader(co_manager_handle_t handle, co_manager_ioctl_deb
 	return debug_reader->rc;
 }
 
+co_rc_t co_manager_debug_rings(co_manager_handle_t handle, co_manager_ioctl_debug_rings_t *rings)
+{
+	co_rc_t rc;
+	unsigned long returned = 0;
+
+	rc = co_os_manager_ioctl(handle, CO_MANAGER_IOCTL_DEBUG_RINGS,
+				 rings, sizeof(*rings), rings, sizeof(*rings), &returned);
+
+	if (!CO_OK(rc))
+		return rc;
+
+	return rings->rc;
+}
+
 
 #ifdef COLINUX_DEBUG
 co_rc_t co_manager_debug_levels(co_manager_handle_t handle, co_manager_ioctl_debug_levels_t *levels)
@@ -36,6 +36,8 @@ extern void co_manager_debug(co_manager_handle_t handle,
 
 extern co_rc_t co_manager_debug_reader(co_manager_handle_t handle,
 				       co_manager_ioctl_debug_reader_t *debug_reader);
+extern co_rc_t co_manager_debug_rings(co_manager_handle_t handle,
+				      co_manager_ioctl_debug_rings_t *rings);
 
 #ifdef COLINUX_DEBUG
 extern co_rc_t co_manager_debug_levels(co_manager_handle_t handle,
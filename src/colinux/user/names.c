@@ -0,0 +1,107 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#include <colinux/common/libc.h>
+
+#include "names.h"
+
+static const char* operation_names[CO_OPERATION_MAX] = {
+	[CO_OPERATION_EMPTY]		    = "EMPTY",
+	[CO_OPERATION_START]		    = "START",
+	[CO_OPERATION_IDLE]		    = "IDLE",
+	[CO_OPERATION_TERMINATE]	    = "TERMINATE",
+	[CO_OPERATION_MESSAGE_TO_MONITOR]   = "MESSAGE_TO_MONITOR",
+	[CO_OPERATION_MESSAGE_FROM_MONITOR] = "MESSAGE_FROM_MONITOR",
+	[CO_OPERATION_FORWARD_INTERRUPT]    = "FORWARD_INTERRUPT",
+	[CO_OPERATION_DEVICE]		    = "DEVICE",
+	[CO_OPERATION_GET_TIME]		    = "GET_TIME",
+	[CO_OPERATION_DEBUG_LINE]	    = "DEBUG_LINE",
+	[CO_OPERATION_GET_HIGH_PREC_TIME]   = "GET_HIGH_PREC_TIME",
+	[CO_OPERATION_TRACE_POINT]	    = "TRACE_POINT",
+	[CO_OPERATION_FREE_PAGES]	    = "FREE_PAGES",
+	[CO_OPERATION_ALLOC_PAGES]	    = "ALLOC_PAGES",
+	[CO_OPERATION_PRINTK_unused]	    = "PRINTK",
+	[CO_OPERATION_GETPP]		    = "GETPP",
+};
+
+static const char* device_names[CO_DEVICES_TOTAL] = {
+	[CO_DEVICE_BLOCK]	= "block",
+	[CO_DEVICE_CONSOLE]	= "console",
+	[CO_DEVICE_KEYBOARD]	= "keyboard",
+	[CO_DEVICE_NETWORK]	= "network",
+	[CO_DEVICE_TIMER]	= "timer",
+	[CO_DEVICE_POWER]	= "power",
+	[CO_DEVICE_SERIAL]	= "serial",
+	[CO_DEVICE_FILESYSTEM]	= "filesystem",
+	[CO_DEVICE_MOUSE]	= "mouse",
+	[CO_DEVICE_SCSI]	= "scsi",
+	[CO_DEVICE_VIDEO]	= "video",
+	[CO_DEVICE_AUDIO]	= "audio",
+	[CO_DEVICE_PCI]		= "pci",
+	[CO_DEVICE_BALLOON]	= "balloon",
+};
+
+static const char* module_names[CO_MODULE_CONET0] = {
+	[CO_MODULE_LINUX]	  = "linux",
+	[CO_MODULE_MONITOR]	  = "monitor",
+	[CO_MODULE_DAEMON]	  = "daemon",
+	[CO_MODULE_IDLE]	  = "idle",
+	[CO_MODULE_KERNEL_SWITCH] = "kernel_switch",
+	[CO_MODULE_USER_SWITCH]	  = "user_switch",
+	[CO_MODULE_CONSOLE]	  = "console",
+	[CO_MODULE_PRINTK]	  = "printk",
+};
+
+static const struct {
+	unsigned long first, last;
+	const char*   name;
+} module_units[] = {
+	{ CO_MODULE_CONET0,   CO_MODULE_CONET_END,   "conet"   },
+	{ CO_MODULE_COBD0,    CO_MODULE_COBD_END,    "cobd"    },
+	{ CO_MODULE_COFS0,    CO_MODULE_COFS_END,    "cofs"    },
+	{ CO_MODULE_SERIAL0,  CO_MODULE_SERIAL_END,  "serial"  },
+	{ CO_MODULE_COSCSI0,  CO_MODULE_COSCSI_END,  "coscsi"  },
+	{ CO_MODULE_COVIDEO0, CO_MODULE_COVIDEO_END, "covideo" },
+	{ CO_MODULE_COAUDIO0, CO_MODULE_COAUDIO_END, "coaudio" },
+};
+
+const char* co_operation_name(unsigned long operation)
+{
+	if (operation >= CO_OPERATION_MAX  ||  !operation_names[operation])
+		return "?";
+
+	return operation_names[operation];
+}
+
+const char* co_device_name(unsigned long device)
+{
+	if (device >= CO_DEVICES_TOTAL  ||  !device_names[device])
+		return "?";
+
+	return device_names[device];
+}
+
+void co_module_name(unsigned long module, char* buf, int size)
+{
+	int i;
+
+	if (module < CO_MODULE_CONET0  &&  module_names[module]) {
+		co_snprintf(buf, size, "%s", module_names[module]);
+		return;
+	}
+
+	for (i = 0; i < sizeof(module_units) / sizeof(module_units[0]); i++) {
+		if (module >= module_units[i].first  &&  module <= module_units[i].last) {
+			co_snprintf(buf, size, "%s%ld", module_units[i].name,
+				    module - module_units[i].first);
+			return;
+		}
+	}
+
+	co_snprintf(buf, size, "module%ld", module);
+}
@@ -0,0 +1,27 @@
+/*
+ * This source code is a part of coLinux source package.
+ *
+ * The code is licensed under the GPL. See the COPYING file at
+ * the root directory.
+ *
+ */
+
+#ifndef __COLINUX_USER_NAMES_H__
+#define __COLINUX_USER_NAMES_H__
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <colinux/common/common.h>
+
+/* Printable names of co_operation_t, co_device_t and co_module_t values */
+extern const char* co_operation_name(unsigned long operation);
+extern const char* co_device_name(unsigned long device);
+extern void co_module_name(unsigned long module, char* buf, int size);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif /* __COLINUX_USER_NAMES_H__ */
@@ -5,6 +5,7 @@
 co_rc_t co_reactor_create(co_reactor_t *out_handle)
 {
 	co_reactor_t reactor;
+	co_rc_t rc;
 
 	reactor = co_os_malloc(sizeof(*reactor));
 	if (!reactor)
@@ -14,6 +15,12 @@ co_rc_t co_reactor_create(co_reactor_t *out_handle)
 
 	co_list_init(&reactor->users);
 
+	rc = co_os_reactor_create(reactor);
+	if (!CO_OK(rc)) {
+		co_os_free(reactor);
+		return rc;
+	}
+
 	*out_handle = reactor;
 
 	return CO_RC(OK);
@@ -29,16 +36,19 @@ void co_reactor_add(co_reactor_t reactor, co_reactor_user_t user)
 	co_list_add_head(&user->node, &reactor->users);
 	reactor->num_users += 1;
 	user->reactor = reactor;
+	co_os_reactor_add(reactor, user);
 }
 
 void co_reactor_remove(co_reactor_user_t user)
 {
+	co_os_reactor_remove(user->reactor, user);
 	user->reactor->num_users -= 1;
 	co_list_del(&user->node);
 }
 
 void co_reactor_destroy(co_reactor_t reactor)
 {
+	co_os_reactor_destroy(reactor);
 	co_os_free(reactor);
 }
 
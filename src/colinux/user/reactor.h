@@ -18,6 +18,9 @@
 struct co_reactor_os_user;
 typedef struct co_reactor_os_user *co_reactor_os_user_t;
 
+struct co_reactor_os;
+typedef struct co_reactor_os *co_reactor_os_t;
+
 struct co_reactor_user;
 typedef struct co_reactor_user *co_reactor_user_t;
 
@@ -40,6 +43,7 @@ struct co_reactor_user {
 struct co_reactor {
 	co_list_t users;
 	unsigned long num_users;
+	co_reactor_os_t os_data;
 };
 
 extern co_rc_t co_reactor_create(co_reactor_t *out_handle);
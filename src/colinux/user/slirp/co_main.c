@@ -57,7 +57,8 @@ static co_rc_t monitor_receive(co_reactor_user_t user, unsigned char *buffer, un
 		message = (typeof(message))(&buffer[position]);
 		message_size = message->size + sizeof(*message);
 		size_left -= message_size;
-		if (size_left >= 0) {
+		/* Skip the guest's offload announcement, we take plain frames */
+		if (size_left >= 0  &&  message->type == CO_MESSAGE_TYPE_OTHER) {
 			co_slirp_mutex_lock();
 			slirp_input(message->data, message->size);
 			co_slirp_mutex_unlock();
@@ -98,14 +99,20 @@ void slirp_output(const uint8_t *pkt, int pkt_len)
 
 static co_rc_t wait_loop(void)
 {
-	int ret, nfds;
+	int ret, nfds, reactor_fd, timeout;
 	fd_set rfds, wfds, xfds;
-	struct timeval tv;
+	struct timeval tv, *ptv;
 	co_rc_t rc;
 
+	reactor_fd = co_slirp_reactor_fd(g_reactor);
+
 	while (1) {
-		/* Slirp main loop as copied from QEMU. */
-		rc = co_reactor_select(g_reactor, 1);
+		/*
+		 * Slirp main loop as copied from QEMU. When the reactor can be
+		 * waited on along with slirp's sockets, sleep until either has
+		 * work or a slirp timer is due, instead of polling every 1ms.
+		 */
+		rc = co_reactor_select(g_reactor, reactor_fd < 0 ? 1 : 0);
 		if (!CO_OK(rc))
 			break;
 
@@ -115,9 +122,23 @@ static co_rc_t wait_loop(void)
 		FD_ZERO(&xfds);
 
 		slirp_select_fill(&nfds, &rfds, &wfds, &xfds);
-		tv.tv_sec = 0;
-		tv.tv_usec = 1000;
-		ret = select(nfds + 1, &rfds, &wfds, &xfds, &tv);
+
+		timeout = 1;
+		if (reactor_fd >= 0) {
+			FD_SET(reactor_fd, &rfds);
+			if (reactor_fd > nfds)
+				nfds = reactor_fd;
+			timeout = slirp_select_timeout();
+		}
+
+		ptv = NULL;
+		if (timeout >= 0) {
+			tv.tv_sec = timeout / 1000;
+			tv.tv_usec = (timeout % 1000) * 1000;
+			ptv = &tv;
+		}
+
+		ret = select(nfds + 1, &rfds, &wfds, &xfds, ptv);
 		if (ret >= 0) {
 			slirp_select_poll(&rfds, &wfds, &xfds);
 		}
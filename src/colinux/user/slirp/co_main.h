@@ -8,4 +8,7 @@ void co_slirp_mutex_destroy (void);
 void co_slirp_mutex_lock (void);
 void co_slirp_mutex_unlock (void);
 
+/* A fd that select()s readable on reactor events, or -1 to poll instead */
+int co_slirp_reactor_fd (co_reactor_t reactor);
+
 co_rc_t co_slirp_main(int argc, char *argv[]);
@@ -21,6 +21,9 @@ void slirp_select_fill(int *pnfds,
 
 void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds);
 
+/* ms until slirp's timers need slirp_select_poll(), -1 if never */
+int slirp_select_timeout(void);
+
 void slirp_input(const uint8_t *pkt, int pkt_len);
 
 /* you must provide the following functions: */
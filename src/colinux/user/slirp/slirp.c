@@ -34,6 +34,9 @@ struct ex_list *exec_list;
 /* XXX: suppress those select globals */
 fd_set *global_readfds, *global_writefds, *global_xfds;
 
+/* Timeout computed by the last slirp_select_fill(), in ms, -1 if none */
+static int select_timeout;
+
 char slirp_hostname[33];
 
 #ifdef _WIN32
@@ -329,6 +332,7 @@ void slirp_select_fill(int *pnfds,
 	/*
 	 * First, see the timeout needed by *timo
 	 */
+	updtime();
 	timeout.tv_sec = 0;
 	timeout.tv_usec = -1;
 	/*
@@ -355,9 +359,19 @@ void slirp_select_fill(int *pnfds,
 			   timeout.tv_usec = (u_int)tmp_time;
 		}
 	}
+
+	select_timeout = -1;
+	if (timeout.tv_usec >= 0)
+		select_timeout = (timeout.tv_usec + 999) / 1000;
+
         *pnfds = nfds;
 }
 
+int slirp_select_timeout(void)
+{
+	return select_timeout;
+}
+
 void slirp_select_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds)
 {
     struct socket *so, *so_next;